@@ -15,48 +15,112 @@
 #include <string>
 #include <vector>
 #include <optional>
+#include <cstdint>
 
 namespace twinkle
 {
 
 constexpr unsigned int DEFAULT_OPT_LEVEL = 2;
 
-#define EMIT_EXE_ARG    "exe"
-#define EMIT_OBJ_ARG    "obj"
-#define EMIT_ASM_ARG    "asm"
-#define EMIT_LLVMIR_ARG "llvm"
+// Tiering is opt-in, as run-once functions such as main would otherwise run
+// unoptimized
+constexpr std::uint64_t DEFAULT_JIT_TIER_THRESHOLD = 0;
 
+#define EMIT_EXE_ARG       "exe"
+#define EMIT_OBJ_ARG       "obj"
+#define EMIT_ASM_ARG       "asm"
+#define EMIT_LLVMIR_ARG    "llvm"
+#define EMIT_INTERFACE_ARG "interface"
+
+// Filled with designated initializers, so that the options are named at each
+// use and the ones that are not given keep their defaults
 struct Context {
-  Context(std::vector<std::string>&&   input_files,
-          const bool                   jit,
-          std::string&&                emit_target,
-          const unsigned int           opt_level,
-          std::string&&                relocation_model,
-          std::vector<std::string>&&   linked_libs,
-          std::optional<std::string>&& target_triple) noexcept
-    : input_files{std::move(input_files)}
-    , jit{jit}
-    , emit_target{std::move(emit_target)}
-    , opt_level{opt_level}
-    , relocation_model{std::move(relocation_model)}
-    , linked_libs{std::move(linked_libs)}
-    , target_triple{std::move(target_triple)}
-  {
-  }
+  std::vector<std::string> input_files;
+
+  bool jit = false;
+
+  std::string emit_target = EMIT_EXE_ARG;
+
+  unsigned int opt_level = DEFAULT_OPT_LEVEL;
+
+  // Link all modules at the IR level before optimizing them as a whole
+  bool lto = false;
+
+  // Instrument the program to write its execution profile
+  bool profile_generate = false;
+
+  // Path of the indexed profile (.profdata) used for optimization
+  std::optional<std::string> profile_use;
+
+  // Profile runtime library linked with instrumented programs
+  // If not specified, the one of the clang installation matching LLVM is used
+  std::optional<std::string> profile_runtime;
+
+  std::string relocation_model = "pic";
+
+  std::vector<std::string> linked_libs;
+
+  // 'gcc', 'ld' or 'lld'
+  std::string linker = "gcc";
+
+  std::optional<std::string> target_triple;
+
+  // 'native' means the host CPU
+  std::string cpu = "generic";
+
+  // Comma separated, e.g. "+avx2,-fma"
+  std::string cpu_features;
+
+  // Compilation cache is disabled if std::nullopt
+  std::optional<std::string> cache_dir;
+
+  // In bytes
+  std::uintmax_t cache_max_size = 0;
+
+  // Socket of the compile server that compiles instead of this process
+  // Compiled in this process if std::nullopt
+  std::optional<std::string> server_socket;
+
+  // Path of the Chrome trace JSON of the compilation
+  // Not profiled if std::nullopt
+  std::optional<std::string> time_trace;
+
+  // In microseconds
+  unsigned int time_trace_granularity = 500;
+
+  // Calls and loop iterations after which the JIT optimizes a function
+  // The JIT optimizes every function before it runs if 0
+  std::uint64_t jit_tier_threshold = DEFAULT_JIT_TIER_THRESHOLD;
+
+  bool jit_print_tier_up = false;
+
+  // Number of threads on which the JIT compiles
+  // 0 means the number of hardware threads
+  unsigned int jit_threads = 0;
+
+  bool jit_perf = false;
+
+  bool jit_gdb = false;
 
-  const std::vector<std::string> input_files;
+  // Function benchmarked by the JIT instead of running main
+  std::optional<std::string> bench;
 
-  const bool jit;
+  std::uint64_t bench_iterations = 100;
 
-  const std::string emit_target;
+  std::uint64_t bench_warmup = 10;
 
-  const unsigned int opt_level;
+  // Counts cycles and instructions with perf_event_open
+  bool bench_counters = false;
 
-  const std::string relocation_model;
+  // Number of translation units processed in parallel
+  // 0 means the number of hardware threads
+  unsigned int jobs = 1;
 
-  const std::vector<std::string> linked_libs;
+  // Parses with the grammar written with Boost.Spirit X3
+  bool x3_parser = false;
 
-  const std::optional<std::string> target_triple;
+  // Prints the statistics of the class template instantiations
+  bool template_stats = false;
 };
 
 } // namespace twinkle
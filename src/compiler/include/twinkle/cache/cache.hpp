@@ -0,0 +1,136 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _1e92e02f_acdd_4c77_9589_399074011287
+#define _1e92e02f_acdd_4c77_9589_399074011287
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <twinkle/pch/pch.hpp>
+#include <twinkle/support/exception.hpp>
+#include <llvm/Support/SHA1.h>
+#include <atomic>
+
+namespace twinkle::cache
+{
+
+// Exception class for errors related to the compilation cache.
+struct CacheError : public ErrorBase {
+  explicit CacheError(const std::string& what_arg)
+    : ErrorBase{what_arg}
+  {
+  }
+};
+
+// Hashes values into a cache key
+struct Hasher {
+  // Every value is prefixed with its length, so different sequences of values
+  // never hash the same
+  Hasher& add(const std::string_view value);
+
+  // Returns the key as a hexadecimal string
+  [[nodiscard]] std::string finalize();
+
+private:
+  llvm::SHA1 sha1;
+};
+
+// Returns std::nullopt if the file could not be read
+[[nodiscard]] std::optional<std::string>
+hashFile(const std::filesystem::path& path);
+
+struct Statistics {
+  std::uint64_t hits;
+  std::uint64_t misses;
+  std::uint64_t stored;
+  std::uint64_t evicted;
+
+  // Total size of the cached outputs in bytes
+  std::uint64_t size;
+};
+
+// On-disk cache of compiler outputs
+//
+// Outputs are looked up in two steps, as ccache does. The source key covers
+// the source file and the options, and names a manifest. The manifest lists
+// the files that were imported when the outputs were created, together with
+// their hashes. The outputs are used only if those files are unchanged.
+//
+// Outputs are evicted in least recently used order when the cache grows
+// beyond its maximum size. The time of last use is the modification time.
+struct Cache : private boost::noncopyable {
+  Cache(const std::filesystem::path& dir, const std::uintmax_t max_size);
+
+  // Returns the paths of the cached outputs in the cache directory
+  [[nodiscard]] std::optional<std::vector<std::filesystem::path>>
+  lookup(const std::string& source_key);
+
+  void store(const std::string&                        source_key,
+             const std::vector<std::filesystem::path>& dependencies,
+             const std::vector<std::filesystem::path>& outputs);
+
+  // Stores an output that depends on nothing but the source key
+  void store(const std::string& source_key, const llvm::StringRef output);
+
+  // Adds the statistics of this process to the statistics file and evicts
+  // outputs if the cache is too large
+  void flush();
+
+  [[nodiscard]] static Statistics
+  readStatistics(const std::filesystem::path& dir);
+
+  // Removes all outputs and manifests
+  // The counters of the statistics are kept
+  static void clear(const std::filesystem::path& dir);
+
+private:
+  struct ManifestEntry {
+    std::string result_key;
+
+    std::size_t num_outputs;
+
+    // Hash and path of each file
+    std::vector<std::pair<std::string, std::filesystem::path>> dependencies;
+  };
+
+  [[nodiscard]] std::vector<ManifestEntry>
+  readManifest(const std::string& source_key) const;
+
+  // Makes the entry the first one checked by lookups of the source key
+  void addManifestEntry(const std::string& source_key, ManifestEntry&& entry);
+
+  void writeManifest(const std::string&                source_key,
+                     const std::vector<ManifestEntry>& entries) const;
+
+  [[nodiscard]] std::filesystem::path
+  manifestPath(const std::string& source_key) const;
+
+  [[nodiscard]] std::filesystem::path
+  outputPath(const std::string& result_key, const std::size_t idx) const;
+
+  // Returns the number of evicted outputs and the size after eviction
+  [[nodiscard]] std::pair<std::uint64_t, std::uint64_t> evict() const;
+
+  const std::filesystem::path dir;
+
+  const std::uintmax_t max_size;
+
+  // Statistics of this process
+  std::atomic<std::uint64_t> hits;
+  std::atomic<std::uint64_t> misses;
+  std::atomic<std::uint64_t> stored;
+
+  // Change of the size of the outputs, which is negative if smaller outputs
+  // replaced existing ones
+  std::atomic<std::int64_t> stored_size;
+};
+
+} // namespace twinkle::cache
+
+#endif
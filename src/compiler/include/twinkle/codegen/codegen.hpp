@@ -17,9 +17,14 @@
 #include <twinkle/codegen/type.hpp>
 #include <twinkle/support/utils.hpp>
 #include <twinkle/support/typedef.hpp>
+#include <twinkle/support/target.hpp>
+#include <twinkle/support/exception.hpp>
 #include <twinkle/jit/jit.hpp>
+#include <twinkle/jit/bench.hpp>
 #include <twinkle/parse/parser.hpp>
+#include <twinkle/parse/import_cache.hpp>
 #include <twinkle/mangle/mangler.hpp>
+#include <llvm/Support/PGOOptions.h>
 #include <map>
 
 namespace twinkle
@@ -27,6 +32,9 @@ namespace twinkle
 
 using FilePaths = std::vector<std::filesystem::path>;
 
+// File paths of each module in the order of the input files
+using ModuleFilePaths = std::vector<FilePaths>;
+
 namespace codegen
 {
 
@@ -114,16 +122,42 @@ using TemplateArgumentTable = TypeTable;
 using ClassTable = Table<std::string, std::shared_ptr<ClassType>>;
 
 struct Variable;
-using SymbolTable = Table<std::string, std::shared_ptr<Variable>>;
 
-using UnionTable = Table<std::string, std::shared_ptr<UnionType>>;
+// Variables declared in a block, which also sees those of the enclosing blocks
+// Blocks refer to their enclosing ones instead of copying their variables
+struct Scope : private boost::noncopyable {
+  explicit Scope(const Scope* const parent = nullptr) noexcept
+    : parent{parent}
+  {
+  }
 
-using PositionCacheTable = Table<std::string /* file name */, PositionCache>;
+  // Shadows the variables of the same name, including those of this block
+  void insert(const std::string&               name,
+              const std::shared_ptr<Variable>& variable);
 
-// Stores source code line by line as elements
-using SourceCode = std::vector<std::string>;
+  // Returns nullptr if not found
+  [[nodiscard]] std::shared_ptr<Variable> find(const std::string& name) const;
 
-using SourceCodeTable = Table<std::string /* file name */, SourceCode>;
+  // In the order of declaration, including the shadowed ones
+  [[nodiscard]] const std::vector<std::shared_ptr<Variable>>&
+  getVariables() const noexcept
+  {
+    return variables;
+  }
+
+private:
+  const Scope* const parent;
+
+  std::unordered_map<std::string, std::shared_ptr<Variable>> table;
+
+  std::vector<std::shared_ptr<Variable>> variables;
+};
+
+using UnionTable = Table<std::string, std::shared_ptr<UnionType>>;
+
+using PositionTables = Table<int /* file ID */, PositionTablePtr>;
+
+using SourceTable = Table<std::string /* file name */, SourceBufferPtr>;
 
 enum class NamespaceKind {
   unknown,
@@ -159,6 +193,11 @@ struct NamespaceStack {
     return namespaces.empty();
   }
 
+  [[nodiscard]] std::size_t size() const noexcept
+  {
+    return namespaces.size();
+  }
+
   void push(const Namespace& n)
   {
     namespaces.push_back(n);
@@ -230,12 +269,36 @@ using ClassTemplateTable
           ClassTemplateTableValue,
           std::map<TemplateTableKey, ClassTemplateTableValue>>;
 
-using CreatedClassTemplateTableKey = std::tuple<std::string, // Name
-                                                ast::TemplateArguments,
-                                                NamespaceStack>;
+// Identifies a class created from a template by the template and the
+// identities of the template arguments
+struct CreatedClassTemplateTableKey {
+  [[nodiscard]] bool
+  operator==(const CreatedClassTemplateTableKey&) const = default;
 
-using CreatedClassTemplateTableElem
-  = std::pair<CreatedClassTemplateTableKey, std::shared_ptr<Type>>;
+  // Class templates are never removed from their table
+  const ClassTemplateTableValue* class_template;
+
+  std::vector<const Type*> template_args;
+};
+
+struct CreatedClassTemplateTableKeyHash {
+  [[nodiscard]] std::size_t
+  operator()(const CreatedClassTemplateTableKey& key) const noexcept;
+};
+
+struct ClassTemplateStatistics {
+  ClassTemplateStatistics& operator+=(const ClassTemplateStatistics& other)
+  {
+    instantiations += other.instantiations;
+    lookups += other.lookups;
+    hits += other.hits;
+    return *this;
+  }
+
+  std::uint64_t instantiations{};
+  std::uint64_t lookups{};
+  std::uint64_t hits{};
+};
 
 // std::unordered_map cannot use std::tuple as a key, so use std::map instead
 using UnionTemplateTable = Table<TemplateTableKey,
@@ -246,18 +309,72 @@ struct CreatedClassTemplateTable {
   CreatedClassTemplateTable(CGContext& ctx)
     : ctx{ctx}
     , table{}
+    , statistics{}
   {
   }
 
+  // The template arguments are resolved in the current scope
+  [[nodiscard]] CreatedClassTemplateTableKey
+  createKey(const ClassTemplateTableValue& class_template,
+            const ast::TemplateArguments&  template_args) const;
+
   [[nodiscard]] std::optional<std::shared_ptr<Type>>
-  operator[](const CreatedClassTemplateTableKey& key) const;
+  operator[](const CreatedClassTemplateTableKey& key);
 
   void insert(CreatedClassTemplateTableKey&& key,
               const std::shared_ptr<Type>&   value);
 
+  [[nodiscard]] const ClassTemplateStatistics& getStatistics() const noexcept
+  {
+    return statistics;
+  }
+
+private:
+  CGContext& ctx;
+
+  std::unordered_map<CreatedClassTemplateTableKey,
+                     std::shared_ptr<Type>,
+                     CreatedClassTemplateTableKeyHash>
+    table;
+
+  ClassTemplateStatistics statistics;
+};
+
+// A function that can be called by its name
+struct Overload {
+  llvm::Function* function;
+
+  // Identities of the named parameters, including 'this' of methods
+  std::vector<const Type*> param_types;
+
+  bool is_vararg;
+
+  Accessibility accessibility;
+};
+
+// Functions declared in the module by their namespaces and names
+// Function templates, constructors and destructors are not included
+struct OverloadTable {
+  void insert(const NamespaceStack&  space,
+              const std::string_view name,
+              Overload&&             overload);
+
+  // Namespaces are searched from the innermost to the outermost, exactly
+  // matching functions first, and then variadic functions
+  // Public methods and non-methods are not distinguished, as with mangling
+  [[nodiscard]] llvm::Function*
+  find(const NamespaceStack&           space,
+       const std::string_view          name,
+       const std::vector<const Type*>& arg_types,
+       const Accessibility             accessibility) const;
+
 private:
-  CGContext&                              ctx;
-  std::set<CreatedClassTemplateTableElem> table;
+  // "a::b::name" for 'name' in the namespace 'a::b'
+  [[nodiscard]] static std::string createKey(const NamespaceStack&  space,
+                                             const std::size_t      depth,
+                                             const std::string_view name);
+
+  std::unordered_map<std::string, std::vector<Overload>> table;
 };
 
 template <typename T>
@@ -266,14 +383,14 @@ concept PositionTaggedClass
 
 // Codegen context
 struct CGContext : private boost::noncopyable {
-  CGContext(llvm::LLVMContext&      context,
-            PositionCache&&         current_file_poscache,
-            std::filesystem::path&& file,
-            const std::string&      source_code,
-            const unsigned int      opt_level,
-            const bool              jit) noexcept;
-
-  [[nodiscard]] std::string
+  CGContext(llvm::LLVMContext&                         context,
+            const PositionTablePtr&                    positions,
+            std::filesystem::path&&                    file,
+            const SourceBufferPtr&                     source,
+            const parse::ParserKind                    parser_kind,
+            const std::shared_ptr<parse::ImportCache>& import_cache) noexcept;
+
+  [[nodiscard]] FormattedDiagnostic
   formatError(const boost::iterator_range<InputIterator>& pos,
               const std::string_view                      message) const;
 
@@ -282,54 +399,31 @@ struct CGContext : private boost::noncopyable {
   std::unique_ptr<llvm::Module> module;
   llvm::IRBuilder<>             builder;
 
+  // Canonical types
+  TypeInterner types;
+
   std::filesystem::path current_file;
 
-  template <PositionTaggedClass T>
-  [[nodiscard]] PositionRange positionOf(T&& ast) const
-  {
-    const auto search_in_current_file = [&]() {
-      const auto current_file_pos_cache
-        = position_cache_table[current_file.string()];
-      assert(current_file_pos_cache);
-      return current_file_pos_cache->get().position_of(ast);
-    };
-
-    const auto search_in_imported_files
-      = [&]() -> std::optional<PositionRange> {
-      const auto current_file_name = current_file.string();
-
-      for (const auto& r : position_cache_table) {
-        if (r.first == current_file_name)
-          continue;
-
-        try {
-          return r.second.position_of(ast);
-        }
-        catch (const std::out_of_range&) {
-          continue;
-        }
-      }
+  // Files imported by the translation unit
+  FilePaths imported_files;
 
-      return std::nullopt;
-    };
+  // Imported files are parsed with the same kind of parser as the current one
+  const parse::ParserKind parser_kind;
 
-    try {
-      return search_in_current_file();
-    }
-    catch (const std::out_of_range&) {
-      const auto pos = search_in_imported_files();
-      if (pos)
-        return *pos;
-      else
-        unreachable();
-    }
-  }
+  // Imported files are parsed every time if nullptr
+  const std::shared_ptr<parse::ImportCache> import_cache;
 
-  [[nodiscard]] const PositionCache& getCurrentPosCache() const
+  // Positions of the imported files refer to their sources
+  std::vector<parse::ImportCache::ResultPtr> imported_results;
+
+  template <PositionTaggedClass T>
+  [[nodiscard]] PositionRange positionOf(T&& ast) const
   {
-    const auto current_pos_cache = position_cache_table[current_file.string()];
-    assert(current_pos_cache);
-    return *current_pos_cache;
+    // Nodes of the imported files are also used in the current file
+    const auto positions = position_tables[ast.id_last];
+    assert(positions);
+
+    return positions->get()->positionOf(ast);
   }
 
   // Table
@@ -340,9 +434,11 @@ struct CGContext : private boost::noncopyable {
   AliasTable                        alias_table;
   ClassTemplateTable                class_template_table;
   CreatedClassTemplateTable         created_class_template_table;
+  OverloadTable                     overload_table;
   UnionTable                        union_table;
   UnionTemplateTable                union_template_table;
-  PositionCacheTable                position_cache_table;
+  PositionTables                    position_tables;
+  SourceTable                       source_table;
   // If you want to find template arguments, look for them in the symbol table
   // of top
   std::stack<TemplateArgumentTable> template_argument_tables;
@@ -353,70 +449,156 @@ struct CGContext : private boost::noncopyable {
   // Mangle
   mangle::Mangler mangler;
 
-  // Pass manager
-  llvm::legacy::FunctionPassManager fpm;
-
-  // If true, suppress optimization
-  const bool jit;
-
 private:
-  SourceCodeTable source_code_table;
-
-  [[nodiscard]] std::size_t
-  calcRows(const boost::iterator_range<InputIterator>& pos) const;
+  // Returns the file name and the source that 'pos' is in
+  [[nodiscard]] std::pair<std::string, SourceBufferPtr>
+  findSource(const boost::iterator_range<InputIterator>& pos) const;
 };
 
 struct CodeGenerator : private boost::noncopyable {
-  CodeGenerator(const std::string_view               program_name,
-                std::vector<parse::Parser::Result>&& parse_results,
-                const unsigned int                   opt_level,
-                const llvm::Reloc::Model             relocation_model,
-                const std::optional<std::string>&    target_triple_arg,
-                const bool                           jit);
+  CodeGenerator(const std::string_view                     program_name,
+                std::vector<parse::Parser::Result>&&       parse_results,
+                const unsigned int                         opt_level,
+                const bool                                 lto,
+                const llvm::Optional<llvm::PGOOptions>&    pgo_options,
+                const llvm::Reloc::Model                   relocation_model,
+                const std::optional<std::string>&          target_triple_arg,
+                const TargetCPU&                           target_cpu,
+                const bool                                 jit,
+                const unsigned int                         jobs,
+                const parse::ParserKind                    parser_kind,
+                const std::shared_ptr<parse::ImportCache>& import_cache);
 
   // Returns the created file paths
-  [[nodiscard]] FilePaths emitLlvmIRFiles();
+  [[nodiscard]] ModuleFilePaths emitLlvmIRFiles();
 
   // Returns the created file paths
-  [[nodiscard]] FilePaths emitObjectFiles();
+  [[nodiscard]] ModuleFilePaths emitObjectFiles();
 
   // Returns the created file paths
-  [[nodiscard]] FilePaths emitTemporaryObjectFiles();
+  [[nodiscard]] ModuleFilePaths emitTemporaryObjectFiles();
 
   // Returns the created file paths
-  [[nodiscard]] FilePaths emitAssemblyFiles();
+  [[nodiscard]] ModuleFilePaths emitAssemblyFiles();
+
+  // Returns the files imported by each module
+  [[nodiscard]] ModuleFilePaths getImportedFiles() const;
+
+  // Returns the symbols of the functions that other modules can refer to
+  [[nodiscard]] std::vector<std::string> getExternalFunctions() const;
+
+  // Summed over the translation units
+  [[nodiscard]] ClassTemplateStatistics getClassTemplateStatistics() const;
+
+  // Hands the modules over to 'jit'
+  // They are removed together with 'resource_tracker' if it is not null
+  void addToJIT(jit::JitCompiler&                   jit,
+                const llvm::orc::ResourceTrackerSP& resource_tracker);
 
   // Returns the return value from the main function
-  [[nodiscard]] int doJIT();
+  // Compiled objects are kept in 'cache' if it is not null
+  // If 'bench' is given, the function is benchmarked instead of running main,
+  // and EXIT_SUCCESS is returned
+  [[nodiscard]] int
+  doJIT(cache::Cache*                               cache,
+        const jit::TieringOptions&                  tiering,
+        const unsigned int                          num_threads,
+        const jit::DebugOptions&                    debug,
+        const std::optional<jit::BenchmarkOptions>& bench);
 
 private:
   void verifyOptLevel(const unsigned int opt_level) const;
 
-  using Result
-    = std::tuple<std::unique_ptr<llvm::Module>, std::filesystem::path>;
+  // Each translation unit has its own context so that it can be generated on
+  // its own thread
+  // The module is declared after the context so that it is destroyed first
+  struct Result {
+    std::unique_ptr<llvm::LLVMContext> context;
+    std::unique_ptr<llvm::Module>      module;
+    std::filesystem::path              file;
+    FilePaths                          imported_files;
+  };
 
   void codegen(const ast::TranslationUnit& ast, CGContext& ctx);
 
+  // Returns the symbol of the function that takes no arguments and is named
+  // 'name' in the global namespace, or whose symbol is 'name'
+  // The function is made visible to lookups if it is not public
+  [[nodiscard]] std::string exposeFunction(const std::string& name);
+
+  enum class PipelineKind {
+    per_module,
+    lto_pre_link, // Run on each module before they are linked
+    lto,          // Run on the linked module
+  };
+
+  // Runs the default pipeline of the optimization level
+  void optimize(llvm::Module&      module,
+                const unsigned int opt_level,
+                const PipelineKind kind) const;
+
+  // Links all modules into one and optimizes it as a whole
+  // The linked module replaces the results
+  void linkForLTO(const unsigned int opt_level);
+
   // Returns the created file paths
-  [[nodiscard]] FilePaths emitFiles(const llvm::CodeGenFileType cgft,
-                                    const bool create_as_tmpfile = false);
+  [[nodiscard]] ModuleFilePaths emitFiles(const llvm::CodeGenFileType cgft,
+                                          const bool create_as_tmpfile = false);
+
+  void emitModule(const Result&               result,
+                  const std::string&          output_file,
+                  const llvm::CodeGenFileType cgft) const;
+
+  // Splits the module into partitions and emits them on multiple threads
+  // Returns the created file paths
+  [[nodiscard]] FilePaths
+  emitSplitModule(const Result&               result,
+                  const std::size_t           partitions,
+                  const llvm::CodeGenFileType cgft) const;
+
+  // Returns the number of partitions a module is split into when emitted
+  [[nodiscard]] std::size_t
+  countPartitions(const llvm::Module& module) const noexcept;
 
   void initTargetTripleAndMachine(
     const std::optional<std::string>& target_triple_arg);
 
-  const std::string_view argv_front;
+  // A target machine must not be shared between threads, so each emission
+  // creates its own
+  [[nodiscard]] std::unique_ptr<llvm::TargetMachine>
+  createTargetMachine() const;
 
-  std::unique_ptr<llvm::LLVMContext> context;
+  // Takes a target machine of the same settings from the pool, or creates one
+  [[nodiscard]] TargetMachinePool::Handle acquireTargetMachine() const;
+
+  const std::string_view argv_front;
 
   bool jit_compiled = false;
 
-  std::string          target_triple;
-  llvm::TargetMachine* target_machine;
+  std::string         target_triple;
+  const llvm::Target* target;
+
+  const TargetCPU target_cpu;
+
+  // Derived from the optimization level
+  llvm::CodeGenOpt::Level codegen_opt_level;
+
+  // Used for the data layout
+  TargetMachinePool::Handle target_machine;
 
   const llvm::Reloc::Model relocation_model;
 
+  // Instrumentation or use of an execution profile
+  const llvm::Optional<llvm::PGOOptions> pgo_options;
+
+  const unsigned int jobs;
+
+  // In the order of the input files
   std::vector<Result> results;
 
+  // Kept apart from the results, which LTO replaces
+  std::vector<ClassTemplateStatistics> class_template_statistics;
+
   std::vector<parse::Parser::Result> parse_results;
 };
 
@@ -106,15 +106,11 @@ struct Variable {
 };
 
 struct AllocaVariable : public Variable {
-  AllocaVariable(CGContext&   ctx,
-                 const Value& alloca,
-                 const bool   is_mutable) noexcept
-    : alloca{alloca}
+  AllocaVariable(CGContext& ctx, const Value& alloca, const bool is_mutable)
+    : alloca{alloca.getValue(), alloca.getType()->withMutable(ctx, is_mutable)}
     , is_mutable{is_mutable}
   {
     assert(llvm::dyn_cast<llvm::AllocaInst>(alloca.getValue()));
-
-    this->alloca.getType()->setMutable(ctx, is_mutable);
   }
 
   AllocaVariable() = delete;
@@ -154,7 +150,9 @@ private:
 
 // Returns a AST of a class template and a namespace information where it is
 // located
-[[nodiscard]] std::optional<std::pair<ClassTemplateTableValue, NamespaceStack>>
+// The AST is the one in the class template table
+[[nodiscard]] std::optional<
+  std::pair<const ClassTemplateTableValue*, NamespaceStack>>
 findClassTemplate(CGContext&                    ctx,
                   const std::string_view        name,
                   const ast::TemplateArguments& args);
@@ -22,6 +22,11 @@ struct CodegenError : public ErrorBase {
     : ErrorBase{what_arg}
   {
   }
+
+  explicit CodegenError(FormattedDiagnostic&& diagnostic)
+    : ErrorBase{std::move(diagnostic)}
+  {
+  }
 };
 
 } // namespace twinkle::codegen
@@ -49,7 +49,7 @@ struct ScopeResolutionResult {
 createScopeResolutionResult(CGContext& ctx, const ast::ScopeResolution& node);
 
 [[nodiscard]] Value createExpr(CGContext&         ctx,
-                               const SymbolTable& scope,
+                               const Scope&       scope,
                                const StmtContext& stmt_ctx,
                                const ast::Expr&   expr);
 
@@ -22,7 +22,7 @@ namespace twinkle::codegen
 void invokeDestructor(CGContext& ctx, const Value& this_);
 
 void createStatement(CGContext&         ctx,
-                     const SymbolTable& scope_arg,
+                     const Scope&       scope_arg,
                      const StmtContext& stmt_ctx_arg,
                      const ast::Stmt&   statement);
 
@@ -78,15 +78,41 @@ struct UnionVariant {
 
 using UnionVariants = std::vector<UnionVariant>;
 
-struct Type {
+// Types are immutable, and each structurally distinct type has one canonical
+// instance owned by 'TypeInterner' or the type tables
+struct Type : public std::enable_shared_from_this<Type> {
   explicit Type(const bool is_mutable) noexcept
     : is_mutable{is_mutable}
+    , is_canonical{false}
+    , identity{}
   {
   }
 
   virtual ~Type() = default;
 
-  [[nodiscard]] virtual std::shared_ptr<Type> clone() const = 0;
+  // Only class and union types are cloned, into their variants of mutability
+  [[nodiscard]] virtual std::shared_ptr<Type> clone() const
+  {
+    unreachable();
+  }
+
+  // Returns the canonical instance of this type with 'is_mutable'
+  // Mutability also applies to the types this type refers to
+  [[nodiscard]] virtual std::shared_ptr<Type>
+  withMutable(CGContext& ctx, const bool is_mutable) = 0;
+
+  // Types are equal if and only if their identities are the same
+  // Mutability is not taken into account
+  [[nodiscard]] virtual const Type* getIdentity(CGContext&) const
+  {
+    assert(identity);
+    return identity;
+  }
+
+  [[nodiscard]] bool isCanonical() const noexcept
+  {
+    return is_canonical;
+  }
 
   [[nodiscard]] virtual SignKind getSignKind(CGContext&) const = 0;
 
@@ -195,30 +221,31 @@ struct Type {
     return is_mutable;
   }
 
-  virtual void setMutable(CGContext&, const bool is_mutable)
-  {
-    this->is_mutable = is_mutable;
-  }
-
 protected:
   bool is_mutable;
+
+  bool is_canonical;
+
+  // The canonical instance of this type without mutability
+  Type* identity;
+
+  friend struct TypeInterner;
 };
 
+// Use 'TypeInterner::getBuiltinType' instead of constructing directly
 struct BuiltinType : public Type {
-  explicit BuiltinType(const BuiltinTypeKind kind,
-                       const bool            is_mutable) noexcept
-    : Type{is_mutable}
-    , kind{kind}
-  {
-  }
+  BuiltinType(CGContext&            ctx,
+              const BuiltinTypeKind kind,
+              const bool            is_mutable);
 
-  [[nodiscard]] std::shared_ptr<Type> clone() const override
+  [[nodiscard]] std::shared_ptr<Type>
+  withMutable(CGContext& ctx, const bool is_mutable) override;
+
+  [[nodiscard]] SignKind getSignKind(CGContext&) const override
   {
-    return std::make_shared<BuiltinType>(*this);
+    return sign_kind;
   }
 
-  [[nodiscard]] SignKind getSignKind(CGContext&) const override;
-
   [[nodiscard]] bool isVoidTy(CGContext&) const override
   {
     return kind == BuiltinTypeKind::void_;
@@ -231,12 +258,31 @@ struct BuiltinType : public Type {
 
   [[nodiscard]] bool isIntegerTy(CGContext&) const override;
 
-  [[nodiscard]] llvm::Type* getLLVMType(CGContext& ctx) const override;
+  [[nodiscard]] llvm::Type* getLLVMType(CGContext&) const override
+  {
+    return llvm_type;
+  }
 
-  [[nodiscard]] std::string getMangledName(CGContext&) const override;
+  [[nodiscard]] std::string getMangledName(CGContext&) const override
+  {
+    return mangled_name;
+  }
 
 private:
+  [[nodiscard]] static llvm::Type* createLLVMType(CGContext&            ctx,
+                                                  const BuiltinTypeKind kind);
+
+  [[nodiscard]] static SignKind signKindOf(const BuiltinTypeKind kind);
+
+  [[nodiscard]] static std::string mangledNameOf(const BuiltinTypeKind kind);
+
   const BuiltinTypeKind kind;
+
+  llvm::Type* const llvm_type;
+
+  const std::string mangled_name;
+
+  const SignKind sign_kind;
 };
 
 struct UserDefinedType : public Type {
@@ -252,10 +298,13 @@ struct UserDefinedType : public Type {
   {
   }
 
-  [[nodiscard]] std::shared_ptr<Type> clone() const override
-  {
-    return std::make_shared<UserDefinedType>(*this);
-  }
+  // Returns the real type with 'is_mutable'
+  // Throws CodegenError if the type does not exist
+  [[nodiscard]] std::shared_ptr<Type>
+  withMutable(CGContext& ctx, const bool is_mutable) override;
+
+  // Throws CodegenError if the type does not exist
+  [[nodiscard]] const Type* getIdentity(CGContext& ctx) const override;
 
   [[nodiscard]] SignKind getSignKind(CGContext& ctx) const override
   {
@@ -360,12 +409,10 @@ struct UserDefinedType : public Type {
 
   [[nodiscard]] std::string getMangledName(CGContext& ctx) const override;
 
-  void setMutable(CGContext& ctx, const bool is_mutable) override
-  {
-    getRealType(ctx)->setMutable(ctx, is_mutable);
-  }
-
 private:
+  // Same as 'getRealType', but throws CodegenError if the type does not exist
+  [[nodiscard]] std::shared_ptr<Type> getExistingRealType(CGContext& ctx) const;
+
   const std::string ident;
 };
 
@@ -397,6 +444,9 @@ struct ClassType : public Type {
     return std::make_shared<ClassType>(*this);
   }
 
+  [[nodiscard]] std::shared_ptr<Type>
+  withMutable(CGContext& ctx, const bool is_mutable) override;
+
   static std::shared_ptr<ClassType> createOpaqueClass(CGContext&         ctx,
                                                       const std::string& ident);
 
@@ -405,7 +455,7 @@ struct ClassType : public Type {
 
   void setIsOpaque(const bool val) noexcept
   {
-    is_opaque = val;
+    body->is_opaque = val;
   }
 
   // Used to set members to Opaque classes
@@ -420,7 +470,7 @@ struct ClassType : public Type {
   [[nodiscard]] const MemberVariable&
   getMemberVar(const std::size_t offset) const
   {
-    return members.at(offset);
+    return body->members.at(offset);
   }
 
   [[nodiscard]] SignKind getSignKind(CGContext&) const override
@@ -435,7 +485,7 @@ struct ClassType : public Type {
 
   [[nodiscard]] bool isOpaque(CGContext&) const override
   {
-    return is_opaque;
+    return body->is_opaque;
   }
 
   [[nodiscard]] bool isClassTy(CGContext&) const override
@@ -459,9 +509,15 @@ struct ClassType : public Type {
   }
 
 private:
-  bool                        is_opaque;
-  std::vector<MemberVariable> members;
-  const std::string           name;
+  // Shared with the variants of mutability, so that they see the body set to
+  // opaque classes later
+  struct Body {
+    bool                        is_opaque;
+    std::vector<MemberVariable> members;
+  };
+
+  std::shared_ptr<Body> body;
+  const std::string     name;
 
   // If struct is created multiple times, the name will be duplicated, so create
   // it only once and store it in this variable
@@ -511,6 +567,9 @@ struct UnionType : public Type {
     return std::make_shared<UnionType>(*this);
   }
 
+  [[nodiscard]] std::shared_ptr<Type>
+  withMutable(CGContext& ctx, const bool is_mutable) override;
+
   [[nodiscard]] SignKind getSignKind(CGContext&) const override
   {
     return SignKind::no_sign;
@@ -559,28 +618,23 @@ private:
   Actual actual;
 };
 
+// Use 'TypeInterner::getPointerType' instead of constructing directly
 struct PointerType : public Type {
-  explicit PointerType(const std::shared_ptr<Type>& pointee_type,
-                       const bool                   is_mutable)
-    : Type{is_mutable}
-    , pointee_type{pointee_type}
-  {
-  }
+  PointerType(CGContext&                   ctx,
+              const std::shared_ptr<Type>& pointee_type,
+              const bool                   is_mutable);
 
-  [[nodiscard]] std::shared_ptr<Type> clone() const override
-  {
-    return std::make_shared<PointerType>(*this);
-  }
+  [[nodiscard]] std::shared_ptr<Type>
+  withMutable(CGContext& ctx, const bool is_mutable) override;
 
   [[nodiscard]] bool isPointerTy(CGContext&) const override
   {
     return true;
   }
 
-  [[nodiscard]] llvm::Type* getLLVMType(CGContext& ctx) const override
+  [[nodiscard]] llvm::Type* getLLVMType(CGContext&) const override
   {
-    assert(pointee_type);
-    return llvm::PointerType::getUnqual(pointee_type->getLLVMType(ctx));
+    return llvm_type;
   }
 
   [[nodiscard]] std::shared_ptr<Type> getPointeeType(CGContext&) const override
@@ -588,43 +642,42 @@ struct PointerType : public Type {
     return pointee_type;
   }
 
-  [[nodiscard]] std::string getMangledName(CGContext& ctx) const override;
-
-  [[nodiscard]] SignKind getSignKind(CGContext&) const override
+  [[nodiscard]] std::string getMangledName(CGContext&) const override
   {
-    return SignKind::unsigned_;
+    return mangled_name;
   }
 
-  void setMutable(CGContext& ctx, const bool is_mutable) override
+  [[nodiscard]] SignKind getSignKind(CGContext&) const override
   {
-    this->is_mutable = is_mutable;
-    pointee_type->setMutable(ctx, is_mutable);
+    return SignKind::unsigned_;
   }
 
 private:
   const std::shared_ptr<Type> pointee_type;
+
+  llvm::Type* const llvm_type;
+
+  const std::string mangled_name;
 };
 
+// Use 'TypeInterner::getArrayType' instead of constructing directly
 struct ArrayType : public Type {
-  ArrayType(const std::shared_ptr<Type>& element_type,
+  ArrayType(CGContext&                   ctx,
+            const std::shared_ptr<Type>& element_type,
             const std::uint64_t          array_size,
-            const bool                   is_mutable)
-    : Type{is_mutable}
-    , element_type{element_type}
-    , array_size{array_size}
-  {
-  }
+            const bool                   is_mutable);
 
-  [[nodiscard]] std::shared_ptr<Type> clone() const override
+  [[nodiscard]] std::shared_ptr<Type>
+  withMutable(CGContext& ctx, const bool is_mutable) override;
+
+  [[nodiscard]] std::string getMangledName(CGContext&) const override
   {
-    return std::make_shared<ArrayType>(*this);
+    return mangled_name;
   }
 
-  [[nodiscard]] std::string getMangledName(CGContext& ctx) const override;
-
-  [[nodiscard]] llvm::Type* getLLVMType(CGContext& ctx) const override
+  [[nodiscard]] llvm::Type* getLLVMType(CGContext&) const override
   {
-    return llvm::ArrayType::get(element_type->getLLVMType(ctx), array_size);
+    return llvm_type;
   }
 
   [[nodiscard]] std::shared_ptr<Type>
@@ -648,40 +701,34 @@ struct ArrayType : public Type {
     return SignKind::no_sign;
   }
 
-  void setMutable(CGContext& ctx, const bool is_mutable) override
-  {
-    this->is_mutable = is_mutable;
-    element_type->setMutable(ctx, is_mutable);
-  }
-
 private:
   const std::shared_ptr<Type> element_type;
   const std::uint64_t         array_size;
+
+  llvm::Type* const llvm_type;
+
+  const std::string mangled_name;
 };
 
 // Hold pointer type
 // However, implement so that dereferences are not required when referencing
+// Use 'TypeInterner::getReferenceType' instead of constructing directly
 struct ReferenceType : public Type {
-  explicit ReferenceType(const std::shared_ptr<Type>& refee_type,
-                         const bool                   is_mutable)
-    : Type{is_mutable}
-    , refee_type{refee_type}
-  {
-  }
+  ReferenceType(CGContext&                   ctx,
+                const std::shared_ptr<Type>& refee_type,
+                const bool                   is_mutable);
 
-  [[nodiscard]] std::shared_ptr<Type> clone() const override
-  {
-    return std::make_shared<ReferenceType>(*this);
-  }
+  [[nodiscard]] std::shared_ptr<Type>
+  withMutable(CGContext& ctx, const bool is_mutable) override;
 
   [[nodiscard]] bool isRefTy(CGContext&) const override
   {
     return true;
   }
 
-  [[nodiscard]] llvm::Type* getLLVMType(CGContext& ctx) const override
+  [[nodiscard]] llvm::Type* getLLVMType(CGContext&) const override
   {
-    return llvm::PointerType::getUnqual(refee_type->getLLVMType(ctx));
+    return llvm_type;
   }
 
   [[nodiscard]] std::shared_ptr<Type> getRefeeType(CGContext&) const override
@@ -689,26 +736,95 @@ struct ReferenceType : public Type {
     return refee_type;
   }
 
-  [[nodiscard]] std::string getMangledName(CGContext& ctx) const override
+  [[nodiscard]] std::string getMangledName(CGContext&) const override
   {
-    return "R" + refee_type->getMangledName(ctx);
+    return mangled_name;
   }
 
-  [[nodiscard]] SignKind getSignKind(CGContext& ctx) const override
+  [[nodiscard]] SignKind getSignKind(CGContext&) const override
   {
-    return refee_type->getSignKind(ctx);
+    return sign_kind;
   }
 
-  void setMutable(CGContext& ctx, const bool is_mutable) override
+private:
+  const std::shared_ptr<Type> refee_type;
+
+  llvm::Type* const llvm_type;
+
+  const std::string mangled_name;
+
+  const SignKind sign_kind;
+};
+
+// Owns the canonical instances of the types, so that structurally equal types
+// are the same object
+// Types referred to by other types are made canonical before they are looked up
+struct TypeInterner : private boost::noncopyable {
+  explicit TypeInterner(CGContext& ctx) noexcept
+    : ctx{ctx}
   {
-    this->is_mutable = is_mutable;
-    refee_type->setMutable(ctx, is_mutable);
   }
 
+  [[nodiscard]] std::shared_ptr<Type> getBuiltinType(const BuiltinTypeKind kind,
+                                                     const bool is_mutable);
+
+  [[nodiscard]] std::shared_ptr<Type>
+  getPointerType(const std::shared_ptr<Type>& pointee_type,
+                 const bool                   is_mutable);
+
+  [[nodiscard]] std::shared_ptr<Type>
+  getArrayType(const std::shared_ptr<Type>& element_type,
+               const std::uint64_t          array_size,
+               const bool                   is_mutable);
+
+  [[nodiscard]] std::shared_ptr<Type>
+  getReferenceType(const std::shared_ptr<Type>& refee_type,
+                   const bool                   is_mutable);
+
+  // Returns the variant of a class or union type with 'is_mutable'
+  [[nodiscard]] std::shared_ptr<Type> getVariantType(Type&      type,
+                                                     const bool is_mutable);
+
 private:
-  std::shared_ptr<Type> refee_type;
+  [[nodiscard]] std::shared_ptr<Type>
+  canonicalize(const std::shared_ptr<Type>& type) const;
+
+  // Called once 'type' is in its table, as its identity may be itself
+  void setIdentity(Type& type) const;
+
+  static constexpr std::size_t num_builtin_types
+    = static_cast<std::size_t>(BuiltinTypeKind::usize) + 1;
+
+  template <typename T>
+  using TypesByMutability = std::array<T, 2>;
+
+  using TypeMap = std::unordered_map<const Type*, std::shared_ptr<Type>>;
+
+  using TypeMapBySize
+    = std::unordered_map<std::uint64_t, std::shared_ptr<Type>>;
+
+  CGContext& ctx;
+
+  std::array<TypesByMutability<std::shared_ptr<Type>>, num_builtin_types>
+    builtin_types;
+
+  TypesByMutability<TypeMap> pointer_types;
+
+  // Keyed by the element types and then by the sizes
+  TypesByMutability<std::unordered_map<const Type*, TypeMapBySize>>
+    array_types;
+
+  TypesByMutability<TypeMap> reference_types;
+
+  // Keyed by the identities of the class and union types
+  TypesByMutability<TypeMap> variant_types;
 };
 
+// Throws if the type does not name a known type
+void verifyType(CGContext&                   ctx,
+                const std::shared_ptr<Type>& type,
+                const PositionRange&         pos);
+
 [[nodiscard]] std::shared_ptr<Type>
 createType(CGContext& ctx, const ast::Type& ast, const PositionRange& pos);
 
@@ -16,10 +16,17 @@
 #include <optional>
 #include <variant>
 #include <filesystem>
+#include <ostream>
+#include <memory>
 
 namespace twinkle
 {
 
+namespace parse
+{
+struct ImportCache;
+} // namespace parse
+
 struct JITResult {
   explicit JITResult(const int exit_status) noexcept
     : exit_status{exit_status}
@@ -30,20 +37,40 @@ struct JITResult {
 };
 
 struct AOTResult {
-  explicit AOTResult(
-    std::vector<std::filesystem::path>&& created_files) noexcept
+  explicit AOTResult(std::vector<std::filesystem::path>&& created_files,
+                     std::vector<std::string>&& linker_options = {}) noexcept
     : created_files{std::move(created_files)}
+    , linker_options{std::move(linker_options)}
   {
   }
 
   const std::vector<std::filesystem::path> created_files;
+
+  // Additional arguments the linker needs for the created files
+  const std::vector<std::string> linker_options;
 };
 
 using CompileResult = std::variant<JITResult, AOTResult>;
 
+// Imported files are parsed once in the process
 std::optional<CompileResult> compile(const Context&         ctx,
                                      const std::string_view argv_front);
 
+// Imported files are looked up in 'import_cache' before they are parsed
+std::optional<CompileResult>
+compile(const Context&                             ctx,
+        const std::string_view                     argv_front,
+        const std::shared_ptr<parse::ImportCache>& import_cache);
+
+// Writes the statistics of the compilation cache in the directory
+void writeCacheStatistics(std::ostream&                ostm,
+                          const std::filesystem::path& cache_dir,
+                          const std::uintmax_t         max_size);
+
+// Removes all cached outputs in the directory
+// Returns false if they could not be removed
+[[nodiscard]] bool clearCache(const std::filesystem::path& cache_dir);
+
 } // namespace twinkle
 
 #endif
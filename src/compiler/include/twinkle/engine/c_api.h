@@ -0,0 +1,88 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _ea5f6561_0eac_4521_bae0_1a790c3b6677
+#define _ea5f6561_0eac_4521_bae0_1a790c3b6677
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+/* C interface of twinkle::Engine, see twinkle/engine/engine.hpp */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct twinkle_engine twinkle_engine;
+
+typedef uint64_t twinkle_module;
+
+typedef struct twinkle_engine_options {
+  unsigned int opt_level;
+
+  /* NULL for the defaults */
+  const char* cpu;
+  const char* cpu_features;
+
+  /* 0 for all hardware threads */
+  unsigned int jit_threads;
+} twinkle_engine_options;
+
+/* Valid as long as the engine, until its next call */
+typedef struct twinkle_diagnostic {
+  const char* file;
+  size_t      line;
+  size_t      column;
+  const char* message;
+} twinkle_diagnostic;
+
+/* Sets the defaults to 'options' */
+void twinkle_engine_options_init(twinkle_engine_options* options);
+
+/* 'options' may be NULL for the defaults
+ * Returns NULL if the JIT cannot be created; see
+ * twinkle_engine_create_error */
+twinkle_engine* twinkle_engine_create(const twinkle_engine_options* options);
+
+/* Reasons why the last twinkle_engine_create on the calling thread returned
+ * NULL, one per line, or NULL if it succeeded
+ * Valid until the next twinkle_engine_create on the thread */
+const char* twinkle_engine_create_error(void);
+
+void twinkle_engine_destroy(twinkle_engine* engine);
+
+/* 'source' need not be null-terminated
+ * Returns 0 and sets 'module' on success */
+int twinkle_engine_add_module(twinkle_engine* engine,
+                              const char*     name,
+                              const char*     source,
+                              size_t          source_size,
+                              twinkle_module* module);
+
+/* Returns 0 on success */
+int twinkle_engine_remove_module(twinkle_engine* engine,
+                                 twinkle_module  module);
+
+/* Returns NULL if the function is not found */
+void* twinkle_engine_lookup(twinkle_engine* engine, const char* name);
+
+/* Errors of the last call */
+size_t twinkle_engine_diagnostic_count(const twinkle_engine* engine);
+
+/* Returns a diagnostic whose strings are NULL if 'index' is out of range */
+twinkle_diagnostic twinkle_engine_diagnostic(const twinkle_engine* engine,
+                                             size_t                index);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif
@@ -0,0 +1,103 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _58506137_7018_496f_a4d4_e98ccf3ad4dc
+#define _58506137_7018_496f_a4d4_e98ccf3ad4dc
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <context.hpp>
+#include <twinkle/support/diagnostic.hpp>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace twinkle
+{
+
+struct EngineOptions {
+  unsigned int opt_level = DEFAULT_OPT_LEVEL;
+
+  // The same as --mcpu and --mattr
+  std::string cpu = "generic";
+  std::string cpu_features;
+
+  // Number of threads that compile modules, or 0 for all hardware threads
+  unsigned int jit_threads = 0;
+
+  // The same as --x3-parser, also used for the imported files
+  bool x3_parser = false;
+};
+
+// Identifies a module added to an engine
+using ModuleHandle = std::uint64_t;
+
+// Compiles Twinkle code from memory and runs it in the calling process
+//
+// The target and the JIT session live as long as the engine, so each module
+// costs only its own compilation. Functions are compiled lazily, when they are
+// first called. Modules added later can call the public functions of those
+// added before, through declarations of them.
+//
+// Calls to an engine must not overlap, but the functions looked up from it can
+// be called from any thread.
+struct Engine {
+  // Returns nullptr if the JIT cannot be created for the options, and the
+  // reasons in 'diagnostics'
+  [[nodiscard]] static std::unique_ptr<Engine>
+  create(const EngineOptions& options, std::vector<Diagnostic>& diagnostics);
+
+  ~Engine();
+
+  Engine(const Engine&)            = delete;
+  Engine& operator=(const Engine&) = delete;
+
+  // Compiles 'source' as a module named 'name'
+  // The name is the file name of diagnostics, and imports are resolved
+  // relative to it
+  // Returns std::nullopt if the module has errors; see getDiagnostics()
+  [[nodiscard]] std::optional<ModuleHandle> addModule(const std::string& name,
+                                                      std::string source);
+
+  // Frees the code of the module
+  // Functions looked up from it must not be running or called after this
+  // Returns false if it could not be removed; see getDiagnostics()
+  bool removeModule(const ModuleHandle module);
+
+  // Returns the address of the function 'name' in the global namespace of the
+  // added modules, or of the symbol 'name'
+  // Overloaded functions can be looked up only by their symbols
+  // Returns nullptr if there is no such function; see getDiagnostics()
+  [[nodiscard]] void* lookupAddress(const std::string& name);
+
+  // The type 'F' must be the signature of the function, e.g. int(int)
+  template <typename F>
+    requires std::is_function_v<F>
+  [[nodiscard]] F* lookup(const std::string& name)
+  {
+    return reinterpret_cast<F*>(lookupAddress(name));
+  }
+
+  // Errors of the last call, which are empty if it succeeded
+  [[nodiscard]] const std::vector<Diagnostic>& getDiagnostics() const noexcept;
+
+private:
+  struct Impl;
+
+  explicit Engine(std::unique_ptr<Impl> impl);
+
+  std::unique_ptr<Impl> impl;
+};
+
+} // namespace twinkle
+
+#endif
@@ -0,0 +1,51 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _c75ed2c8_e3b8_4b5a_9561_2145e6f60c86
+#define _c75ed2c8_e3b8_4b5a_9561_2145e6f60c86
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace twinkle::jit
+{
+
+// The return value is ignored, so any return type can be called as this
+using BenchmarkedFunction = void (*)();
+
+struct BenchmarkOptions {
+  // Name of the function, which takes no arguments
+  std::string symbol;
+
+  std::uint64_t iterations;
+
+  // Calls before the measured ones, which are not measured
+  std::uint64_t warmup;
+
+  // Counts the cycles and instructions of each call
+  bool counters;
+};
+
+// Calls 'func' 'options.warmup' times, then 'after_warmup', and then calls
+// 'func' 'options.iterations' times and prints the statistics of their
+// durations to 'ostm'
+void runBenchmark(const BenchmarkedFunction   func,
+                  const BenchmarkOptions&      options,
+                  const std::function<void()>& after_warmup,
+                  std::ostream&                ostm,
+                  const std::string_view       argv_front);
+
+} // namespace twinkle::jit
+
+#endif
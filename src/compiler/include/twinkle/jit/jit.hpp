@@ -13,19 +13,69 @@
 #endif // _MSC_VER > 1000
 
 #include <twinkle/pch/pch.hpp>
+#include <twinkle/support/target.hpp>
+#include <twinkle/jit/object_cache.hpp>
+#include <twinkle/jit/task_dispatcher.hpp>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
 
 namespace twinkle::jit
 {
 
+struct TieringOptions {
+  // Number of calls and loop iterations after which a function is compiled
+  // again with full optimization
+  // Tiering is disabled if 0
+  std::uint64_t threshold;
+
+  // Prints each function compiled again to stderr
+  bool print_tier_up;
+};
+
+struct DebugOptions {
+  // Tells perf the names and code of the compiled functions
+  bool perf;
+
+  // Registers the compiled objects with GDB through its JIT interface
+  bool gdb;
+};
+
+// Functions are compiled lazily, when they are first called
+// Modules are compiled on a pool of threads
+//
+// With tiering, each module is first compiled quickly without optimization,
+// and its functions count their calls and loop iterations. Every call goes
+// through a stub. Functions that reach the threshold are optimized and
+// compiled again on a background thread, and their stubs are pointed to the
+// new code. Calls that have already started keep running the old code.
+// Modules start compiling in the background once all of them have been added,
+// so independent modules compile in parallel ahead of their first calls.
 struct JitCompiler {
-  JitCompiler(std::unique_ptr<llvm::orc::ExecutionSession>    exec_session,
-              std::unique_ptr<llvm::orc::EPCIndirectionUtils> epciu,
-              llvm::orc::JITTargetMachineBuilder              jit_tmb,
-              llvm::DataLayout                                data_layout);
+  JitCompiler(
+    std::unique_ptr<llvm::orc::ExecutionSession>    exec_session,
+    std::unique_ptr<llvm::orc::EPCIndirectionUtils> epciu,
+    llvm::orc::JITTargetMachineBuilder              jit_tmb,
+    llvm::orc::JITTargetMachineBuilder              optimized_jit_tmb,
+    llvm::DataLayout                                data_layout,
+    std::unique_ptr<ObjectCache>                    object_cache,
+    std::unique_ptr<ObjectCache>                    optimized_object_cache,
+    const TieringOptions&                           tiering,
+    std::vector<std::unique_ptr<llvm::orc::ObjectLinkingLayer::Plugin>>
+      object_layer_plugins);
 
   ~JitCompiler();
 
-  [[nodiscard]] static llvm::Expected<std::unique_ptr<JitCompiler>> create();
+  // Compiled objects are kept in 'cache' if it is not null
+  [[nodiscard]] static llvm::Expected<std::unique_ptr<JitCompiler>>
+  create(const TargetCPU&              target_cpu,
+         const llvm::CodeGenOpt::Level opt_level,
+         cache::Cache*                 cache,
+         const TieringOptions&         tiering,
+         const unsigned int            num_threads,
+         const DebugOptions&           debug);
 
   [[nodiscard]] const llvm::DataLayout& getDataLayout() const
   {
@@ -37,6 +87,9 @@ struct JitCompiler {
     return main_jd;
   }
 
+  // Without tiering, a module added with a resource tracker is compiled as a
+  // whole, so that removing the tracker frees all of its code
+  // Modules are compiled in the background by 'compileAddedModules'
   [[nodiscard]] llvm::Error
   addModule(llvm::orc::ThreadSafeModule  thread_safe_module,
             llvm::orc::ResourceTrackerSP resource_tracker = nullptr);
@@ -47,6 +100,19 @@ struct JitCompiler {
     return exec_session->lookup({&main_jd}, mangle(name.str()));
   }
 
+  // Starts compiling the modules added since the last call without waiting for
+  // their first calls
+  // A module fails to compile if the symbols it refers to are not defined yet,
+  // so this is called once the modules they are defined in have been added
+  void compileAddedModules();
+
+  // With tiering, compiles the function again with optimization without
+  // waiting for it to reach the threshold
+  void requestTierUp(const std::string& name);
+
+  // Waits until the functions that have reached the threshold are tiered up
+  void waitForTierUps();
+
 private:
   std::unique_ptr<llvm::orc::ExecutionSession>    exec_session;
   std::unique_ptr<llvm::orc::EPCIndirectionUtils> epciu;
@@ -54,22 +120,100 @@ private:
   llvm::DataLayout             data_layout;
   llvm::orc::MangleAndInterner mangle;
 
-  llvm::orc::RTDyldObjectLinkingLayer object_layer;
-  llvm::orc::IRCompileLayer           compile_layer;
-  llvm::orc::IRTransformLayer         optimize_layer;
-  llvm::orc::CompileOnDemandLayer     cod_layer;
+  // Used by the compile layers, so declared before them
+  std::unique_ptr<ObjectCache> object_cache;
+  std::unique_ptr<ObjectCache> optimized_object_cache;
+
+  const TieringOptions tiering;
+
+  llvm::orc::ObjectLinkingLayer   object_layer;
+  llvm::orc::IRCompileLayer       compile_layer;
+  llvm::orc::IRTransformLayer     optimize_layer;
+  llvm::orc::CompileOnDemandLayer cod_layer;
+
+  // Used for the functions that are tiered up
+  llvm::orc::JITTargetMachineBuilder optimized_jit_tmb;
+  llvm::orc::IRCompileLayer          optimized_compile_layer;
 
   llvm::orc::JITDylib& main_jd;
 
+  // With tiering, the main dylib holds the stubs of the functions, and these
+  // hold their definitions under names with a suffix for each tier
+  llvm::orc::JITDylib& baseline_jd;
+  llvm::orc::JITDylib& optimized_jd;
+
+  std::unique_ptr<llvm::orc::IndirectStubsManager> stubs_manager;
+
+  // Bitcode of the module of each compiled function before it is
+  // instrumented, by the name of its stub
+  // Functions of the same module share it
+  std::unordered_map<std::string, std::shared_ptr<const std::string>>
+    baseline_bitcode;
+
+  // Guards the members for tiering
+  std::mutex tier_up_mutex;
+
+  std::condition_variable tier_up_cv;
+
+  // Names of the functions waiting to be tiered up
+  std::deque<std::string> tier_up_queue;
+
+  // Names of the functions queued so far, which are tiered up only once
+  std::unordered_set<std::string> tier_up_queued;
+
+  bool tier_up_stopped = false;
+
+  // Whether a function is being tiered up
+  bool tier_up_running = false;
+
+  // Notified when a function has been tiered up
+  std::condition_variable tier_up_done_cv;
+
+  std::thread tier_up_thread;
+
+  struct ModuleToCompile {
+    llvm::orc::JITDylib*       jd;
+    llvm::orc::SymbolLookupSet symbols;
+
+    // Whether the symbols are stubs of the compile on demand layer, whose
+    // definitions are in the dylib of the layer
+    bool on_demand;
+  };
+
+  // Modules to compile in the background
+  std::vector<ModuleToCompile> modules_to_compile;
+
   static void handleLazyCallThroughError()
   {
     llvm::errs() << "LazyCallThrough error: Could not find function body";
     exit(1);
   }
 
-  [[nodiscard]] static llvm::Expected<llvm::orc::ThreadSafeModule>
+  [[nodiscard]] llvm::Expected<llvm::orc::ThreadSafeModule>
   optimizeModule(llvm::orc::ThreadSafeModule tsm,
                  const llvm::orc::MaterializationResponsibility&);
+
+  // Starts compiling the module without waiting for it
+  void compileInBackground(ModuleToCompile module);
+
+  // Instruments the module for tiering and keeps its bitcode
+  [[nodiscard]] llvm::Expected<llvm::orc::ThreadSafeModule>
+  instrumentModule(llvm::orc::ThreadSafeModule tsm,
+                   const llvm::orc::MaterializationResponsibility&);
+
+  // Called by instrumented functions that reach the threshold
+  static void onThresholdReached(JitCompiler* jit, const char* name);
+
+  void queueTierUp(const std::string& name);
+
+  void runTierUpThread();
+
+  [[nodiscard]] llvm::Error tierUp(const std::string& name);
+
+  // Returns a module of the optimized function, with the bodies of the
+  // functions it calls available for inlining
+  [[nodiscard]] llvm::Expected<llvm::orc::ThreadSafeModule>
+  createOptimizedModule(const std::string& name);
 };
 
 } // namespace twinkle::jit
@@ -0,0 +1,74 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _7d2c5e81_3f4a_4b9c_a6d0_8e1f2b5c9a47
+#define _7d2c5e81_3f4a_4b9c_a6d0_8e1f2b5c9a47
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <twinkle/pch/pch.hpp>
+#include <twinkle/cache/cache.hpp>
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <mutex>
+
+namespace twinkle::jit
+{
+
+// Keeps the objects compiled by the JIT in the compilation cache, so that
+// modules compiled by earlier runs are loaded instead of compiled again
+// Modules are keyed by their bitcode and the settings of the target machine
+struct ObjectCache : public llvm::ObjectCache {
+  ObjectCache(cache::Cache&                             cache,
+              const llvm::orc::JITTargetMachineBuilder& jit_tmb,
+              const llvm::CodeGenOpt::Level             opt_level);
+
+  void notifyObjectCompiled(const llvm::Module*         module,
+                            const llvm::MemoryBufferRef object) override;
+
+  [[nodiscard]] std::unique_ptr<llvm::MemoryBuffer>
+  getObject(const llvm::Module* module) override;
+
+  // Looks up the object of the module before it is transformed, e.g.
+  // optimized, so that the transform can be skipped if it is found
+  // The module is then keyed as it was when looked up, and 'getObject'
+  // returns the object found for it
+  [[nodiscard]] bool lookupBeforeTransform(const llvm::Module& module);
+
+private:
+  [[nodiscard]] std::string createKey(const llvm::Module& module) const;
+
+  // Returns nullptr if the object is not cached
+  [[nodiscard]] std::unique_ptr<llvm::MemoryBuffer>
+  load(const std::string& key) const;
+
+  struct EarlyLookup {
+    std::string key;
+
+    // nullptr if not found
+    std::unique_ptr<llvm::MemoryBuffer> object;
+  };
+
+  cache::Cache& cache;
+
+  // Covers everything but the module
+  const std::string target_key;
+
+  // Code generation modifies the module, so the key is created when it is
+  // looked up and kept until it is compiled
+  std::unordered_map<const llvm::Module*, std::string> pending_keys;
+
+  // Looked up by 'lookupBeforeTransform' and not yet by 'getObject'
+  std::unordered_map<const llvm::Module*, EarlyLookup> early_lookups;
+
+  std::mutex mutex;
+};
+
+} // namespace twinkle::jit
+
+#endif
@@ -0,0 +1,82 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _f14bea32_c24a_4467_97c0_d9de6921f900
+#define _f14bea32_c24a_4467_97c0_d9de6921f900
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <twinkle/pch/pch.hpp>
+#include <llvm/ExecutionEngine/Orc/ObjectLinkingLayer.h>
+#include <mutex>
+
+namespace twinkle::jit
+{
+
+// Tells perf where the JIT placed each function
+//
+// Writes /tmp/perf-<pid>.map, which 'perf report' reads to name addresses,
+// and /tmp/jit-<pid>.dump in the jitdump format, which 'perf inject --jit'
+// turns into shared objects so that the code itself can be annotated
+// The dump is recorded only with 'perf record -k mono', as its timestamps
+// are taken from the monotonic clock
+struct PerfPlugin : public llvm::orc::ObjectLinkingLayer::Plugin {
+  [[nodiscard]] static llvm::Expected<std::unique_ptr<PerfPlugin>>
+  create(const llvm::Triple& target_triple);
+
+  ~PerfPlugin() override;
+
+  void
+  modifyPassConfig(llvm::orc::MaterializationResponsibility& r,
+                   llvm::jitlink::LinkGraph&                 graph,
+                   llvm::jitlink::PassConfiguration&         config) override;
+
+  [[nodiscard]] llvm::Error
+  notifyFailed(llvm::orc::MaterializationResponsibility& r) override
+  {
+    return llvm::Error::success();
+  }
+
+  [[nodiscard]] llvm::Error
+  notifyRemovingResources(llvm::orc::ResourceKey key) override
+  {
+    return llvm::Error::success();
+  }
+
+  void notifyTransferringResources(llvm::orc::ResourceKey dst_key,
+                                   llvm::orc::ResourceKey src_key) override
+  {
+  }
+
+private:
+  PerfPlugin(std::unique_ptr<llvm::raw_fd_ostream> perf_map,
+             std::unique_ptr<llvm::raw_fd_ostream> jitdump,
+             void* const                           jitdump_marker,
+             const std::size_t                     jitdump_marker_size);
+
+  // Records the functions of the graph, whose addresses are final
+  void recordFunctions(const llvm::jitlink::LinkGraph& graph);
+
+  std::unique_ptr<llvm::raw_fd_ostream> perf_map;
+  std::unique_ptr<llvm::raw_fd_ostream> jitdump;
+
+  // perf finds the dump through this mapping of it
+  void* const       jitdump_marker;
+  const std::size_t jitdump_marker_size;
+
+  // Index of the next function in the dump
+  std::uint64_t code_index = 0;
+
+  // Graphs are linked in parallel
+  std::mutex mutex;
+};
+
+} // namespace twinkle::jit
+
+#endif
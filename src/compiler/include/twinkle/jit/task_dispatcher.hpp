@@ -0,0 +1,55 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _83f348fb_d020_4b01_9218_744bba4640d5
+#define _83f348fb_d020_4b01_9218_744bba4640d5
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <twinkle/pch/pch.hpp>
+#include <llvm/ExecutionEngine/Orc/TaskDispatch.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace twinkle::jit
+{
+
+// Runs the tasks of the JIT, such as compiling modules, on a fixed number of
+// threads
+// The threads join the time trace if a session is active when they start
+struct TaskDispatcher : public llvm::orc::TaskDispatcher {
+  explicit TaskDispatcher(const unsigned int num_threads);
+
+  ~TaskDispatcher() override;
+
+  void dispatch(std::unique_ptr<llvm::orc::Task> task) override;
+
+  // Runs the remaining tasks and stops the threads
+  // Tasks dispatched after this run on the calling thread
+  void shutdown() override;
+
+private:
+  void runWorker();
+
+  std::mutex mutex;
+
+  std::condition_variable cv;
+
+  std::deque<std::unique_ptr<llvm::orc::Task>> tasks;
+
+  bool stopped = false;
+
+  std::vector<std::thread> workers;
+};
+
+} // namespace twinkle::jit
+
+#endif
@@ -0,0 +1,48 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _e4a1c6f2_8d3b_4b7e_9f05_6a2d1c3b8e94
+#define _e4a1c6f2_8d3b_4b7e_9f05_6a2d1c3b8e94
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace twinkle::linker
+{
+
+#define LINKER_GCC_ARG "gcc"
+#define LINKER_LD_ARG  "ld"
+#define LINKER_LLD_ARG "lld"
+
+// Returns false if the linker is unknown, or if it is LLD and twinkle was
+// built without it
+[[nodiscard]] bool isLinkerAvailable(const std::string_view linker);
+
+// 'gcc' runs the gcc driver through the shell
+// 'ld' runs the system linker directly, with the C runtime that the C compiler
+// of the build links with
+// 'lld' links in the process with the same C runtime as 'ld'
+// Position independent executables are created if 'pie' is true, except with
+// 'gcc', which creates what it does by default
+// Returns the exit status of the linker, or std::nullopt if it could not be run
+[[nodiscard]] std::optional<int>
+link(const std::string_view                    linker,
+     const std::vector<std::filesystem::path>& files,
+     const std::vector<std::string>&           linked_libs,
+     const std::vector<std::string>&           linker_options,
+     const bool                                pie);
+
+} // namespace twinkle::linker
+
+#endif
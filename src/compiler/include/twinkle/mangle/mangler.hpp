@@ -46,22 +46,11 @@ struct Mangler : private boost::noncopyable {
                          const ast::FunctionDecl&      decl,
                          const ast::TemplateArguments& template_args) const;
 
-  [[nodiscard]] std::vector<std::string>
-  mangleFunctionCall(const std::string_view   callee,
-                     const std::deque<Value>& args) const;
-
   [[nodiscard]] std::vector<std::string>
   mangleFunctionTemplateCall(const std::string_view        callee,
                              const ast::TemplateArguments& template_args,
                              const std::deque<Value>&      args) const;
 
-  // The mangled this pointer type is inserted automatically
-  [[nodiscard]] std::vector<std::string>
-  mangleMethodCall(const std::string_view   callee,
-                   const std::string&       class_name,
-                   const std::deque<Value>& args,
-                   const Accessibility      accessibility) const;
-
   // Return results stored in order of priority
   [[nodiscard]] std::vector<std::string>
   mangleConstructorCall(const std::deque<Value>& args) const;
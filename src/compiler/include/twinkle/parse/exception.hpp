@@ -22,6 +22,11 @@ struct ParseError : public ErrorBase {
     : ErrorBase{what_arg}
   {
   }
+
+  explicit ParseError(FormattedDiagnostic&& diagnostic)
+    : ErrorBase{std::move(diagnostic)}
+  {
+  }
 };
 
 } // namespace twinkle::parse
@@ -0,0 +1,63 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _0c8d4b9e_6f4a_4d2c_9b57_3e1f2a7c5d60
+#define _0c8d4b9e_6f4a_4d2c_9b57_3e1f2a7c5d60
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <twinkle/parse/parser.hpp>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace twinkle::parse
+{
+
+// Parse results of imported files, keyed by canonical path and parser kind,
+// and checked against the modification time and size
+// Safe to use from multiple threads; a file that another thread is parsing is
+// waited for instead of being parsed again
+struct ImportCache : private boost::noncopyable {
+  using ResultPtr = std::shared_ptr<const Parser::Result>;
+
+  // Shared by all compilations in the process
+  [[nodiscard]] static const std::shared_ptr<ImportCache>& getInstance();
+
+  // Returns the cached result of the file if it has not been modified since it
+  // was parsed by a parser of 'kind'; otherwise, parses it with 'parse', which
+  // uses a parser of 'kind', and caches the result
+  // Errors thrown by 'parse' are not cached
+  // The file of the result is the canonical path, since the result is shared
+  // by importers that spell the path differently
+  [[nodiscard]] ResultPtr load(const std::filesystem::path&           path,
+                               const ParserKind                       kind,
+                               const std::function<Parser::Result()>& parse);
+
+private:
+  struct Entry {
+    std::filesystem::file_time_type last_write_time;
+    std::uintmax_t                  file_size;
+
+    // Ready once the file has been parsed
+    std::shared_future<ResultPtr> result;
+  };
+
+  std::mutex mutex;
+
+  // Keyed by the canonical path and the parser kind
+  std::map<std::pair<std::string, ParserKind>, Entry> entries;
+};
+
+} // namespace twinkle::parse
+
+#endif
@@ -0,0 +1,44 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _0efea87e_1250_4e34_991b_0305fb12461e
+#define _0efea87e_1250_4e34_991b_0305fb12461e
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <twinkle/parse/parser.hpp>
+#include <array>
+#include <optional>
+
+namespace twinkle::parse
+{
+
+// Interface files hold what importing a file needs: its public functions
+// without their bodies, its public classes with only the bodies of templates,
+// and its public unions
+// They are kept as source code, so they are parsed by the same parser, and
+// each declaration is on the same line as in its source file, so that errors
+// refer to the source
+
+// The interface of a source file is next to it, e.g. a.twki for a.twk
+[[nodiscard]] std::filesystem::path
+getInterfacePath(const std::filesystem::path& source_file);
+
+void writeInterface(const Parser::Result&        result,
+                    const std::filesystem::path& output_file,
+                    const std::string_view       argv_front);
+
+// Returns the declarations in the interface of the source file if it is up to
+// date with the source file, or the source file does not exist
+[[nodiscard]] std::optional<std::string>
+loadInterface(const std::filesystem::path& source_file);
+
+} // namespace twinkle::parse
+
+#endif
@@ -0,0 +1,83 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _288b30e7_451b_4cc8_880c_64012d5dcbda
+#define _288b30e7_451b_4cc8_880c_64012d5dcbda
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <string_view>
+#include <optional>
+#include <variant>
+#include <vector>
+#include <cstdint>
+
+namespace twinkle::parse
+{
+
+// Tokens are split by the same character classes as the grammar
+// Operators are not joined, e.g. '<<' is two punctuation tokens, since whether
+// they are one operator depends on where they are, e.g. the end of nested
+// template arguments
+enum class TokenKind : std::uint8_t {
+  identifier,
+  number,
+  string_literal,
+  char_literal,
+
+  // Literals without the closing quote, ending where it is expected
+  unterminated_string_literal,
+  unterminated_char_literal,
+
+  punct, // One character
+  eoi,
+};
+
+struct Token {
+  TokenKind kind;
+
+  // Offsets in bytes
+  std::size_t first;
+  std::size_t last;
+};
+
+// Spaces and comments are skipped
+// The last token is eoi
+[[nodiscard]] std::vector<Token> tokenize(const std::string_view input);
+
+// Returns the offset of the first character after spaces and comments
+[[nodiscard]] std::size_t skipSpaces(const std::string_view input,
+                                     std::size_t            offset);
+
+// Unicode spaces, which are not always skipped
+[[nodiscard]] bool isSpace(const std::string_view input,
+                           const std::size_t      offset);
+
+// Reads a character or an escape sequence of a string or character literal
+// that is closed by 'quote'
+// Returns std::nullopt at the end of the literal or an invalid character
+[[nodiscard]] std::optional<char32_t> readLiteralChar(
+  const std::string_view input,
+  std::size_t&           offset,
+  const char             quote);
+
+// The type of a numeric literal is the first of these that can be read
+using NumberValue = std::
+  variant<double, std::uint32_t, std::int32_t, std::uint64_t, std::int64_t>;
+
+[[nodiscard]] std::optional<NumberValue>
+readNumber(const std::string_view input, std::size_t& offset);
+
+// Returns the end of the path of the import declaration at 'offset'
+[[nodiscard]] std::size_t scanPath(const std::string_view input,
+                                   std::size_t            offset);
+
+} // namespace twinkle::parse
+
+#endif
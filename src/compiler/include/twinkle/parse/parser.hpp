@@ -15,17 +15,25 @@
 #include <twinkle/ast/ast.hpp>
 #include <twinkle/support/utils.hpp>
 #include <twinkle/support/typedef.hpp>
+#include <twinkle/support/diagnostic.hpp>
+#include <twinkle/support/source.hpp>
+#include <twinkle/support/position.hpp>
 
 namespace twinkle::parse
 {
 
+enum class ParserKind {
+  recursive_descent,
+  x3, // The grammar written with Boost.Spirit X3
+};
+
 struct Parser : private boost::noncopyable {
   struct Result {
-    // Since positions has a reference to input, it also holds input
-    std::string input;
+    // Since positions refer to the source, it also holds the source
+    SourceBufferPtr source;
 
     ast::TranslationUnit  ast;
-    PositionCache         positions;
+    PositionTablePtr      positions;
     std::filesystem::path file;
   };
 
@@ -35,29 +43,45 @@ struct Parser : private boost::noncopyable {
 
     member_moved = true;
 
-    // The reason for also returning input is that positions has a reference to
-    // input
-    return {std::move(input),
+    // The reason for also returning the source is that positions refer to it
+    return {std::move(source),
             std::move(ast),
             std::move(positions),
             std::move(file)};
   }
 
-  Parser(std::string&& input, const std::filesystem::path& file);
+  // Syntax errors are written to 'diagnostics'
+  Parser(SourceBufferPtr&&            source,
+         const std::filesystem::path& file,
+         const ParserKind             kind,
+         std::ostream&                diagnostics = std::cerr);
+
+  // For sources that are not loaded from files
+  Parser(std::string&&                input,
+         const std::filesystem::path& file,
+         const ParserKind             kind,
+         std::ostream&                diagnostics = std::cerr);
 
 private:
-  void parse();
+  void parse(const ParserKind kind);
+
+  // Returns false if there is a syntax error
+  [[nodiscard]] bool parseWithX3(Diagnostic& diagnostic);
+
+  [[nodiscard]] bool parseWithRecursiveDescent(Diagnostic& diagnostic);
 
   bool member_moved = false;
 
-  std::string         input;
+  SourceBufferPtr     source;
   InputIterator       u32_first;
   const InputIterator u32_last;
 
-  ast::TranslationUnit ast;
-  PositionCache        positions;
+  ast::TranslationUnit           ast;
+  std::shared_ptr<PositionTable> positions;
 
   std::filesystem::path file;
+
+  std::ostream& diagnostics;
 };
 
 } // namespace twinkle::parse
@@ -0,0 +1,41 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _d37a3acb_8cff_405d_9a2e_ae2deb1fc9ae
+#define _d37a3acb_8cff_405d_9a2e_ae2deb1fc9ae
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <twinkle/ast/ast.hpp>
+#include <twinkle/support/position.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace twinkle::parse
+{
+
+struct SyntaxError {
+  // Offset in bytes
+  std::size_t where;
+
+  // Name of the rule of the grammar or the quoted literal
+  std::string expected;
+};
+
+// Builds the same AST and positions as the grammar from the tokens of the
+// input, and stops at the first syntax error
+[[nodiscard]] std::optional<SyntaxError>
+parseRecursiveDescent(const std::string_view input,
+                      ast::TranslationUnit&  ast,
+                      PositionTable&         positions);
+
+} // namespace twinkle::parse
+
+#endif
@@ -0,0 +1,39 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _5b0e9a31_2c7d_4f86_a4e3_91d6c2f08b17
+#define _5b0e9a31_2c7d_4f86_a4e3_91d6c2f08b17
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <context.hpp>
+#include <twinkle/compile/compile.hpp>
+#include <filesystem>
+#include <string_view>
+
+namespace twinkle::server
+{
+
+// Compiles the requests of clients on the Unix domain socket until SIGINT or
+// SIGTERM is received
+// Targets, target machines and parsed imports are kept between requests
+// Returns the exit status
+[[nodiscard]] int runServer(const std::filesystem::path& socket_path,
+                            const std::string_view       argv_front);
+
+// Compiles on the server listening on 'ctx.server_socket'
+// Compiles in this process instead if no server of the same version is
+// listening, if the program is JIT-compiled, since it runs where it is
+// compiled, or if the compilation is profiled
+std::optional<CompileResult> compileOnServer(const Context&         ctx,
+                                             const std::string_view argv_front);
+
+} // namespace twinkle::server
+
+#endif
@@ -0,0 +1,35 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _69d9e803_d59d_407f_93b3_7e675d08cddf
+#define _69d9e803_d59d_407f_93b3_7e675d08cddf
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <cstddef>
+#include <string>
+
+namespace twinkle
+{
+
+// An error in the form that programs can inspect, without colors
+struct Diagnostic {
+  std::string file;
+
+  // Both start from 1, and are 0 if the error is not at a position in the file
+  // The column counts characters, not bytes
+  std::size_t line;
+  std::size_t column;
+
+  std::string message;
+};
+
+} // namespace twinkle
+
+#endif
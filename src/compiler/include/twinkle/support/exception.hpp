@@ -13,16 +13,38 @@
 #endif // _MSC_VER > 1000
 
 #include <twinkle/pch/pch.hpp>
+#include <twinkle/support/diagnostic.hpp>
 #include <stdexcept>
 
 namespace twinkle
 {
 
+// A diagnostic and its text for the terminal
+struct FormattedDiagnostic {
+  std::string text;
+  Diagnostic  diagnostic;
+};
+
 struct ErrorBase : public std::runtime_error {
   explicit ErrorBase(const std::string& what_arg)
     : runtime_error{what_arg}
   {
   }
+
+  explicit ErrorBase(FormattedDiagnostic&& diagnostic)
+    : runtime_error{diagnostic.text}
+    , diagnostic{std::move(diagnostic.diagnostic)}
+  {
+  }
+
+  // Only errors in source files have it
+  [[nodiscard]] const std::optional<Diagnostic>& getDiagnostic() const noexcept
+  {
+    return diagnostic;
+  }
+
+private:
+  std::optional<Diagnostic> diagnostic;
 };
 
 } // namespace twinkle
@@ -14,6 +14,7 @@
 
 #include <twinkle/pch/pch.hpp>
 #include <twinkle/support/exception.hpp>
+#include <twinkle/support/source.hpp>
 
 namespace twinkle
 {
@@ -26,9 +27,15 @@ struct FileError : public ErrorBase {
   }
 };
 
-// Load a file to std::string.
-[[nodiscard]] std::string loadFile(const std::string_view       argv_front,
-                                   const std::filesystem::path& path);
+// Load a file to a shared source buffer.
+[[nodiscard]] SourceBufferPtr loadFile(const std::string_view       argv_front,
+                                       const std::filesystem::path& path);
+
+// Message of the error that happened while loading a file.
+[[nodiscard]] std::string_view describeLoadError(const std::error_code ec);
+
+// Returns a unique path in the temporary directory.
+[[nodiscard]] std::string createTemporaryFilepath();
 
 } // namespace twinkle
 
@@ -0,0 +1,35 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _de87fd52_b9e6_4ec0_bb78_cc5a5118738b
+#define _de87fd52_b9e6_4ec0_bb78_cc5a5118738b
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <cstddef>
+#include <functional>
+
+namespace twinkle
+{
+
+// Returns the number of worker threads to use for the value given to -j
+// 0 means the number of hardware threads
+[[nodiscard]] unsigned int resolveJobs(const unsigned int jobs) noexcept;
+
+// Calls 'fn' for every index in [0, count) on up to 'jobs' threads
+// If some calls throw, indices after the lowest failing one are not started
+// and the exception of the lowest failing index is rethrown, so the reported
+// error is the same as in serial execution
+void parallelFor(const std::size_t                              count,
+                 const unsigned int                             jobs,
+                 const std::function<void(const std::size_t)>& fn);
+
+} // namespace twinkle
+
+#endif
@@ -0,0 +1,97 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _b6ba7ad1_2413_4dc2_8956_d16569110db4
+#define _b6ba7ad1_2413_4dc2_8956_d16569110db4
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <twinkle/pch/pch.hpp>
+#include <twinkle/support/source.hpp>
+#include <twinkle/support/typedef.hpp>
+
+namespace twinkle
+{
+
+// Positions of the nodes of a file
+// Annotating a node sets 'id_first' to the index of its entry and 'id_last' to
+// the ID of the file, which is unique in the process, so that the table of any
+// node is found without searching
+struct PositionTable {
+  explicit PositionTable(const SourceBufferPtr& source);
+
+  // Offsets in bytes
+  template <typename AST>
+  void annotate(AST& ast, const std::size_t first, const std::size_t last)
+  {
+    if constexpr (std::is_base_of_v<boost::spirit::x3::position_tagged,
+                                    std::remove_const_t<AST>>) {
+      assert(first <= last && last <= source->getText().size());
+
+      ast.id_first = static_cast<int>(entries.size());
+      ast.id_last  = file_id;
+
+      entries.push_back({static_cast<std::uint32_t>(first),
+                         static_cast<std::uint32_t>(last - first)});
+    }
+  }
+
+  // Called by the grammar in the same way as boost::spirit::x3::position_cache
+  template <typename AST>
+  void annotate(AST& ast, const InputIterator& first, const InputIterator& last)
+  {
+    const auto text_first = source->getText().cbegin();
+
+    annotate(ast,
+             static_cast<std::size_t>(first.base() - text_first),
+             static_cast<std::size_t>(last.base() - text_first));
+  }
+
+  [[nodiscard]] bool
+  contains(const boost::spirit::x3::position_tagged& ast) const noexcept
+  {
+    return ast.id_last == file_id && 0 <= ast.id_first
+           && static_cast<std::size_t>(ast.id_first) < entries.size();
+  }
+
+  [[nodiscard]] PositionRange
+  positionOf(const boost::spirit::x3::position_tagged& ast) const
+  {
+    assert(contains(ast));
+
+    const auto& entry = entries[ast.id_first];
+
+    const auto first = source->getText().cbegin() + entry.offset;
+
+    return {InputIterator{first}, InputIterator{first + entry.length}};
+  }
+
+  [[nodiscard]] int getFileID() const noexcept
+  {
+    return file_id;
+  }
+
+private:
+  struct Entry {
+    std::uint32_t offset;
+    std::uint32_t length;
+  };
+
+  int file_id;
+
+  SourceBufferPtr source;
+
+  std::vector<Entry> entries;
+};
+
+using PositionTablePtr = std::shared_ptr<const PositionTable>;
+
+} // namespace twinkle
+
+#endif
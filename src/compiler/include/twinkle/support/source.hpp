@@ -0,0 +1,71 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _f8fe14b1_bd0a_4b61_b0ff_9494fd2291e0
+#define _f8fe14b1_bd0a_4b61_b0ff_9494fd2291e0
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <twinkle/pch/pch.hpp>
+#include <llvm/Support/ErrorOr.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <mutex>
+#include <string_view>
+
+namespace twinkle
+{
+
+// Source code shared by the parser, the positions and the diagnostics, so that
+// it is held only once however many of them refer to it
+struct SourceBuffer : private boost::noncopyable {
+  explicit SourceBuffer(std::unique_ptr<llvm::MemoryBuffer>&& buffer);
+
+  explicit SourceBuffer(std::string&& text);
+
+  [[nodiscard]] std::string_view getText() const noexcept
+  {
+    return text;
+  }
+
+  [[nodiscard]] bool contains(const char* const ptr) const noexcept
+  {
+    return text.data() <= ptr && ptr <= text.data() + text.size();
+  }
+
+  // Both start from 1, and a newline belongs to the line it ends
+  // The column counts characters, not bytes
+  [[nodiscard]] std::size_t getLine(const std::size_t offset) const;
+  [[nodiscard]] std::size_t getColumn(const std::size_t offset) const;
+
+  // Without the newline
+  [[nodiscard]] std::string_view getLineText(const std::size_t line) const;
+
+private:
+  // Computed the first time lines are needed, which is usually never
+  [[nodiscard]] const std::vector<std::size_t>& getLineStarts() const;
+
+  // One of them owns the text
+  const std::unique_ptr<llvm::MemoryBuffer> buffer;
+  const std::string                         owned;
+
+  const std::string_view text;
+
+  mutable std::once_flag           line_starts_flag;
+  mutable std::vector<std::size_t> line_starts;
+};
+
+using SourceBufferPtr = std::shared_ptr<const SourceBuffer>;
+
+// Maps the file read-only, unless it is too small to be worth it
+[[nodiscard]] llvm::ErrorOr<SourceBufferPtr>
+mapSourceFile(const std::filesystem::path& path);
+
+} // namespace twinkle
+
+#endif
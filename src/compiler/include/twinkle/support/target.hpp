@@ -0,0 +1,69 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _6a5d7804_3681_4369_b706_f8f3593cb107
+#define _6a5d7804_3681_4369_b706_f8f3593cb107
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <twinkle/pch/pch.hpp>
+#include <functional>
+#include <mutex>
+
+namespace twinkle
+{
+
+// CPU and features that the target machine generates code for
+struct TargetCPU {
+  std::string name;
+
+  // Comma separated, e.g. "+avx2,-fma"
+  std::string features;
+};
+
+// 'native' as the CPU name means the host CPU with all its features
+// The features given explicitly are applied after those of the host
+[[nodiscard]] TargetCPU resolveTargetCPU(const std::string& cpu,
+                                         const std::string& features);
+
+// Optimization level is assumed to be verified
+[[nodiscard]] llvm::CodeGenOpt::Level
+getCodeGenOptLevel(const unsigned int opt_level);
+
+// Initializes all targets, only the first time it is called in the process
+void initializeTargets();
+
+// Target machines kept for reuse until the process exits, so that a long-lived
+// process such as the compile server creates them only once
+struct TargetMachinePool : private boost::noncopyable {
+  // Goes back to the pool when released
+  using Handle = std::shared_ptr<llvm::TargetMachine>;
+
+  using Factory = std::function<std::unique_ptr<llvm::TargetMachine>()>;
+
+  [[nodiscard]] static TargetMachinePool& getInstance();
+
+  // A target machine is handed out to one user at a time, so it is never used
+  // by two threads at once
+  // 'key' must tell apart everything 'create' passes to the target
+  [[nodiscard]] Handle acquire(const std::string& key, const Factory& create);
+
+private:
+  TargetMachinePool() = default;
+
+  std::mutex mutex;
+
+  std::unordered_map<std::string,
+                     std::vector<std::unique_ptr<llvm::TargetMachine>>>
+    idle_machines;
+};
+
+} // namespace twinkle
+
+#endif
@@ -0,0 +1,51 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _9f3b6e24_51c8_4a0d_8e7f_2b4d6c1a9e35
+#define _9f3b6e24_51c8_4a0d_8e7f_2b4d6c1a9e35
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <boost/noncopyable.hpp>
+#include <filesystem>
+#include <string_view>
+
+namespace twinkle
+{
+
+// Profiles the compiler while alive and writes the trace to 'path' in the
+// Chrome trace event format, as clang's -ftime-trace does
+// Spans shorter than 'granularity' microseconds are omitted
+// Threads started by parallelFor join the trace
+struct TimeTraceSession : private boost::noncopyable {
+  TimeTraceSession(const std::filesystem::path& path,
+                   const unsigned int           granularity,
+                   const std::string_view       argv_front);
+
+  ~TimeTraceSession();
+
+private:
+  const std::filesystem::path path;
+
+  const std::string_view argv_front;
+};
+
+// Joins the calling thread to the trace while alive, if a session is active
+struct TimeTraceThreadScope : private boost::noncopyable {
+  TimeTraceThreadScope();
+
+  ~TimeTraceThreadScope();
+
+private:
+  bool joined = false;
+};
+
+} // namespace twinkle
+
+#endif
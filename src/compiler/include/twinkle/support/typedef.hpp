@@ -22,10 +22,7 @@ namespace twinkle
 //===----------------------------------------------------------------------===//
 
 using InputIterator
-  = boost::u8_to_u32_iterator<std::string::const_iterator, char32_t>;
-
-using PositionCache
-  = boost::spirit::x3::position_cache<std::vector<InputIterator>>;
+  = boost::u8_to_u32_iterator<std::string_view::const_iterator, char32_t>;
 
 using PositionRange = boost::iterator_range<InputIterator>;
 
@@ -0,0 +1,465 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twinkle/cache/cache.hpp>
+#include <twinkle/support/utils.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/sync/file_lock.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+
+namespace twinkle::cache
+{
+
+namespace fs = std::filesystem;
+
+// Number of dependency sets remembered for one source key
+constexpr std::size_t max_manifest_entries = 8;
+
+// Eviction removes outputs until the cache is smaller than this ratio of the
+// maximum size, so that it does not run on every store
+constexpr double eviction_target_ratio = 0.9;
+
+Hasher& Hasher::add(const std::string_view value)
+{
+  sha1.update(std::to_string(value.size()) + ':');
+  sha1.update(llvm::StringRef{value.data(), value.size()});
+  return *this;
+}
+
+[[nodiscard]] std::string Hasher::finalize()
+{
+  return llvm::toHex(sha1.final(), true);
+}
+
+[[nodiscard]] std::optional<std::string> hashFile(const fs::path& path)
+{
+  std::ifstream file{path, std::ios_base::binary};
+
+  if (!file)
+    return std::nullopt;
+
+  std::stringstream ss;
+  ss << file.rdbuf();
+
+  return Hasher{}.add(ss.str()).finalize();
+}
+
+// Writes to a temporary file first and renames it, so that other processes
+// never see a partially written file
+static void writeFileAtomically(const fs::path&        path,
+                                const std::string_view content)
+{
+  const auto tmp_path
+    = path.string() + '.' + boost::filesystem::unique_path().string() + ".tmp";
+
+  {
+    std::ofstream file{tmp_path, std::ios_base::binary};
+    file.write(content.data(), content.size());
+
+    if (!file)
+      throw fs::filesystem_error{"could not write", tmp_path, {}};
+  }
+
+  fs::rename(tmp_path, path);
+}
+
+// Copies the file in the same way as writeFileAtomically
+static void copyFileAtomically(const fs::path& from, const fs::path& to)
+{
+  const auto tmp_path
+    = to.string() + '.' + boost::filesystem::unique_path().string() + ".tmp";
+
+  fs::copy_file(from, tmp_path, fs::copy_options::overwrite_existing);
+  fs::rename(tmp_path, to);
+}
+
+// Returns the change of the size of the cache when the file at 'path' is
+// replaced with one of 'new_size'
+[[nodiscard]] static std::int64_t sizeDifference(const fs::path&      path,
+                                                 const std::uintmax_t new_size)
+{
+  std::error_code ec;
+  const auto      old_size = fs::file_size(path, ec);
+
+  return static_cast<std::int64_t>(new_size)
+         - static_cast<std::int64_t>(ec ? 0 : old_size);
+}
+
+static void writeStatistics(const fs::path& dir, const Statistics& statistics)
+{
+  writeFileAtomically(dir / "stats",
+                      fmt::format("hits {}\n"
+                                  "misses {}\n"
+                                  "stored {}\n"
+                                  "evicted {}\n"
+                                  "size {}\n",
+                                  statistics.hits,
+                                  statistics.misses,
+                                  statistics.stored,
+                                  statistics.evicted,
+                                  statistics.size));
+}
+
+Cache::Cache(const fs::path& dir, const std::uintmax_t max_size)
+  : dir{dir}
+  , max_size{max_size}
+  , hits{0}
+  , misses{0}
+  , stored{0}
+  , stored_size{0}
+{
+  std::error_code ec;
+
+  fs::create_directories(dir / "manifests", ec);
+  fs::create_directories(dir / "objects", ec);
+
+  if (ec) {
+    throw CacheError{formatError(
+      fmt::format("could not create cache directory {}: {}",
+                  dir.string(),
+                  ec.message()))};
+  }
+
+  // file_lock requires an existing file
+  std::ofstream{dir / "lock", std::ios_base::app};
+}
+
+[[nodiscard]] std::optional<std::vector<fs::path>>
+Cache::lookup(const std::string& source_key)
+{
+  for (const auto& entry : readManifest(source_key)) {
+    const auto dependencies_unchanged = std::all_of(
+      entry.dependencies.begin(),
+      entry.dependencies.end(),
+      [](const auto& dependency) {
+        return hashFile(dependency.second) == dependency.first;
+      });
+
+    if (!dependencies_unchanged)
+      continue;
+
+    std::vector<fs::path> outputs;
+
+    for (std::size_t idx = 0; idx < entry.num_outputs; ++idx)
+      outputs.push_back(outputPath(entry.result_key, idx));
+
+    // Some outputs may have been evicted
+    if (!std::all_of(outputs.begin(), outputs.end(), [](const auto& path) {
+          return fs::exists(path);
+        }))
+      continue;
+
+    // Mark as recently used
+    for (const auto& r : outputs) {
+      std::error_code ec;
+      fs::last_write_time(r, fs::file_time_type::clock::now(), ec);
+    }
+
+    ++hits;
+    return outputs;
+  }
+
+  ++misses;
+  return std::nullopt;
+}
+
+void Cache::store(const std::string&           source_key,
+                  const std::vector<fs::path>& dependencies,
+                  const std::vector<fs::path>& outputs)
+try {
+  ManifestEntry new_entry{"", outputs.size(), {}};
+
+  Hasher result_hasher;
+  result_hasher.add(source_key);
+
+  for (const auto& r : dependencies) {
+    const auto hash = hashFile(r);
+
+    // Outputs whose dependencies are unknown cannot be reused safely
+    if (!hash)
+      return;
+
+    // Lookups may run in another working directory, and the file may be
+    // imported with another spelling
+    const auto path = fs::canonical(r);
+
+    result_hasher.add(path.string()).add(*hash);
+    new_entry.dependencies.emplace_back(*hash, path);
+  }
+
+  new_entry.result_key = result_hasher.finalize();
+
+  for (std::size_t idx = 0; idx < outputs.size(); ++idx) {
+    const auto path = outputPath(new_entry.result_key, idx);
+
+    fs::create_directories(path.parent_path());
+
+    // The output may exist already, e.g. if its manifest entry was dropped or
+    // another process stored it at the same time
+    const auto difference = sizeDifference(path, fs::file_size(outputs[idx]));
+
+    copyFileAtomically(outputs[idx], path);
+
+    stored_size += difference;
+  }
+
+  addManifestEntry(source_key, std::move(new_entry));
+
+  ++stored;
+}
+catch (const fs::filesystem_error&) {
+  // The cache is only an optimization, so failing to store is not an error
+}
+catch (const boost::interprocess::interprocess_exception&) {
+}
+
+void Cache::store(const std::string& source_key, const llvm::StringRef output)
+try {
+  ManifestEntry new_entry{Hasher{}.add(source_key).finalize(), 1, {}};
+
+  const auto path = outputPath(new_entry.result_key, 0);
+
+  fs::create_directories(path.parent_path());
+
+  const auto difference = sizeDifference(path, output.size());
+
+  writeFileAtomically(path, {output.data(), output.size()});
+
+  stored_size += difference;
+
+  addManifestEntry(source_key, std::move(new_entry));
+
+  ++stored;
+}
+catch (const fs::filesystem_error&) {
+}
+catch (const boost::interprocess::interprocess_exception&) {
+}
+
+void Cache::addManifestEntry(const std::string& source_key,
+                             ManifestEntry&&    new_entry)
+{
+  // Other processes may update the same manifest
+  boost::interprocess::file_lock lock{(dir / "lock").c_str()};
+  boost::interprocess::scoped_lock<boost::interprocess::file_lock> guard{lock};
+
+  auto entries = readManifest(source_key);
+
+  std::erase_if(entries, [&](const ManifestEntry& entry) {
+    return entry.result_key == new_entry.result_key;
+  });
+
+  // The newest entry is checked first
+  entries.insert(entries.begin(), std::move(new_entry));
+
+  if (entries.size() > max_manifest_entries)
+    entries.resize(max_manifest_entries);
+
+  writeManifest(source_key, entries);
+}
+
+void Cache::flush()
+try {
+  boost::interprocess::file_lock lock{(dir / "lock").c_str()};
+  boost::interprocess::scoped_lock<boost::interprocess::file_lock> guard{lock};
+
+  auto statistics = readStatistics(dir);
+
+  statistics.hits += hits.exchange(0);
+  statistics.misses += misses.exchange(0);
+  statistics.stored += stored.exchange(0);
+  // The size in the statistics may have been reset by clearing the cache
+  statistics.size = static_cast<std::uint64_t>(
+    std::max<std::int64_t>(static_cast<std::int64_t>(statistics.size)
+                             + stored_size.exchange(0),
+                           0));
+
+  if (statistics.size > max_size) {
+    const auto [evicted, size] = evict();
+
+    statistics.evicted += evicted;
+    statistics.size = size;
+  }
+
+  writeStatistics(dir, statistics);
+}
+catch (const fs::filesystem_error&) {
+}
+catch (const boost::interprocess::interprocess_exception&) {
+}
+
+[[nodiscard]] Statistics Cache::readStatistics(const fs::path& dir)
+{
+  Statistics statistics{};
+
+  std::ifstream file{dir / "stats"};
+
+  std::string   name;
+  std::uint64_t value;
+
+  while (file >> name >> value) {
+    if (name == "hits")
+      statistics.hits = value;
+    else if (name == "misses")
+      statistics.misses = value;
+    else if (name == "stored")
+      statistics.stored = value;
+    else if (name == "evicted")
+      statistics.evicted = value;
+    else if (name == "size")
+      statistics.size = value;
+  }
+
+  return statistics;
+}
+
+void Cache::clear(const fs::path& dir)
+try {
+  // Nothing has been cached yet
+  if (!fs::exists(dir / "lock"))
+    return;
+
+  boost::interprocess::file_lock lock{(dir / "lock").c_str()};
+  boost::interprocess::scoped_lock<boost::interprocess::file_lock> guard{lock};
+
+  fs::remove_all(dir / "manifests");
+  fs::remove_all(dir / "objects");
+
+  auto statistics = readStatistics(dir);
+  statistics.size = 0;
+
+  writeStatistics(dir, statistics);
+}
+catch (const fs::filesystem_error& err) {
+  throw CacheError{
+    formatError(fmt::format("could not clear cache directory {}: {}",
+                            dir.string(),
+                            err.code().message()))};
+}
+catch (const boost::interprocess::interprocess_exception& err) {
+  throw CacheError{
+    formatError(fmt::format("could not clear cache directory {}: {}",
+                            dir.string(),
+                            err.what()))};
+}
+
+// Manifest format:
+//   <result key> <number of outputs> <number of dependencies>
+//   <hash> <path>   (for each dependency)
+//   ...
+[[nodiscard]] std::vector<Cache::ManifestEntry>
+Cache::readManifest(const std::string& source_key) const
+{
+  std::vector<ManifestEntry> entries;
+
+  std::ifstream file{manifestPath(source_key)};
+
+  ManifestEntry entry;
+  std::size_t   num_dependencies;
+
+  while (file >> entry.result_key >> entry.num_outputs >> num_dependencies) {
+    entry.dependencies.clear();
+
+    for (std::size_t idx = 0; idx < num_dependencies; ++idx) {
+      std::string hash, path;
+
+      file >> hash;
+      file.ignore(1); // Separator
+      std::getline(file, path);
+
+      entry.dependencies.emplace_back(std::move(hash), std::move(path));
+    }
+
+    if (!file)
+      break;
+
+    entries.push_back(entry);
+  }
+
+  return entries;
+}
+
+void Cache::writeManifest(const std::string&                source_key,
+                          const std::vector<ManifestEntry>& entries) const
+{
+  std::string content;
+
+  for (const auto& entry : entries) {
+    content += fmt::format("{} {} {}\n",
+                           entry.result_key,
+                           entry.num_outputs,
+                           entry.dependencies.size());
+
+    for (const auto& [hash, path] : entry.dependencies)
+      content += fmt::format("{} {}\n", hash, path.string());
+  }
+
+  const auto path = manifestPath(source_key);
+
+  fs::create_directories(path.parent_path());
+  writeFileAtomically(path, content);
+}
+
+// Keys are spread over subdirectories by their first two characters so that
+// no directory gets too large
+[[nodiscard]] fs::path Cache::manifestPath(const std::string& source_key) const
+{
+  return dir / "manifests" / source_key.substr(0, 2) / source_key;
+}
+
+[[nodiscard]] fs::path Cache::outputPath(const std::string& result_key,
+                                         const std::size_t  idx) const
+{
+  return dir / "objects" / result_key.substr(0, 2)
+         / fmt::format("{}.{}", result_key, idx);
+}
+
+[[nodiscard]] std::pair<std::uint64_t, std::uint64_t> Cache::evict() const
+{
+  struct Output {
+    fs::file_time_type last_use;
+    std::uintmax_t     size;
+    fs::path           path;
+  };
+
+  std::vector<Output> outputs;
+  std::uint64_t       total_size = 0;
+
+  for (const auto& r : fs::recursive_directory_iterator(dir / "objects")) {
+    if (!r.is_regular_file())
+      continue;
+
+    outputs.push_back({r.last_write_time(), r.file_size(), r.path()});
+    total_size += outputs.back().size;
+  }
+
+  std::sort(outputs.begin(),
+            outputs.end(),
+            [](const Output& a, const Output& b) {
+              return a.last_use < b.last_use;
+            });
+
+  const auto target_size
+    = static_cast<std::uint64_t>(max_size * eviction_target_ratio);
+
+  std::uint64_t evicted = 0;
+
+  for (const auto& r : outputs) {
+    if (total_size <= target_size)
+      break;
+
+    std::error_code ec;
+    if (fs::remove(r.path, ec)) {
+      total_size -= r.size;
+      ++evicted;
+    }
+  }
+
+  return {evicted, total_size};
+}
+
+} // namespace twinkle::cache
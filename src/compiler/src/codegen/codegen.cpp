@@ -10,195 +10,291 @@
 #include <twinkle/codegen/type.hpp>
 #include <twinkle/codegen/exception.hpp>
 #include <twinkle/unicode/unicode.hpp>
+#include <twinkle/support/parallel.hpp>
+#include <twinkle/support/file.hpp>
 #include <cassert>
-#include <boost/filesystem.hpp>
+#include <boost/container_hash/hash.hpp>
+#include <llvm/CodeGen/ParallelCG.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Transforms/IPO/Internalize.h>
 
 #if defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
 #include <unistd.h> // isatty
 #endif
 
-namespace
+namespace twinkle::codegen
 {
 
-[[nodiscard]] std::string createTemporaryFilepath()
+void Scope::insert(const std::string&               name,
+                   const std::shared_ptr<Variable>& variable)
 {
-  return (boost::filesystem::temp_directory_path()
-          / boost::filesystem::unique_path())
-    .native();
+  table.insert_or_assign(name, variable);
+  variables.push_back(variable);
 }
 
-} // namespace
+[[nodiscard]] std::shared_ptr<Variable>
+Scope::find(const std::string& name) const
+{
+  for (auto scope = this; scope; scope = scope->parent) {
+    if (const auto iter = scope->table.find(name); iter != scope->table.end())
+      return iter->second;
+  }
+
+  return nullptr;
+}
 
-namespace twinkle::codegen
+[[nodiscard]] std::size_t CreatedClassTemplateTableKeyHash::operator()(
+  const CreatedClassTemplateTableKey& key) const noexcept
 {
+  auto seed = boost::hash_value(key.class_template);
+  boost::hash_range(seed, key.template_args.begin(), key.template_args.end());
+  return seed;
+}
 
-[[nodiscard]] std::optional<std::shared_ptr<Type>>
-CreatedClassTemplateTable::operator[](
-  const CreatedClassTemplateTableKey& key) const
+[[nodiscard]] CreatedClassTemplateTableKey
+CreatedClassTemplateTable::createKey(
+  const ClassTemplateTableValue& class_template,
+  const ast::TemplateArguments&  template_args) const
 {
-  for (const auto& r : table) {
-    auto& [name, args, namespace_] = r.first;
+  CreatedClassTemplateTableKey key{&class_template, {}};
 
-    const auto template_arg_types_of_keyarg = std::get<1>(key);
+  const auto pos = ctx.positionOf(template_args);
 
-    if (std::get<0>(key) == name) {
-      for (std::size_t idx = 0;
-           const auto& type : template_arg_types_of_keyarg.types) {
-        const auto pos = ctx.positionOf(template_arg_types_of_keyarg);
+  // Identities make aliased types equal to ordinary types
+  for (const auto& type : template_args.types)
+    key.template_args.push_back(createType(ctx, type, pos)->getIdentity(ctx));
 
-        const auto t1 = createType(ctx, args.types.at(idx), pos);
-        const auto t2 = createType(ctx, type, pos);
+  return key;
+}
 
-        assert(t1->getLLVMType(ctx) && t2->getLLVMType(ctx));
+[[nodiscard]] std::optional<std::shared_ptr<Type>>
+CreatedClassTemplateTable::operator[](const CreatedClassTemplateTableKey& key)
+{
+  ++statistics.lookups;
 
-        // Mangled name comparisons allow pure type comparisons (aliased types
-        // can also be compared to ordinary types)
-        if (t1->getMangledName(ctx) == t2->getMangledName(ctx))
-          return r.second;
+  const auto iter = table.find(key);
 
-        ++idx;
-      }
-    }
-  }
+  if (iter == table.end())
+    return std::nullopt;
 
-  return std::nullopt;
+  ++statistics.hits;
+  return iter->second;
 }
 
 void CreatedClassTemplateTable::insert(CreatedClassTemplateTableKey&& key,
                                        const std::shared_ptr<Type>&   value)
 {
-  const auto r = table.insert(
-    std::move(CreatedClassTemplateTableElem{std::move(key), value}));
+  const auto r = table.emplace(std::move(key), value);
 
   assert(r.second);
+
+  ++statistics.instantiations;
+}
+
+void OverloadTable::insert(const NamespaceStack&  space,
+                           const std::string_view name,
+                           Overload&&             overload)
+{
+  table[createKey(space, space.size(), name)].push_back(std::move(overload));
 }
 
-template <typename R = std::vector<std::string>>
-[[nodiscard]] static R splitByLine(const std::string& str)
+[[nodiscard]] llvm::Function*
+OverloadTable::find(const NamespaceStack&           space,
+                    const std::string_view          name,
+                    const std::vector<const Type*>& arg_types,
+                    const Accessibility             accessibility) const
 {
-  std::istringstream ss{str};
-  R                  lines;
+  // Innermost first
+  std::vector<const std::vector<Overload>*> candidates;
 
-  for (;;) {
-    std::string line;
-    if (std::getline(ss, line))
-      lines.emplace_back(line);
-    else
-      return lines;
+  for (auto depth = space.size() + 1; depth--;) {
+    if (const auto iter = table.find(createKey(space, depth, name));
+        iter != table.end())
+      candidates.push_back(&iter->second);
   }
 
-  unreachable();
+  const auto accessible = [&](const Overload& overload) {
+    return (overload.accessibility == Accessibility::private_)
+           == (accessibility == Accessibility::private_);
+  };
+
+  for (const auto overloads : candidates) {
+    for (const auto& r : *overloads) {
+      if (!r.is_vararg && accessible(r) && r.param_types == arg_types)
+        return r.function;
+    }
+  }
+
+  // Arguments that are passed to the variadic part are not checked
+  for (const auto overloads : candidates) {
+    for (const auto& r : *overloads) {
+      if (r.is_vararg && accessible(r)
+          && r.param_types.size() <= arg_types.size()
+          && std::equal(r.param_types.begin(),
+                        r.param_types.end(),
+                        arg_types.begin()))
+        return r.function;
+    }
+  }
+
+  return nullptr;
+}
+
+[[nodiscard]] std::string
+OverloadTable::createKey(const NamespaceStack&  space,
+                         const std::size_t      depth,
+                         const std::string_view name)
+{
+  assert(depth <= space.size());
+
+  std::string key;
+
+  for (auto iter = space.begin(); iter != space.begin() + depth; ++iter)
+    key.append(iter->name).append("::");
+
+  return key.append(name);
 }
 
 //===----------------------------------------------------------------------===//
 // Code generator
 //===----------------------------------------------------------------------===//
 
-CGContext::CGContext(llvm::LLVMContext&      context,
-                     PositionCache&&         current_file_poscache,
-                     std::filesystem::path&& current_file,
-                     const std::string&      source_code,
-                     const unsigned int      opt_level,
-                     const bool              jit) noexcept
+CGContext::CGContext(
+  llvm::LLVMContext&                         context,
+  const PositionTablePtr&                    positions,
+  std::filesystem::path&&                    current_file,
+  const SourceBufferPtr&                     source,
+  const parse::ParserKind                    parser_kind,
+  const std::shared_ptr<parse::ImportCache>& import_cache) noexcept
   : context{context}
   , module{std::make_unique<llvm::Module>(current_file.filename().string(),
                                           context)}
   , builder{context}
+  , types{*this}
   , current_file{std::move(current_file)}
+  , parser_kind{parser_kind}
+  , import_cache{import_cache}
   , created_class_template_table{*this}
   , mangler{*this}
-  , fpm{module.get()}
-  , jit{jit}
 {
-  if (!jit) {
-    // Setup pass manager
-    llvm::PassManagerBuilder builder;
-
-    builder.OptLevel = opt_level;
-
-    builder.populateFunctionPassManager(fpm);
-  }
-
-  fpm.doInitialization();
-
   const auto current_filename = this->current_file.string();
 
-  source_code_table.insert(current_filename, splitByLine(source_code));
+  source_table.insert(current_filename, source);
 
-  position_cache_table.insert(current_filename,
-                              std::move(current_file_poscache));
+  position_tables.insert(positions->getFileID(), positions);
 }
 
-[[nodiscard]] std::string
+[[nodiscard]] FormattedDiagnostic
 CGContext::formatError(const PositionRange&   pos,
                        const std::string_view message) const
 {
-  const auto rows = calcRows(pos);
+  const auto [file, source] = findSource(pos);
 
-  const auto source_code = source_code_table[current_file];
-  assert(source_code);
+  const auto offset = pos.begin().base() - source->getText().cbegin();
 
-  return fmt::format("In file {}, line {}:\n", current_file.string(), rows)
-         + fmt::format(fg(fmt::terminal_color::bright_red), "error: ")
-         + fmt::format(fg(fmt::terminal_color::bright_white), "{}\n", message)
-         + boost::algorithm::trim_copy(source_code->get().at(rows - 1));
+  const auto line = source->getLine(offset);
+
+  return {
+    fmt::format("In file {}, line {}:\n", file, line)
+      + fmt::format(fg(fmt::terminal_color::bright_red), "error: ")
+      + fmt::format(fg(fmt::terminal_color::bright_white), "{}\n", message)
+      + boost::algorithm::trim_copy(std::string{source->getLineText(line)}),
+    {file, line, source->getColumn(offset), std::string{message}}
+  };
 }
 
-[[nodiscard]] std::size_t CGContext::calcRows(const PositionRange& pos) const
+[[nodiscard]] std::pair<std::string, SourceBufferPtr>
+CGContext::findSource(const PositionRange& pos) const
 {
-  std::size_t rows{};
+  const auto where = std::to_address(pos.begin().base());
 
-  for (auto iter = pos.begin();; --iter) {
-    if (*iter == U'\n')
-      ++rows;
+  if (const auto source = source_table[current_file.string()];
+      source && source->get()->contains(where))
+    return {current_file.string(), *source};
 
-    if (iter == getCurrentPosCache().first())
-      return ++rows;
+  // Nodes of the imported files are also used in the current file
+  for (const auto& [file, source] : source_table) {
+    if (source->contains(where))
+      return {file, source};
   }
 
   unreachable();
 }
 
 CodeGenerator::CodeGenerator(
-  const std::string_view               argv_front,
-  std::vector<parse::Parser::Result>&& parse_results,
-  const unsigned int                   opt_level,
-  const llvm::Reloc::Model             relocation_model,
-  const std::optional<std::string>&    target_triple_arg,
-  const bool                           jit)
+  const std::string_view                     argv_front,
+  std::vector<parse::Parser::Result>&&       parse_results,
+  const unsigned int                         opt_level,
+  const bool                                 lto,
+  const llvm::Optional<llvm::PGOOptions>&    pgo_options,
+  const llvm::Reloc::Model                   relocation_model,
+  const std::optional<std::string>&          target_triple_arg,
+  const TargetCPU&                           target_cpu,
+  const bool                                 jit,
+  const unsigned int                         jobs,
+  const parse::ParserKind                    parser_kind,
+  const std::shared_ptr<parse::ImportCache>& import_cache)
   : argv_front{argv_front}
-  , context{std::make_unique<llvm::LLVMContext>()}
+  , target_cpu{target_cpu}
   , relocation_model{relocation_model}
+  , pgo_options{pgo_options}
+  , jobs{jobs}
+  , results(parse_results.size())
+  , class_template_statistics(parse_results.size())
   , parse_results{parse_results}
 {
-  results.reserve(parse_results.size());
+  initializeTargets();
+
+  verifyOptLevel(opt_level);
 
-  llvm::InitializeAllTargetInfos();
-  llvm::InitializeAllTargets();
-  llvm::InitializeAllTargetMCs();
-  llvm::InitializeAllAsmParsers();
-  llvm::InitializeAllAsmPrinters();
+  codegen_opt_level = getCodeGenOptLevel(opt_level);
 
   initTargetTripleAndMachine(target_triple_arg);
 
-  for (auto it = parse_results.begin(), last = parse_results.end(); it != last;
-       ++it) {
-    verifyOptLevel(opt_level);
+  const auto data_layout = target_machine->createDataLayout();
+
+  // Translation units share nothing but the target, so each one is generated
+  // in its own context
+  parallelFor(parse_results.size(), jobs, [&](const std::size_t idx) {
+    auto& parse_result = parse_results[idx];
+
+    const llvm::TimeTraceScope time_trace_scope{"Translation unit",
+                                                parse_result.file.string()};
+
+    auto context = std::make_unique<llvm::LLVMContext>();
 
     CGContext ctx{*context,
-                  std::move(it->positions),
-                  std::move(it->file),
-                  it->input,
-                  opt_level,
-                  jit};
+                  parse_result.positions,
+                  std::move(parse_result.file),
+                  parse_result.source,
+                  parser_kind,
+                  import_cache};
 
     ctx.module->setTargetTriple(target_triple);
-    ctx.module->setDataLayout(target_machine->createDataLayout());
+    ctx.module->setDataLayout(data_layout);
 
-    codegen(it->ast, ctx);
+    codegen(parse_result.ast, ctx);
 
-    results.emplace_back(std::move(ctx.module), std::move(ctx.current_file));
-  }
+    class_template_statistics[idx]
+      = ctx.created_class_template_table.getStatistics();
+
+    // The JIT optimizes modules when they are materialized
+    if (!jit) {
+      optimize(*ctx.module,
+               opt_level,
+               lto ? PipelineKind::lto_pre_link : PipelineKind::per_module);
+    }
+
+    results[idx] = {std::move(context),
+                    std::move(ctx.module),
+                    std::move(ctx.current_file),
+                    std::move(ctx.imported_files)};
+  });
+
+  if (lto && !jit)
+    linkForLTO(opt_level);
 }
 
 void CodeGenerator::verifyOptLevel(const unsigned int opt_level) const
@@ -214,16 +310,18 @@ void CodeGenerator::verifyOptLevel(const unsigned int opt_level) const
   }
 }
 
-[[nodiscard]] FilePaths CodeGenerator::emitLlvmIRFiles()
+[[nodiscard]] ModuleFilePaths CodeGenerator::emitLlvmIRFiles()
 {
-  FilePaths created_files;
+  ModuleFilePaths created_files;
 
   for (auto it = results.begin(), last = results.end(); it != last; ++it) {
-    const auto& file = std::get<std::filesystem::path>(*it);
+    const auto& file = it->file;
 
     const auto output_file = file.stem().string() + ".ll";
 
-    created_files.push_back(output_file);
+    created_files.push_back({output_file});
+
+    const llvm::TimeTraceScope time_trace_scope{"Emit", file.string()};
 
     std::error_code      ostream_ec;
     llvm::raw_fd_ostream os{output_file,
@@ -236,69 +334,158 @@ void CodeGenerator::verifyOptLevel(const unsigned int opt_level) const
         fmt::format("{}: {}", file.string(), ostream_ec.message()))};
     }
 
-    std::get<std::unique_ptr<llvm::Module>>(*it)->print(os, nullptr);
+    it->module->print(os, nullptr);
   }
 
   return created_files;
 }
 
-[[nodiscard]] FilePaths CodeGenerator::emitAssemblyFiles()
+[[nodiscard]] ModuleFilePaths CodeGenerator::emitAssemblyFiles()
 {
   return emitFiles(llvm::CGFT_AssemblyFile);
 }
 
-[[nodiscard]] FilePaths CodeGenerator::emitObjectFiles()
+[[nodiscard]] ModuleFilePaths CodeGenerator::emitObjectFiles()
 {
   return emitFiles(llvm::CGFT_ObjectFile);
 }
 
-[[nodiscard]] FilePaths CodeGenerator::emitTemporaryObjectFiles()
+[[nodiscard]] ModuleFilePaths CodeGenerator::emitTemporaryObjectFiles()
 {
   return emitFiles(llvm::CGFT_ObjectFile, true);
 }
 
-[[nodiscard]] int CodeGenerator::doJIT()
+[[nodiscard]] std::string CodeGenerator::exposeFunction(const std::string& name)
+{
+  const auto mangled_name
+    = fmt::format("{}{}{}E", mangle::prefix, name.length(), name);
+
+  for (const auto& r : results) {
+    auto func = r.module->getFunction(name);
+
+    if (!func || func->isDeclaration())
+      func = r.module->getFunction(mangled_name);
+
+    if (!func || func->isDeclaration())
+      continue;
+
+    if (func->arg_size()) {
+      throw CodegenError{formatError(
+        argv_front,
+        fmt::format("function '{}' must take no arguments", name))};
+    }
+
+    func->setLinkage(llvm::GlobalValue::ExternalLinkage);
+
+    return func->getName().str();
+  }
+
+  throw CodegenError{formatError(
+    argv_front,
+    fmt::format("function '{}' that takes no arguments could not be found",
+                name))};
+}
+
+[[nodiscard]] std::vector<std::string>
+CodeGenerator::getExternalFunctions() const
+{
+  std::vector<std::string> symbols;
+
+  for (const auto& r : results) {
+    for (const auto& func : *r.module) {
+      if (!func.isDeclaration() && !func.hasLocalLinkage())
+        symbols.push_back(func.getName().str());
+    }
+  }
+
+  return symbols;
+}
+
+void CodeGenerator::addToJIT(
+  jit::JitCompiler&                   jit,
+  const llvm::orc::ResourceTrackerSP& resource_tracker)
 {
   assert(!jit_compiled);
 
   jit_compiled = true;
 
-  auto jit_expected = jit::JitCompiler::create();
+  // Modules live in different contexts and cannot be linked with each other,
+  // so each one is added to the JIT on its own and resolved there
+  for (auto it = results.begin(), last = results.end(); it != last; ++it) {
+    auto [context, module, file, imported_files] = std::move(*it);
+
+    if (auto err = jit.addModule({std::move(module), std::move(context)},
+                                 resource_tracker)) {
+      throw CodegenError{
+        formatError(file.string(), llvm::toString(std::move(err)))};
+    }
+  }
+
+  jit.compileAddedModules();
+}
+
+[[nodiscard]] int
+CodeGenerator::doJIT(cache::Cache*                               cache,
+                     const jit::TieringOptions&                  tiering,
+                     const unsigned int                          num_threads,
+                     const jit::DebugOptions&                    debug,
+                     const std::optional<jit::BenchmarkOptions>& bench)
+{
+  const auto entry = bench ? exposeFunction(bench->symbol) : "main";
+
+  auto jit_expected = jit::JitCompiler::create(target_cpu,
+                                               codegen_opt_level,
+                                               cache,
+                                               tiering,
+                                               resolveJobs(num_threads),
+                                               debug);
   if (auto err = jit_expected.takeError())
     throw CodegenError{formatError(argv_front, llvm::toString(std::move(err)))};
 
   auto jit = std::move(*jit_expected);
 
-  auto [front_module, file] = std::move(results.front());
+  addToJIT(*jit, nullptr);
 
-  // Link all modules
-  for (auto it = results.begin() + 1, last = results.end(); it != last; ++it) {
-    auto [module, file] = std::move(*it);
+  auto symbol_expected = [&] {
+    // Materializes the entry point and what it refers to eagerly
+    const llvm::TimeTraceScope time_trace_scope{"JIT lookup", entry};
+    return jit->lookup(entry);
+  }();
 
-    if (llvm::Linker::linkModules(*front_module, std::move(module))) {
-      throw CodegenError{
-        formatError(argv_front,
-                    fmt::format("{}: Could not link", file.string()))};
-    }
-  }
-
-  if (auto err
-      = jit->addModule({std::move(front_module), std::move(context)})) {
-    throw CodegenError{
-      formatError(file.string(), llvm::toString(std::move(err)))};
+  if (auto err = symbol_expected.takeError()) {
+    throw CodegenError{formatError(
+      argv_front,
+      fmt::format("symbol {} could not be found", entry))};
   }
 
-  auto symbol_expected = jit->lookup("main");
-  if (auto err = symbol_expected.takeError()) {
-    throw CodegenError{
-      formatError(argv_front, "symbol main could not be found")};
+  auto symbol = *symbol_expected;
+
+  if (bench) {
+    const llvm::TimeTraceScope time_trace_scope{"JIT benchmark", entry};
+
+    jit::runBenchmark(
+      reinterpret_cast<jit::BenchmarkedFunction>(symbol.getAddress()),
+      *bench,
+      [&] {
+        // Measure the optimized code of the function, even if the warmup
+        // did not reach the tier-up threshold, and of the ones that became
+        // hot
+        jit->requestTierUp(entry);
+        jit->waitForTierUps();
+      },
+      std::cout,
+      argv_front);
+
+    return EXIT_SUCCESS;
   }
 
-  auto       symbol = *symbol_expected;
   auto const main_addr
     = reinterpret_cast<int (*)(/* TODO: command line arguments */)>(
       symbol.getAddress());
 
+  // Functions called lazily are materialized in it
+  const llvm::TimeTraceScope time_trace_scope{"JIT run main"};
+
   // Run main
   return main_addr();
 }
@@ -309,7 +496,9 @@ void CodeGenerator::codegen(const ast::TranslationUnit& ast, CGContext& ctx)
     createTopLevel(ctx, node);
 
   {
-    // Verify module
+    const llvm::TimeTraceScope time_trace_scope{"Verify module",
+                                                ctx.current_file.string()};
+
     std::string              str;
     llvm::raw_string_ostream stream{str};
     if (llvm::verifyModule(*ctx.module, &stream))
@@ -317,7 +506,145 @@ void CodeGenerator::codegen(const ast::TranslationUnit& ast, CGContext& ctx)
   }
 }
 
-[[nodiscard]] FilePaths
+void CodeGenerator::optimize(llvm::Module&      module,
+                             const unsigned int opt_level,
+                             const PipelineKind kind) const
+{
+  // Each pass is traced by the pass manager
+  const llvm::TimeTraceScope time_trace_scope{"Optimize", module.getName()};
+
+  static const std::array<llvm::OptimizationLevel, 4> opt_level_map = {
+    llvm::OptimizationLevel::O0,
+    llvm::OptimizationLevel::O1,
+    llvm::OptimizationLevel::O2,
+    llvm::OptimizationLevel::O3,
+  };
+
+  // The analysis managers must be declared in this order so that they are
+  // destroyed in the reverse order
+  llvm::LoopAnalysisManager     lam;
+  llvm::FunctionAnalysisManager fam;
+  llvm::CGSCCAnalysisManager    cgam;
+  llvm::ModuleAnalysisManager   mam;
+
+  // Gives the passes the cost model of the target
+  const auto machine = acquireTargetMachine();
+
+  llvm::PassBuilder pass_builder{machine.get(),
+                                 llvm::PipelineTuningOptions{},
+                                 pgo_options};
+
+  pass_builder.registerModuleAnalyses(mam);
+  pass_builder.registerCGSCCAnalyses(cgam);
+  pass_builder.registerFunctionAnalyses(fam);
+  pass_builder.registerLoopAnalyses(lam);
+  pass_builder.crossRegisterProxies(lam, fam, cgam, mam);
+
+  const auto level = opt_level_map.at(opt_level);
+
+  auto mpm = [&] {
+    if (level == llvm::OptimizationLevel::O0) {
+      return pass_builder.buildO0DefaultPipeline(
+        level,
+        kind != PipelineKind::per_module);
+    }
+
+    switch (kind) {
+    case PipelineKind::per_module:
+      return pass_builder.buildPerModuleDefaultPipeline(level);
+    case PipelineKind::lto_pre_link:
+      return pass_builder.buildLTOPreLinkDefaultPipeline(level);
+    case PipelineKind::lto:
+      return pass_builder.buildLTODefaultPipeline(level, nullptr);
+    }
+
+    unreachable();
+  }();
+
+  mpm.run(module, mam);
+}
+
+void CodeGenerator::linkForLTO(const unsigned int opt_level)
+{
+  assert(!results.empty());
+
+  const llvm::TimeTraceScope time_trace_scope{"Link modules for LTO"};
+
+  // Modules in different contexts cannot be linked with each other, so they
+  // are moved into one context through bitcode
+  std::vector<llvm::SmallVector<char, 0>> bitcodes(results.size());
+
+  parallelFor(results.size(), jobs, [&](const std::size_t idx) {
+    llvm::raw_svector_ostream os{bitcodes[idx]};
+    llvm::WriteBitcodeToFile(*results[idx].module, os);
+
+    // No longer needed
+    results[idx].module.reset();
+    results[idx].context.reset();
+  });
+
+  auto context = std::make_unique<llvm::LLVMContext>();
+
+  const auto& front_file = results.front().file;
+
+  auto linked_module
+    = std::make_unique<llvm::Module>(front_file.filename().string(), *context);
+
+  linked_module->setTargetTriple(target_triple);
+  linked_module->setDataLayout(target_machine->createDataLayout());
+
+  llvm::Linker linker{*linked_module};
+
+  for (std::size_t idx = 0; idx < results.size(); ++idx) {
+    const auto file = results[idx].file.string();
+
+    auto module = llvm::parseBitcodeFile(
+      llvm::MemoryBufferRef{
+        llvm::StringRef{bitcodes[idx].data(), bitcodes[idx].size()},
+        file},
+      *context);
+
+    if (auto err = module.takeError()) {
+      throw CodegenError{formatError(
+        argv_front,
+        fmt::format("{}: {}", file, llvm::toString(std::move(err))))};
+    }
+
+    if (linker.linkInModule(std::move(*module))) {
+      throw CodegenError{
+        formatError(argv_front, fmt::format("{}: Could not link", file))};
+    }
+
+    bitcodes[idx].clear();
+  }
+
+  // Only main and unmangled symbols ([[nomangle]]) can be referred to from
+  // outside; the others can be optimized away freely
+  llvm::internalizeModule(*linked_module, [](const llvm::GlobalValue& gv) {
+    const auto name = gv.getName();
+    return name == "main" || !name.startswith(mangle::prefix);
+  });
+
+  optimize(*linked_module, opt_level, PipelineKind::lto);
+
+  auto file = std::move(results.front().file);
+
+  FilePaths imported_files;
+
+  for (auto&& r : results) {
+    imported_files.insert(imported_files.end(),
+                          r.imported_files.begin(),
+                          r.imported_files.end());
+  }
+
+  results.clear();
+  results.push_back({std::move(context),
+                     std::move(linked_module),
+                     std::move(file),
+                     std::move(imported_files)});
+}
+
+[[nodiscard]] ModuleFilePaths
 CodeGenerator::emitFiles(const llvm::CodeGenFileType cgft,
                          const bool                  create_as_tmpfile)
 {
@@ -327,44 +654,171 @@ CodeGenerator::emitFiles(const llvm::CodeGenFileType cgft,
       {  llvm::CodeGenFileType::CGFT_ObjectFile, "o"}
   };
 
-  FilePaths created_files;
+  // Only temporary object files can be split, because they are linked
+  // afterwards and nobody depends on their number
+  const auto splittable
+    = create_as_tmpfile && cgft == llvm::CodeGenFileType::CGFT_ObjectFile;
 
-  for (auto it = results.begin(), last = results.end(); it != last; ++it) {
-    const auto& file = std::get<std::filesystem::path>(*it);
+  ModuleFilePaths created_files(results.size());
+
+  // Modules that are emitted as they are
+  std::vector<std::size_t> whole_modules;
+
+  for (std::size_t idx = 0; idx < results.size(); ++idx) {
+    if (splittable && countPartitions(*results[idx].module) > 1)
+      continue;
+
+    // Output paths are decided here so that they do not depend on the order in
+    // which the threads run
+    created_files[idx].push_back(
+      (create_as_tmpfile ? createTemporaryFilepath()
+                         : results[idx].file.stem().string())
+      + "." + extension_map.at(cgft));
+
+    whole_modules.push_back(idx);
+  }
+
+  parallelFor(whole_modules.size(), jobs, [&](const std::size_t idx) {
+    const auto result_idx = whole_modules[idx];
+
+    emitModule(results[result_idx],
+               created_files[result_idx].front().string(),
+               cgft);
+  });
+
+  // Split modules use all threads each, so they are emitted one by one
+  for (std::size_t idx = 0; idx < results.size(); ++idx) {
+    if (!created_files[idx].empty())
+      continue;
+
+    created_files[idx] = emitSplitModule(results[idx],
+                                         countPartitions(*results[idx].module),
+                                         cgft);
+  }
 
-    const auto output_file
-      = (create_as_tmpfile ? createTemporaryFilepath() : file.stem().string())
-        + "." + extension_map.at(cgft);
+  return created_files;
+}
+
+[[nodiscard]] ModuleFilePaths CodeGenerator::getImportedFiles() const
+{
+  ModuleFilePaths imported_files;
+
+  for (const auto& r : results)
+    imported_files.push_back(r.imported_files);
+
+  return imported_files;
+}
+
+[[nodiscard]] ClassTemplateStatistics
+CodeGenerator::getClassTemplateStatistics() const
+{
+  ClassTemplateStatistics sum{};
+
+  for (const auto& r : class_template_statistics)
+    sum += r;
+
+  return sum;
+}
+
+void CodeGenerator::emitModule(const Result&               result,
+                               const std::string&          output_file,
+                               const llvm::CodeGenFileType cgft) const
+{
+  const llvm::TimeTraceScope time_trace_scope{"Emit", result.file.string()};
+
+  std::error_code      ostream_ec;
+  llvm::raw_fd_ostream ostream{output_file,
+                               ostream_ec,
+                               llvm::sys::fs::OpenFlags::OF_None};
+
+  if (ostream_ec) {
+    throw CodegenError{formatError(
+      argv_front,
+      fmt::format("{}: {}\n", result.file.string(), ostream_ec.message()))};
+  }
+
+  const auto machine = acquireTargetMachine();
+
+  llvm::legacy::PassManager p_manager;
+
+  if (machine->addPassesToEmitFile(p_manager, ostream, nullptr, cgft))
+    throw CodegenError{formatError(argv_front, "failed to emit a file")};
+
+  p_manager.run(*result.module);
+  ostream.flush();
+}
+
+[[nodiscard]] FilePaths
+CodeGenerator::emitSplitModule(const Result&               result,
+                               const std::size_t           partitions,
+                               const llvm::CodeGenFileType cgft) const
+{
+  assert(cgft == llvm::CodeGenFileType::CGFT_ObjectFile);
+
+  // Only the calling thread is traced, the partitions are emitted on threads
+  // of splitCodeGen
+  const llvm::TimeTraceScope time_trace_scope{"Emit", result.file.string()};
+
+  FilePaths                                          created_files;
+  std::vector<std::unique_ptr<llvm::raw_fd_ostream>> ostreams;
+  std::vector<llvm::raw_pwrite_stream*>              ostream_ptrs;
+
+  for (std::size_t idx = 0; idx < partitions; ++idx) {
+    const auto output_file = createTemporaryFilepath() + ".o";
 
     created_files.push_back(output_file);
 
-    std::error_code      ostream_ec;
-    llvm::raw_fd_ostream ostream{output_file,
-                                 ostream_ec,
-                                 llvm::sys::fs::OpenFlags::OF_None};
+    std::error_code ostream_ec;
+    ostreams.push_back(std::make_unique<llvm::raw_fd_ostream>(
+      output_file,
+      ostream_ec,
+      llvm::sys::fs::OpenFlags::OF_None));
 
     if (ostream_ec) {
       throw CodegenError{formatError(
         argv_front,
-        fmt::format("{}: {}\n", file.string(), ostream_ec.message()))};
+        fmt::format("{}: {}\n", result.file.string(), ostream_ec.message()))};
     }
 
-    llvm::legacy::PassManager p_manager;
+    ostream_ptrs.push_back(ostreams.back().get());
+  }
 
-    if (target_machine->addPassesToEmitFile(p_manager,
-                                            ostream,
-                                            nullptr,
-                                            cgft)) {
-      throw CodegenError{formatError(argv_front, "failed to emit a file")};
-    }
+  // Local symbols are kept with their users, because externalizing them could
+  // clash with the same names in other translation units
+  llvm::splitCodeGen(
+    *result.module,
+    ostream_ptrs,
+    {},
+    [this] { return createTargetMachine(); },
+    cgft,
+    true);
 
-    p_manager.run(*std::get<std::unique_ptr<llvm::Module>>(*it));
-    ostream.flush();
-  }
+  for (auto&& r : ostreams)
+    r->flush();
 
   return created_files;
 }
 
+[[nodiscard]] std::size_t
+CodeGenerator::countPartitions(const llvm::Module& module) const noexcept
+{
+  // Splitting has its own cost (the module is serialized and loaded again for
+  // each partition), so it only pays off for modules with many functions
+  constexpr std::size_t min_functions_per_partition = 500;
+
+  std::size_t defined_functions = 0;
+
+  for (const auto& func : module) {
+    if (!func.isDeclaration())
+      ++defined_functions;
+  }
+
+  return std::clamp<std::size_t>(defined_functions
+                                   / min_functions_per_partition,
+                                 1,
+                                 resolveJobs(jobs));
+}
+
 void CodeGenerator::initTargetTripleAndMachine(
   const std::optional<std::string>& target_triple_arg)
 {
@@ -373,7 +827,7 @@ void CodeGenerator::initTargetTripleAndMachine(
                                     : llvm::sys::getDefaultTargetTriple();
 
   std::string target_triple_error;
-  auto const  target
+  target
     = llvm::TargetRegistry::lookupTarget(target_triple, target_triple_error);
 
   if (!target) {
@@ -383,15 +837,43 @@ void CodeGenerator::initTargetTripleAndMachine(
                                                target_triple_error))};
   }
 
+  target_machine = acquireTargetMachine();
+
+  if (!target_machine) {
+    throw CodegenError{formatError(
+      argv_front,
+      fmt::format("failed to create a target machine for {}", target_triple))};
+  }
+}
+
+[[nodiscard]] TargetMachinePool::Handle
+CodeGenerator::acquireTargetMachine() const
+{
+  const auto key = fmt::format("{}\n{}\n{}\n{}\n{}",
+                               target_triple,
+                               target_cpu.name,
+                               target_cpu.features,
+                               static_cast<int>(relocation_model),
+                               static_cast<int>(codegen_opt_level));
+
+  return TargetMachinePool::getInstance().acquire(key, [this] {
+    return createTargetMachine();
+  });
+}
+
+[[nodiscard]] std::unique_ptr<llvm::TargetMachine>
+CodeGenerator::createTargetMachine() const
+{
   llvm::TargetOptions target_options;
 
-  target_machine
-    = target->createTargetMachine(target_triple,
-                                  "generic",
-                                  "",
-                                  target_options,
-                                  llvm::Optional<llvm::Reloc::Model>(
-                                    relocation_model)); // Set relocation model.
+  return std::unique_ptr<llvm::TargetMachine>{target->createTargetMachine(
+    target_triple,
+    target_cpu.name,
+    target_cpu.features,
+    target_options,
+    llvm::Optional<llvm::Reloc::Model>(relocation_model),
+    llvm::None,
+    codegen_opt_level)};
 }
 
 } // namespace twinkle::codegen
@@ -32,7 +32,8 @@ void TemplateArgumentsDefiner::insertToAliasTable(
   ctx.template_argument_tables.emplace(std::move(template_argument_table));
 }
 
-[[nodiscard]] std::optional<std::pair<ClassTemplateTableValue, NamespaceStack>>
+[[nodiscard]] std::optional<
+  std::pair<const ClassTemplateTableValue*, NamespaceStack>>
 findClassTemplate(CGContext&                    ctx,
                   const std::string_view        name,
                   const ast::TemplateArguments& args)
@@ -44,7 +45,7 @@ findClassTemplate(CGContext&                    ctx,
         = ctx.class_template_table[TemplateTableKey{name,
                                                     args.types.size(),
                                                     namespace_copy}]) {
-      return std::make_pair(*value, std::move(namespace_copy));
+      return std::make_pair(&value->get(), std::move(namespace_copy));
     }
 
     if (namespace_copy.empty())
@@ -214,13 +215,13 @@ createEqual(CGContext& ctx, const Value& lhs, const Value& rhs)
     return {ctx.builder.CreateFCmp(llvm::CmpInst::Predicate::FCMP_UEQ,
                                    lhs.getValue(),
                                    rhs.getValue()),
-            std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+            ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
   }
 
   return {ctx.builder.CreateICmp(llvm::ICmpInst::ICMP_EQ,
                                  lhs.getValue(),
                                  rhs.getValue()),
-          std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+          ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
 }
 
 [[nodiscard]] Value
@@ -230,13 +231,13 @@ createNotEqual(CGContext& ctx, const Value& lhs, const Value& rhs)
     return {ctx.builder.CreateFCmp(llvm::CmpInst::Predicate::FCMP_UNE,
                                    lhs.getValue(),
                                    rhs.getValue()),
-            std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+            ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
   }
 
   return {ctx.builder.CreateICmp(llvm::ICmpInst::ICMP_NE,
                                  lhs.getValue(),
                                  rhs.getValue()),
-          std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+          ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
 }
 
 [[nodiscard]] Value
@@ -246,7 +247,7 @@ createLessThan(CGContext& ctx, const Value& lhs, const Value& rhs)
     return {ctx.builder.CreateFCmp(llvm::ICmpInst::FCMP_ULT,
                                    lhs.getValue(),
                                    rhs.getValue()),
-            std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+            ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
   }
 
   return {ctx.builder.CreateICmp(isSigned(logicalOrSign(ctx, lhs, rhs))
@@ -254,7 +255,7 @@ createLessThan(CGContext& ctx, const Value& lhs, const Value& rhs)
                                    : llvm::ICmpInst::ICMP_ULT,
                                  lhs.getValue(),
                                  rhs.getValue()),
-          std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+          ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
 }
 
 [[nodiscard]] Value
@@ -264,7 +265,7 @@ createGreaterThan(CGContext& ctx, const Value& lhs, const Value& rhs)
     return {ctx.builder.CreateFCmp(llvm::ICmpInst::FCMP_UGT,
                                    lhs.getValue(),
                                    rhs.getValue()),
-            std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+            ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
   }
 
   return {ctx.builder.CreateICmp(isSigned(logicalOrSign(ctx, lhs, rhs))
@@ -272,7 +273,7 @@ createGreaterThan(CGContext& ctx, const Value& lhs, const Value& rhs)
                                    : llvm::ICmpInst::ICMP_UGT,
                                  lhs.getValue(),
                                  rhs.getValue()),
-          std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+          ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
 }
 
 [[nodiscard]] Value
@@ -282,7 +283,7 @@ createLessOrEqual(CGContext& ctx, const Value& lhs, const Value& rhs)
     return {ctx.builder.CreateFCmp(llvm::ICmpInst::FCMP_ULE,
                                    lhs.getValue(),
                                    rhs.getValue()),
-            std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+            ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
   }
 
   return {ctx.builder.CreateICmp(isSigned(logicalOrSign(ctx, lhs, rhs))
@@ -290,7 +291,7 @@ createLessOrEqual(CGContext& ctx, const Value& lhs, const Value& rhs)
                                    : llvm::ICmpInst::ICMP_ULE,
                                  lhs.getValue(),
                                  rhs.getValue()),
-          std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+          ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
 }
 
 [[nodiscard]] Value
@@ -300,7 +301,7 @@ createGreaterOrEqual(CGContext& ctx, const Value& lhs, const Value& rhs)
     return {ctx.builder.CreateFCmp(llvm::ICmpInst::FCMP_UGE,
                                    lhs.getValue(),
                                    rhs.getValue()),
-            std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+            ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
   }
 
   return {ctx.builder.CreateICmp(isSigned(logicalOrSign(ctx, lhs, rhs))
@@ -308,21 +309,21 @@ createGreaterOrEqual(CGContext& ctx, const Value& lhs, const Value& rhs)
                                    : llvm::ICmpInst::ICMP_UGE,
                                  lhs.getValue(),
                                  rhs.getValue()),
-          std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+          ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
 }
 
 [[nodiscard]] Value
 createLogicalAnd(CGContext& ctx, const Value& lhs, const Value& rhs)
 {
   return {ctx.builder.CreateLogicalAnd(lhs.getValue(), rhs.getValue()),
-          std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+          ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
 }
 
 [[nodiscard]] Value
 createLogicalOr(CGContext& ctx, const Value& lhs, const Value& rhs)
 {
   return {ctx.builder.CreateLogicalOr(lhs.getValue(), rhs.getValue()),
-          std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+          ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
 }
 
 [[nodiscard]] Value
@@ -381,7 +382,7 @@ createDereference(CGContext& ctx, const PositionRange& pos, const Value& val)
                           const std::shared_ptr<Type>& left,
                           const std::shared_ptr<Type>& right)
 {
-  return left->getMangledName(ctx) == right->getMangledName(ctx);
+  return left->getIdentity(ctx) == right->getIdentity(ctx);
 }
 
 } // namespace twinkle::codegen
@@ -119,7 +119,7 @@ createScopeResolutionResult(CGContext& ctx, const ast::ScopeResolution& node)
 
 struct ExprVisitor : public boost::static_visitor<Value> {
   ExprVisitor(CGContext&         ctx,
-              const SymbolTable& scope,
+              const Scope&       scope,
               const StmtContext& stmt_ctx) noexcept
     : ctx{ctx}
     , scope{scope}
@@ -140,15 +140,15 @@ struct ExprVisitor : public boost::static_visitor<Value> {
   [[nodiscard]] Value operator()(const ast::NullPointer&) const
   {
     return {llvm::ConstantPointerNull::get(ctx.builder.getInt8PtrTy()),
-            std::make_shared<PointerType>(
-              std::make_shared<BuiltinType>(BuiltinTypeKind::i8, false),
+            ctx.types.getPointerType(
+              ctx.types.getBuiltinType(BuiltinTypeKind::i8, false),
               false)};
   }
 
   [[nodiscard]] Value operator()(const std::uint8_t node) const
   {
     return createAllocaUnsignedInt(
-      std::make_shared<BuiltinType>(BuiltinTypeKind::u8, false),
+      ctx.types.getBuiltinType(BuiltinTypeKind::u8, false),
       node);
   }
 
@@ -156,7 +156,7 @@ struct ExprVisitor : public boost::static_visitor<Value> {
   [[nodiscard]] Value operator()(const double node) const
   {
     return createAllocaFP(
-      std::make_shared<BuiltinType>(BuiltinTypeKind::f64, false),
+      ctx.types.getBuiltinType(BuiltinTypeKind::f64, false),
       node);
   }
 
@@ -164,7 +164,7 @@ struct ExprVisitor : public boost::static_visitor<Value> {
   [[nodiscard]] Value operator()(const std::uint32_t node) const
   {
     return createAllocaUnsignedInt(
-      std::make_shared<BuiltinType>(BuiltinTypeKind::u32, false),
+      ctx.types.getBuiltinType(BuiltinTypeKind::u32, false),
       node);
   }
 
@@ -172,7 +172,7 @@ struct ExprVisitor : public boost::static_visitor<Value> {
   [[nodiscard]] Value operator()(const std::int32_t node) const
   {
     return createAllocaSignedInt(
-      std::make_shared<BuiltinType>(BuiltinTypeKind::i32, false),
+      ctx.types.getBuiltinType(BuiltinTypeKind::i32, false),
       node);
   }
 
@@ -180,7 +180,7 @@ struct ExprVisitor : public boost::static_visitor<Value> {
   [[nodiscard]] Value operator()(const std::uint64_t node) const
   {
     return createAllocaUnsignedInt(
-      std::make_shared<BuiltinType>(BuiltinTypeKind::u64, false),
+      ctx.types.getBuiltinType(BuiltinTypeKind::u64, false),
       node);
   }
 
@@ -188,7 +188,7 @@ struct ExprVisitor : public boost::static_visitor<Value> {
   [[nodiscard]] Value operator()(const std::int64_t node) const
   {
     return createAllocaSignedInt(
-      std::make_shared<BuiltinType>(BuiltinTypeKind::i64, false),
+      ctx.types.getBuiltinType(BuiltinTypeKind::i64, false),
       node);
   }
 
@@ -217,7 +217,7 @@ struct ExprVisitor : public boost::static_visitor<Value> {
       initializer_list.push_back(boost::apply_visitor(*this, elem));
 
     const auto type
-      = std::make_shared<ArrayType>(initializer_list.front().getType(),
+      = ctx.types.getArrayType(initializer_list.front().getType(),
                                     initializer_list.size(),
                                     false);
 
@@ -247,11 +247,11 @@ struct ExprVisitor : public boost::static_visitor<Value> {
 
     case BuiltinMacroKind::infinity_:
       return createAllocaInfinityFP(
-        std::make_shared<BuiltinType>(BuiltinTypeKind::f32, false));
+        ctx.types.getBuiltinType(BuiltinTypeKind::f32, false));
 
     case BuiltinMacroKind::huge_val:
       return createAllocaInfinityFP(
-        std::make_shared<BuiltinType>(BuiltinTypeKind::f64, false));
+        ctx.types.getBuiltinType(BuiltinTypeKind::f64, false));
 
     case BuiltinMacroKind::unknown:
       unreachable();
@@ -479,7 +479,7 @@ struct ExprVisitor : public boost::static_visitor<Value> {
     // If not inserted (builder.Insert), malloc will be badref
     ctx.builder.Insert(malloc_inst);
 
-    const auto malloc_return_type = std::make_shared<PointerType>(type, false);
+    const auto malloc_return_type = ctx.types.getPointerType(type, false);
 
     if (is_class_ty && node.with_init) {
       auto args = createArgVals(node.initializer, ctx.positionOf(node));
@@ -517,7 +517,7 @@ struct ExprVisitor : public boost::static_visitor<Value> {
                                  ctx.builder.GetInsertBlock()));
 
     return {nullptr,
-            std::make_shared<BuiltinType>(BuiltinTypeKind::void_, false)};
+            ctx.types.getBuiltinType(BuiltinTypeKind::void_, false)};
   }
 
   [[nodiscard]] Value operator()(const ast::Dereference& node) const
@@ -839,7 +839,7 @@ private:
                           "",
                           class_type->getLLVMType(ctx));
 
-    const auto this_pointer_type = std::make_shared<PointerType>(
+    const auto this_pointer_type = ctx.types.getPointerType(
       std::make_shared<UserDefinedType>(real_class_name, false),
       false);
 
@@ -952,6 +952,13 @@ private:
                          const ast::TemplateArguments&     template_args,
                          const NamespaceStack&             space) const
   {
+    const llvm::TimeTraceScope time_trace_scope{"Instantiate function", [&] {
+                                                  return fmt::format(
+                                                    "{} ({})",
+                                                    ast.decl.name.utf8(),
+                                                    ctx.current_file.string());
+                                                }};
+
     const auto pos = ctx.positionOf(ast.decl);
 
     const TemplateArgumentsDefiner ta_definer{ctx,
@@ -980,8 +987,6 @@ private:
                          createType(ctx, ast.decl.return_type, pos),
                          ast.body);
 
-      ctx.fpm.run(*func);
-
       // Return insert point to previous location
       ctx.builder.SetInsertPoint(return_bb);
     }
@@ -1056,7 +1061,7 @@ private:
   [[nodiscard]] Value createAllocaBool(const bool value) const
   {
     const auto type
-      = std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false);
+      = ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false);
     auto const llvm_type = type->getLLVMType(ctx);
 
     auto const alloca
@@ -1072,8 +1077,8 @@ private:
 
   [[nodiscard]] Value createAllocaString(const std::string_view str) const
   {
-    const auto type = std::make_shared<PointerType>(
-      std::make_shared<BuiltinType>(BuiltinTypeKind::i8, false),
+    const auto type = ctx.types.getPointerType(
+      ctx.types.getBuiltinType(BuiltinTypeKind::i8, false),
       false);
     auto const llvm_type = type->getLLVMType(ctx);
 
@@ -1091,7 +1096,7 @@ private:
   [[nodiscard]] Value createAllocaChar(const unicode::Codepoint ch) const
   {
     const auto type
-      = std::make_shared<BuiltinType>(BuiltinTypeKind::char_, false);
+      = ctx.types.getBuiltinType(BuiltinTypeKind::char_, false);
     auto const llvm_type = type->getLLVMType(ctx);
 
     auto const alloca
@@ -1197,12 +1202,7 @@ private:
   [[nodiscard]] std::shared_ptr<Variable>
   findVariable(const ast::Identifier& node) const
   {
-    const auto ident = node.utf8();
-
-    if (const auto variable = scope[ident])
-      return *variable;
-
-    return nullptr;
+    return scope.find(node.utf8());
   }
 
   // Find a member of '*this'
@@ -1210,7 +1210,7 @@ private:
   [[nodiscard]] std::optional<Value>
   findMemberOfThis(const ast::Identifier& node) const
   {
-    if (scope["this"]) {
+    if (scope.find("this")) {
       const auto this_p
         = findVariable(ast::Identifier{std::u32string{U"this"}});
 
@@ -1364,7 +1364,7 @@ private:
   [[nodiscard]] Value createPointerToArray(const Value& array) const
   {
     return {llvm::getPointerOperand(array.getValue()),
-            std::make_shared<PointerType>(array.getType(), array.isMutable())};
+            ctx.types.getPointerType(array.getType(), array.isMutable())};
   }
 
   [[nodiscard]] Value createArraySubscript(const Value& array,
@@ -1428,20 +1428,20 @@ private:
         ctx.builder.CreateFCmp(llvm::ICmpInst::FCMP_OEQ,
                                value.getValue(),
                                llvm::ConstantFP::get(value.getLLVMType(), 0)),
-        std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+        ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
     }
 
     return {
       ctx.builder.CreateICmp(llvm::ICmpInst::ICMP_EQ,
                              value.getValue(),
                              llvm::ConstantInt::get(value.getLLVMType(), 0)),
-      std::make_shared<BuiltinType>(BuiltinTypeKind::bool_, false)};
+      ctx.types.getBuiltinType(BuiltinTypeKind::bool_, false)};
   }
 
   [[nodiscard]] Value createSizeOf(llvm::Type* const type) const
   {
     const auto usize_type
-      = std::make_shared<BuiltinType>(BuiltinTypeKind::usize, false);
+      = ctx.types.getBuiltinType(BuiltinTypeKind::usize, false);
 
     return {llvm::ConstantInt::get(
               usize_type->getLLVMType(ctx),
@@ -1458,7 +1458,7 @@ private:
                                       const PositionRange& pos) const
   {
     return {createAddressOf(val, pos).getValue(),
-            std::make_shared<ReferenceType>(val.getType(), false)};
+            ctx.types.getReferenceType(val.getType(), false)};
   }
 
   // Do not use for constants!
@@ -1470,7 +1470,7 @@ private:
     if (!ptr)
       throw CodegenError{ctx.formatError(pos, "operand has no address")};
 
-    return {ptr, std::make_shared<PointerType>(val.getType(), false)};
+    return {ptr, ctx.types.getPointerType(val.getType(), false)};
   }
 
   void verifyArguments(const std::deque<Value>& args,
@@ -1514,30 +1514,15 @@ private:
     return args;
   }
 
-  [[nodiscard]] llvm::Function*
-  findVarArgFunction(const std::vector<std::string>& mangled_names) const
+  [[nodiscard]] std::vector<const Type*>
+  createArgTypes(const std::deque<Value>& args) const
   {
-    const auto f = [&](const std::string_view mangled) -> llvm::Function* {
-      for (auto& func : ctx.module->getFunctionList()) {
-        const auto func_name = func.getName();
+    std::vector<const Type*> arg_types;
 
-        if (func_name.endswith(mangle::ellipsis)) {
-          // _Z1fv to _Z1f
-          const auto tmp = func_name.substr(0, func_name.size() - 2);
-          if (mangled.starts_with(tmp))
-            return &func;
-        }
-      }
+    for (const auto& arg : args)
+      arg_types.push_back(arg.getType()->getIdentity(ctx));
 
-      return nullptr;
-    };
-
-    for (const auto& r : mangled_names) {
-      if (auto const tmp = f(r))
-        return tmp;
-    }
-
-    return nullptr;
+    return arg_types;
   }
 
   // The innermost namespace is inserted at the beginning of the argument as
@@ -1552,31 +1537,27 @@ private:
       return nullptr;
     }
 
-    const auto f = [&](const Accessibility accessibility) {
-      const auto mangled_names
-        = ctx.mangler.mangleMethodCall(unmangled_name,
-                                       ctx.ns_hierarchy.top().name,
-                                       args,
-                                       accessibility);
-
-      const auto func = findFunction(ctx, mangled_names);
-
-      if (func)
-        return func;
-      else
-        return findVarArgFunction(mangled_names);
-
-      unreachable();
-    };
-
-    if (auto const func = f(Accessibility::public_))
+    auto arg_types = createArgTypes(args);
+
+    arg_types.insert(
+      arg_types.begin(),
+      ctx.types
+        .getPointerType(
+          std::make_shared<UserDefinedType>(ctx.ns_hierarchy.top().name,
+                                            false),
+          false)
+        ->getIdentity(ctx));
+
+    if (auto const func = ctx.overload_table.find(ctx.ns_hierarchy,
+                                                  unmangled_name,
+                                                  arg_types,
+                                                  Accessibility::public_))
       return func;
-    else if (auto const func = f(Accessibility::private_))
-      return func;
-    else
-      return nullptr;
 
-    unreachable();
+    return ctx.overload_table.find(ctx.ns_hierarchy,
+                                   unmangled_name,
+                                   arg_types,
+                                   Accessibility::private_);
   }
 
   [[nodiscard]] llvm::Function*
@@ -1590,22 +1571,10 @@ private:
         return func;
     }
 
-    const auto mangled_names
-      = ctx.mangler.mangleFunctionCall(unmangled_name, args);
-
-    auto const func = findFunction(ctx, mangled_names);
-
-    if (!func) {
-      // Mismatch or variadic arguments.
-      auto const vararg_func = findVarArgFunction(mangled_names);
-
-      if (vararg_func)
-        return vararg_func;
-      else
-        return nullptr;
-    }
-
-    return func;
+    return ctx.overload_table.find(ctx.ns_hierarchy,
+                                   unmangled_name,
+                                   createArgTypes(args),
+                                   Accessibility::non_method);
   }
 
   [[nodiscard]] Value memberVariableAccess(
@@ -1708,13 +1677,13 @@ private:
 
   CGContext& ctx;
 
-  const SymbolTable& scope;
+  const Scope& scope;
 
   const StmtContext& stmt_ctx;
 };
 
 [[nodiscard]] Value createExpr(CGContext&         ctx,
-                               const SymbolTable& scope,
+                               const Scope&       scope,
                                const StmtContext& stmt_ctx,
                                const ast::Expr&   expr)
 {
@@ -12,30 +12,15 @@
 namespace twinkle::codegen
 {
 
-[[nodiscard]] SymbolTable mergeSymbolTables(const SymbolTable& a,
-                                            const SymbolTable& b)
-{
-  SymbolTable merged_table{a};
-
-  for (const auto& r : b) {
-    // May be shadowed and must be overwriteable
-    merged_table.insertOrAssign(r.first, r.second);
-  }
-
-  return merged_table;
-}
-
 //===----------------------------------------------------------------------===//
 // Statement visitor
 //===----------------------------------------------------------------------===//
 
 struct StmtVisitor : public boost::static_visitor<void> {
   StmtVisitor(CGContext&         ctx,
-              const SymbolTable& parent_scope,
-              SymbolTable&       scope,
+              Scope&             scope,
               const StmtContext& stmt_ctx) noexcept
     : ctx{ctx}
-    , parent_scope{parent_scope}
     , scope{scope}
     , stmt_ctx{stmt_ctx}
   {
@@ -48,18 +33,18 @@ struct StmtVisitor : public boost::static_visitor<void> {
 
   void operator()(const ast::CompoundStatement& node) const
   {
-    createStatement(ctx, getAllSymbols(), stmt_ctx, node);
+    createStatement(ctx, scope, stmt_ctx, node);
   }
 
   void operator()(const ast::Expr& node) const
   {
-    static_cast<void>(createExpr(ctx, getAllSymbols(), stmt_ctx, node));
+    static_cast<void>(createExpr(ctx, scope, stmt_ctx, node));
   }
 
   void operator()(const ast::Return& node) const
   {
     if (node.rhs) {
-      auto const retval = createExpr(ctx, getAllSymbols(), stmt_ctx, *node.rhs);
+      auto const retval = createExpr(ctx, scope, stmt_ctx, *node.rhs);
 
       auto const return_type
         = ctx.return_type_table[ctx.builder.GetInsertBlock()->getParent()];
@@ -96,25 +81,24 @@ struct StmtVisitor : public boost::static_visitor<void> {
     if (node.type) {
       const auto type = createType(ctx, *node.type, ctx.positionOf(node));
 
-      scope.insertOrAssign(name,
-                           std::make_shared<AllocaVariable>(
-                             createAllocaVariable(ctx.positionOf(node),
-                                                  func,
-                                                  name,
-                                                  type,
-                                                  node.initializer,
-                                                  is_mutable)));
-    }
-    else {
-      scope.insertOrAssign(
-        name,
-        std::make_shared<AllocaVariable>(
-          createAllocaVariableTyInference(ctx.positionOf(node),
+      scope.insert(name,
+                   std::make_shared<AllocaVariable>(
+                     createAllocaVariable(ctx.positionOf(node),
                                           func,
                                           name,
+                                          type,
                                           node.initializer,
                                           is_mutable)));
     }
+    else {
+      scope.insert(name,
+                   std::make_shared<AllocaVariable>(
+                     createAllocaVariableTyInference(ctx.positionOf(node),
+                                                     func,
+                                                     name,
+                                                     node.initializer,
+                                                     is_mutable)));
+    }
   }
 
   void operator()(const ast::Assignment& node) const
@@ -138,7 +122,7 @@ struct StmtVisitor : public boost::static_visitor<void> {
 
     const auto one
       = Value{llvm::ConstantInt::get(ctx.builder.getInt32Ty(), 1),
-              std::make_shared<BuiltinType>(BuiltinTypeKind::i32, false)};
+              ctx.types.getBuiltinType(BuiltinTypeKind::i32, false)};
 
     switch (node.kind()) {
     case ast::PrefixIncrementDecrement::Kind::unknown:
@@ -169,8 +153,7 @@ struct StmtVisitor : public boost::static_visitor<void> {
 
     auto const merge_bb = llvm::BasicBlock::Create(ctx.context, "if_merge");
 
-    auto const cond_value
-      = createExpr(ctx, getAllSymbols(), stmt_ctx, node.condition);
+    auto const cond_value = createExpr(ctx, scope, stmt_ctx, node.condition);
 
     if (!cond_value.getLLVMType()->isIntegerTy()
         && !cond_value.getLLVMType()->isPointerTy()) {
@@ -189,7 +172,7 @@ struct StmtVisitor : public boost::static_visitor<void> {
     // Then statement codegen
     ctx.builder.SetInsertPoint(then_bb);
 
-    createStatement(ctx, getAllSymbols(), stmt_ctx, node.then_statement);
+    createStatement(ctx, scope, stmt_ctx, node.then_statement);
 
     if (!ctx.builder.GetInsertBlock()->getTerminator())
       ctx.builder.CreateBr(merge_bb);
@@ -199,7 +182,7 @@ struct StmtVisitor : public boost::static_visitor<void> {
     ctx.builder.SetInsertPoint(else_bb);
 
     if (node.else_statement)
-      createStatement(ctx, getAllSymbols(), stmt_ctx, *node.else_statement);
+      createStatement(ctx, scope, stmt_ctx, *node.else_statement);
 
     if (!ctx.builder.GetInsertBlock()->getTerminator())
       ctx.builder.CreateBr(merge_bb);
@@ -222,7 +205,7 @@ struct StmtVisitor : public boost::static_visitor<void> {
     ctx.builder.SetInsertPoint(body_bb);
 
     createStatement(ctx,
-                    getAllSymbols(),
+                    scope,
                     {stmt_ctx.destruct_bb,
                      stmt_ctx.return_var,
                      stmt_ctx.end_bb,
@@ -252,9 +235,9 @@ struct StmtVisitor : public boost::static_visitor<void> {
 
     auto const cond = ctx.builder.CreateICmp(
       llvm::ICmpInst::ICMP_NE,
-      createExpr(ctx, getAllSymbols(), stmt_ctx, node.cond_expr).getValue(),
+      createExpr(ctx, scope, stmt_ctx, node.cond_expr).getValue(),
       llvm::ConstantInt::get(
-        BuiltinType{BuiltinTypeKind::bool_, false}.getLLVMType(ctx),
+        ctx.builder.getInt1Ty(),
         0));
 
     ctx.builder.CreateCondBr(cond, body_bb, loop_end_bb);
@@ -263,7 +246,7 @@ struct StmtVisitor : public boost::static_visitor<void> {
     ctx.builder.SetInsertPoint(body_bb);
 
     createStatement(ctx,
-                    getAllSymbols(),
+                    scope,
                     {stmt_ctx.destruct_bb,
                      stmt_ctx.return_var,
                      stmt_ctx.end_bb,
@@ -304,10 +287,9 @@ struct StmtVisitor : public boost::static_visitor<void> {
     if (node.cond_expr) {
       auto const cond = ctx.builder.CreateICmp(
         llvm::ICmpInst::ICMP_NE,
-        createExpr(ctx, getAllSymbols(), new_stmt_ctx, *node.cond_expr)
-          .getValue(),
+        createExpr(ctx, scope, new_stmt_ctx, *node.cond_expr).getValue(),
         llvm::ConstantInt::get(
-          BuiltinType{BuiltinTypeKind::bool_, false}.getLLVMType(ctx),
+          ctx.builder.getInt1Ty(),
           0));
 
       ctx.builder.CreateCondBr(cond, body_bb, loop_end_bb);
@@ -323,7 +305,7 @@ struct StmtVisitor : public boost::static_visitor<void> {
     func->getBasicBlockList().push_back(body_bb);
     ctx.builder.SetInsertPoint(body_bb);
 
-    createStatement(ctx, getAllSymbols(), new_stmt_ctx, node.body);
+    createStatement(ctx, scope, new_stmt_ctx, node.body);
 
     if (!ctx.builder.GetInsertBlock()->getTerminator())
       ctx.builder.CreateBr(loop_bb);
@@ -333,7 +315,7 @@ struct StmtVisitor : public boost::static_visitor<void> {
 
     // Generate loop statement
     if (node.loop_stmt)
-      createStatement(ctx, getAllSymbols(), new_stmt_ctx, *node.loop_stmt);
+      createStatement(ctx, scope, new_stmt_ctx, *node.loop_stmt);
 
     ctx.builder.CreateBr(cond_bb);
 
@@ -355,8 +337,7 @@ struct StmtVisitor : public boost::static_visitor<void> {
 
   void operator()(const ast::Match& node) const
   {
-    const auto target_val
-      = createExpr(ctx, getAllSymbols(), stmt_ctx, node.target);
+    const auto target_val = createExpr(ctx, scope, stmt_ctx, node.target);
 
     const auto target_type = target_val.getType();
 
@@ -551,12 +532,7 @@ private:
 
     return {
       ctx.builder.CreateLoad(value->getType()->getPointerElementType(), value),
-      std::make_shared<BuiltinType>(BuiltinTypeKind::u8, false)};
-  }
-
-  [[nodiscard]] SymbolTable getAllSymbols() const
-  {
-    return mergeSymbolTables(parent_scope, scope);
+      ctx.types.getBuiltinType(BuiltinTypeKind::u8, false)};
   }
 
   void createAssignment(const ast::Assignment& node,
@@ -565,7 +541,7 @@ private:
     const auto lhs
       = createAssignableValue(node.lhs, ctx.positionOf(node), const_check);
 
-    const auto rhs = createExpr(ctx, getAllSymbols(), stmt_ctx, node.rhs);
+    const auto rhs = createExpr(ctx, scope, stmt_ctx, node.rhs);
 
     verifyVariableType(ctx.positionOf(node), rhs.getType());
 
@@ -615,7 +591,7 @@ private:
                                             const PositionRange& pos,
                                             const bool const_check = true) const
   {
-    const auto value = createExpr(ctx, getAllSymbols(), stmt_ctx, node);
+    const auto value = createExpr(ctx, scope, stmt_ctx, node);
 
     if (const_check && !value.isMutable()) {
       throw CodegenError{
@@ -628,7 +604,7 @@ private:
     }
 
     return {llvm::getPointerOperand(value.getValue()),
-            std::make_shared<PointerType>(value.getType(), value.isMutable())};
+            ctx.types.getPointerType(value.getType(), value.isMutable())};
   }
 
   void verifyVariableType(const PositionRange&         pos,
@@ -655,13 +631,12 @@ private:
     if (!initializer) {
       return {
         ctx,
-        {alloca, type->clone()},
+        {alloca, type},
         is_mutable
       };
     }
 
-    auto const init_value
-      = createExpr(ctx, getAllSymbols(), stmt_ctx, *initializer);
+    auto const init_value = createExpr(ctx, scope, stmt_ctx, *initializer);
 
     if (!equals(ctx, type, init_value.getType()))
       throw CodegenError{ctx.formatError(pos, "invalid initializer type")};
@@ -670,7 +645,7 @@ private:
 
     return {
       ctx,
-      {alloca, type->clone()},
+      {alloca, type},
       is_mutable
     };
   }
@@ -682,8 +657,7 @@ private:
                                   const std::optional<ast::Expr>& initializer,
                                   const bool is_mutable) const
   {
-    auto const init_value
-      = createExpr(ctx, getAllSymbols(), stmt_ctx, *initializer);
+    auto const init_value = createExpr(ctx, scope, stmt_ctx, *initializer);
 
     verifyVariableType(pos, init_value.getType());
 
@@ -693,16 +667,14 @@ private:
 
     return {
       ctx,
-      {alloca, init_value.getType()->clone()},
+      {alloca, init_value.getType()},
       is_mutable
     };
   }
 
   CGContext& ctx;
 
-  const SymbolTable& parent_scope;
-
-  SymbolTable& scope;
+  Scope& scope;
 
   const StmtContext& stmt_ctx;
 };
@@ -748,16 +720,19 @@ void invokeDestructor(CGContext& ctx, const std::shared_ptr<Variable>& this_)
 
 static void createDestructBB(CGContext&         ctx,
                              const StmtContext& stmt_ctx,
-                             const SymbolTable& symbols,
+                             const Scope&       scope,
                              const bool         return_)
 {
   ctx.builder.GetInsertBlock()->getParent()->getBasicBlockList().push_back(
     stmt_ctx.destruct_bb);
   ctx.builder.SetInsertPoint(stmt_ctx.destruct_bb);
 
-  for (const auto& symbol : symbols) {
-    if (symbol.second->getType()->isClassTy(ctx))
-      invokeDestructor(ctx, symbol.second);
+  // Destroyed in the reverse order of declaration
+  const auto& variables = scope.getVariables();
+
+  for (auto iter = variables.crbegin(); iter != variables.crend(); ++iter) {
+    if ((*iter)->getType()->isClassTy(ctx))
+      invokeDestructor(ctx, *iter);
   }
 
   if (return_)
@@ -765,11 +740,11 @@ static void createDestructBB(CGContext&         ctx,
 }
 
 void createStatement(CGContext&         ctx,
-                     const SymbolTable& scope_arg,
+                     const Scope&       scope_arg,
                      const StmtContext& stmt_ctx_arg,
                      const ast::Stmt&   statement)
 {
-  SymbolTable new_scope;
+  Scope new_scope{&scope_arg};
 
   auto new_stmt_ctx        = stmt_ctx_arg;
   new_stmt_ctx.destruct_bb = llvm::BasicBlock::Create(ctx.context, "destruct");
@@ -778,8 +753,7 @@ void createStatement(CGContext&         ctx,
     auto& statements = boost::get<ast::CompoundStatement>(statement);
 
     for (const auto& r : statements) {
-      boost::apply_visitor(StmtVisitor{ctx, scope_arg, new_scope, new_stmt_ctx},
-                           r);
+      boost::apply_visitor(StmtVisitor{ctx, new_scope, new_stmt_ctx}, r);
 
       if (ctx.builder.GetInsertBlock()->getTerminator()) {
         // Terminators cannot be placed in the middle of a basic block
@@ -789,8 +763,7 @@ void createStatement(CGContext&         ctx,
     }
   }
   else {
-    boost::apply_visitor(StmtVisitor{ctx, scope_arg, new_scope, new_stmt_ctx},
-                         statement);
+    boost::apply_visitor(StmtVisitor{ctx, new_scope, new_stmt_ctx}, statement);
   }
 
   // The presence of a terminator means that there was a return statement
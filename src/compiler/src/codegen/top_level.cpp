@@ -9,6 +9,8 @@
 #include <twinkle/codegen/expr.hpp>
 #include <twinkle/codegen/stmt.hpp>
 #include <twinkle/codegen/exception.hpp>
+#include <twinkle/parse/interface.hpp>
+#include <twinkle/support/file.hpp>
 
 namespace twinkle::codegen
 {
@@ -93,14 +95,14 @@ createLLVMTypes(CGContext& ctx, const std::vector<std::shared_ptr<Type>>& types)
   return llvm_types;
 }
 
-[[nodiscard]] static SymbolTable
-createArgumentTable(CGContext&                ctx,
-                    llvm::Function* const     func,
-                    const ast::ParameterList& param_list,
-                    llvm::iterator_range<llvm::Function::arg_iterator>&& args)
+// Arguments are inserted into 'scope'
+static void
+createArguments(CGContext&                ctx,
+                Scope&                    scope,
+                llvm::Function* const     func,
+                const ast::ParameterList& param_list,
+                llvm::iterator_range<llvm::Function::arg_iterator>&& args)
 {
-  SymbolTable argument_table;
-
   const auto pos = ctx.positionOf(param_list);
 
   for (auto& arg : args) {
@@ -118,15 +120,13 @@ createArgumentTable(CGContext&                ctx,
     ctx.builder.CreateStore(&arg, alloca);
 
     // Add arguments to variable symbol table
-    argument_table.insertOrAssign(
+    scope.insert(
       arg.getName().str(),
       std::make_shared<AllocaVariable>(
         ctx,
         Value{alloca, param_type},
         param_node.qualifier.contains(VariableQual::mutable_)));
   }
-
-  return argument_table;
 }
 
 void createFunctionBody(CGContext&                  ctx,
@@ -139,7 +139,8 @@ void createFunctionBody(CGContext&                  ctx,
   auto const entry_bb = llvm::BasicBlock::Create(ctx.context, "", func);
   ctx.builder.SetInsertPoint(entry_bb);
 
-  auto argument_table = createArgumentTable(ctx, func, params, func->args());
+  Scope argument_scope;
+  createArguments(ctx, argument_scope, func, params, func->args());
 
   // Used to combine returns into one
   auto const end_bb = llvm::BasicBlock::Create(ctx.context, "end");
@@ -151,7 +152,7 @@ void createFunctionBody(CGContext&                  ctx,
         : createEntryAlloca(func, "", return_type->getLLVMType(ctx));
 
   createStatement(ctx,
-                  argument_table,
+                  argument_scope,
                   {nullptr, return_variable, end_bb, nullptr, nullptr},
                   body);
 
@@ -457,12 +458,15 @@ void createClass(CGContext&                        ctx,
         = variable->qualifier
           && (*variable->qualifier == VariableQual::mutable_);
 
-      const auto type
-        = createType(ctx, variable->type, ctx.positionOf(*variable));
+      const auto pos  = ctx.positionOf(*variable);
+      const auto type = createType(ctx, variable->type, pos);
 
-      type->setMutable(ctx, is_mutable);
+      // 'withMutable' reports unknown types without their position
+      verifyType(ctx, type, pos);
 
-      member_variables.push_back({variable->name.utf8(), type, accessibility});
+      member_variables.push_back({variable->name.utf8(),
+                                  type->withMutable(ctx, is_mutable),
+                                  accessibility});
     }
     else if (const auto function = boost::get<ast::FunctionDef>(&member)) {
       auto function_clone = *function;
@@ -587,11 +591,17 @@ struct TopLevelVisitor : public boost::static_visitor<llvm::Function*> {
 
   llvm::Function* operator()(const ast::FunctionDecl& node) const
   {
-    return declareFunction(
+    auto const func = declareFunction(
       ctx,
       node,
       mangleFunction(node),
       createType(ctx, node.return_type, ctx.positionOf(node)));
+
+    // Constructors and destructors are found by their mangled names
+    if (!node.is_constructor && !node.is_destructor)
+      insertOverload(node, func);
+
+    return func;
   }
 
   llvm::Function* operator()(const ast::FunctionDef& node) const
@@ -618,6 +628,13 @@ struct TopLevelVisitor : public boost::static_visitor<llvm::Function*> {
 
     const auto name = node.decl.name.utf8();
 
+    const llvm::TimeTraceScope time_trace_scope{"Function", [&] {
+                                                  return fmt::format(
+                                                    "{} ({})",
+                                                    name,
+                                                    ctx.current_file.string());
+                                                }};
+
     auto func = ctx.module->getFunction(mangleFunction(node.decl));
 
     if (func && !func->isDeclaration()) {
@@ -642,8 +659,6 @@ struct TopLevelVisitor : public boost::static_visitor<llvm::Function*> {
       createType(ctx, node.decl.return_type, ctx.positionOf(node.decl)),
       node.body);
 
-    ctx.fpm.run(*func);
-
     return func;
   }
 
@@ -661,10 +676,19 @@ struct TopLevelVisitor : public boost::static_visitor<llvm::Function*> {
 
   llvm::Function* operator()(const ast::ClassDef& node) const
   {
-    if (node.isTemplate())
+    if (node.isTemplate()) {
       insertTemplateClassToTable(node);
-    else
-      createClass(ctx, node, MethodGeneration::define_and_declare);
+      return nullptr;
+    }
+
+    const llvm::TimeTraceScope time_trace_scope{"Class", [&] {
+                                                  return fmt::format(
+                                                    "{} ({})",
+                                                    node.name.utf8(),
+                                                    ctx.current_file.string());
+                                                }};
+
+    createClass(ctx, node, MethodGeneration::define_and_declare);
 
     return nullptr;
   }
@@ -713,19 +737,47 @@ struct TopLevelVisitor : public boost::static_visitor<llvm::Function*> {
 
     auto path = ctx.current_file.parent_path() / fs::path{node.path.utf32()};
 
-    const auto result
-      = parse::Parser{loadFile(path, ctx.positionOf(node)), path}.getResult();
+    const llvm::TimeTraceScope time_trace_scope{"Import", path.string()};
+
+    // The interface file has the same lines as the source, so errors in it
+    // refer to the source
+    const auto parse = [&] {
+      if (auto input = parse::loadInterface(path))
+        return parse::Parser{std::move(*input), path, ctx.parser_kind}
+          .getResult();
 
-    ctx.position_cache_table.insert(path.string(), std::move(result.positions));
+      return parse::Parser{loadFile(path, ctx.positionOf(node)),
+                           path,
+                           ctx.parser_kind}
+        .getResult();
+    };
+
+    const auto result
+      = ctx.import_cache
+          ? ctx.import_cache->load(path, ctx.parser_kind, parse)
+          : std::make_shared<const parse::Parser::Result>(parse());
+
+    ctx.imported_files.push_back(path);
+    ctx.imported_results.push_back(result);
+
+    // A cached result may have been imported already, possibly through
+    // another path
+    ctx.position_tables.insertOrAssign(result->positions->getFileID(),
+                                       result->positions);
+    ctx.source_table.insertOrAssign(result->file.string(), result->source);
     const auto file_backup = std::move(ctx.current_file);
-    ctx.current_file       = std::move(result.file);
+    ctx.current_file       = result->file;
 
-    for (const auto& node_with_attr : result.ast) {
+    for (const auto& node_with_attr : result->ast) {
       const auto node = node_with_attr.top_level;
 
       if (const auto func_def = boost::get<ast::FunctionDef>(&node);
           func_def && func_def->is_public) {
-        (*this)(func_def->decl);
+        if (func_def->decl.isTemplate())
+          (*this)(*func_def);
+        else
+          (*this)(func_def->decl);
+
         continue;
       }
 
@@ -738,6 +790,10 @@ struct TopLevelVisitor : public boost::static_visitor<llvm::Function*> {
 
         continue;
       }
+
+      if (const auto union_def = boost::get<ast::UnionDef>(&node);
+          union_def && union_def->is_public)
+        (*this)(*union_def);
     }
 
     ctx.current_file = std::move(file_backup);
@@ -800,24 +856,40 @@ private:
     createClass(ctx, node, MethodGeneration::declare /* Only declaration */);
   }
 
-  [[nodiscard]] std::string loadFile(const std::filesystem::path& path,
-                                     const PositionRange&         pos) const
+  [[nodiscard]] SourceBufferPtr loadFile(const std::filesystem::path& path,
+                                         const PositionRange&         pos) const
   {
-    if (!std::filesystem::exists(path)) {
-      throw CodegenError{ctx.formatError(
-        pos,
-        fmt::format("{}: No such file or directory", path.string()))};
-    }
+    const llvm::TimeTraceScope time_trace_scope{"Load file", path.string()};
 
-    if (auto file = std::ifstream{path, std::ios_base::binary}) {
-      std::stringstream ss;
-      ss << file.rdbuf();
-      return ss.str();
-    }
+    auto source = mapSourceFile(path);
 
-    throw CodegenError{
-      ctx.formatError(pos,
-                      fmt::format("{}: Could not open file", path.string()))};
+    if (source)
+      return std::move(*source);
+
+    throw CodegenError{ctx.formatError(
+      pos,
+      fmt::format("{}: {}",
+                  path.string(),
+                  describeLoadError(source.getError())))};
+  }
+
+  void insertOverload(const ast::FunctionDecl& node,
+                      llvm::Function* const    func) const
+  {
+    const auto param_types = ctx.param_types_table[func];
+    assert(param_types);
+
+    std::vector<const Type*> param_identities;
+
+    for (const auto& r : param_types->get())
+      param_identities.push_back(r->getIdentity(ctx));
+
+    ctx.overload_table.insert(ctx.ns_hierarchy,
+                              node.name.utf8(),
+                              {func,
+                               std::move(param_identities),
+                               func->isVarArg(),
+                               node.accessibility});
   }
 
   [[nodiscard]] std::string mangleFunction(const ast::FunctionDecl& node) const
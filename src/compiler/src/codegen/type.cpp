@@ -14,7 +14,25 @@
 namespace twinkle::codegen
 {
 
-[[nodiscard]] llvm::Type* BuiltinType::getLLVMType(CGContext& ctx) const
+BuiltinType::BuiltinType(CGContext&            ctx,
+                         const BuiltinTypeKind kind,
+                         const bool            is_mutable)
+  : Type{is_mutable}
+  , kind{kind}
+  , llvm_type{createLLVMType(ctx, kind)}
+  , mangled_name{mangledNameOf(kind)}
+  , sign_kind{signKindOf(kind)}
+{
+}
+
+[[nodiscard]] std::shared_ptr<Type>
+BuiltinType::withMutable(CGContext& ctx, const bool is_mutable)
+{
+  return ctx.types.getBuiltinType(kind, is_mutable);
+}
+
+[[nodiscard]] llvm::Type*
+BuiltinType::createLLVMType(CGContext& ctx, const BuiltinTypeKind kind)
 {
   switch (kind) {
   case BuiltinTypeKind::void_:
@@ -53,7 +71,7 @@ namespace twinkle::codegen
   unreachable();
 }
 
-[[nodiscard]] SignKind BuiltinType::getSignKind(CGContext&) const
+[[nodiscard]] SignKind BuiltinType::signKindOf(const BuiltinTypeKind kind)
 {
   switch (kind) {
   case BuiltinTypeKind::i8:
@@ -102,7 +120,8 @@ namespace twinkle::codegen
   unreachable();
 }
 
-[[nodiscard]] std::string BuiltinType::getMangledName(CGContext&) const
+[[nodiscard]] std::string
+BuiltinType::mangledNameOf(const BuiltinTypeKind kind)
 {
   switch (kind) {
   case BuiltinTypeKind::void_:
@@ -143,29 +162,46 @@ namespace twinkle::codegen
 [[nodiscard]] std::shared_ptr<Type>
 UserDefinedType::getRealType(CGContext& ctx) const
 {
-  const auto clone_and_update_mutable = [&](const auto& type) {
-    auto cloned_type = type->get()->clone();
-    cloned_type->setMutable(ctx, isMutable());
-    return cloned_type;
-  };
-
   if (const auto type = ctx.class_table[ident])
-    return clone_and_update_mutable(type);
+    return type->get()->withMutable(ctx, isMutable());
 
   if (const auto type = ctx.alias_table[ident])
-    return clone_and_update_mutable(type);
+    return type->get()->withMutable(ctx, isMutable());
 
   if (const auto type = ctx.union_table[ident])
-    return clone_and_update_mutable(type);
+    return type->get()->withMutable(ctx, isMutable());
 
   if (!ctx.template_argument_tables.empty()) {
     if (const auto type = ctx.template_argument_tables.top()[ident])
-      return clone_and_update_mutable(type);
+      return type->get()->withMutable(ctx, isMutable());
   }
 
   return {}; // Could not find a type
 }
 
+[[nodiscard]] std::shared_ptr<Type>
+UserDefinedType::withMutable(CGContext& ctx, const bool is_mutable)
+{
+  return getExistingRealType(ctx)->withMutable(ctx, is_mutable);
+}
+
+[[nodiscard]] const Type* UserDefinedType::getIdentity(CGContext& ctx) const
+{
+  return getExistingRealType(ctx)->getIdentity(ctx);
+}
+
+// Types are interned as soon as they are created, which is before
+// 'verifyType' can report an unknown type at its position
+[[nodiscard]] std::shared_ptr<Type>
+UserDefinedType::getExistingRealType(CGContext& ctx) const
+{
+  if (const auto type = getRealType(ctx))
+    return type;
+
+  throw CodegenError{
+    formatError(ctx.current_file.string(), "unknown type name specified")};
+}
+
 [[nodiscard]] llvm::Type* UserDefinedType::getLLVMType(CGContext& ctx) const
 {
   const auto type = getRealType(ctx);
@@ -197,11 +233,12 @@ ClassType::ClassType(CGContext&                    ctx,
                      const std::u32string&         u32_name,
                      const bool                    is_mutable)
   : Type{is_mutable}
-  , is_opaque{false}
-  , members{std::move(members_arg)}
+  , body{std::make_shared<Body>(false, std::move(members_arg))}
   , name{unicode::utf32toUtf8(u32_name)}
-  , type{createStructType(ctx, extractTypes(ctx, members), name)}
+  , type{createStructType(ctx, extractTypes(ctx, body->members), name)}
 {
+  is_canonical = true;
+  identity     = this;
 }
 
 ClassType::ClassType(CGContext&                    ctx,
@@ -209,24 +246,32 @@ ClassType::ClassType(CGContext&                    ctx,
                      const std::string&            name,
                      const bool                    is_mutable)
   : Type{is_mutable}
-  , is_opaque{false}
-  , members{std::move(members_arg)}
+  , body{std::make_shared<Body>(false, std::move(members_arg))}
   , name{name}
-  , type{createStructType(ctx, extractTypes(ctx, members), this->name)}
+  , type{createStructType(ctx, extractTypes(ctx, body->members), this->name)}
 {
+  is_canonical = true;
+  identity     = this;
 }
 
-ClassType::ClassType(CGContext&                    ctx,
+ClassType::ClassType(CGContext&,
                      std::vector<MemberVariable>&& members,
                      const std::string&            ident,
                      llvm::StructType* const       type,
                      const bool                    is_mutable)
   : Type{is_mutable}
-  , is_opaque{true}
-  , members{std::move(members)}
+  , body{std::make_shared<Body>(true, std::move(members))}
   , name{ident}
   , type{type}
 {
+  is_canonical = true;
+  identity     = this;
+}
+
+[[nodiscard]] std::shared_ptr<Type>
+ClassType::withMutable(CGContext& ctx, const bool is_mutable)
+{
+  return ctx.types.getVariantType(*this, is_mutable);
 }
 
 std::shared_ptr<ClassType>
@@ -257,13 +302,13 @@ void ClassType::setBody(CGContext&                    ctx,
 {
   llvm::cast<llvm::StructType>(type)->setBody(extractTypes(ctx, members_arg));
 
-  members = std::move(members_arg);
+  body->members = std::move(members_arg);
 }
 
 [[nodiscard]] std::optional<std::size_t>
 ClassType::offsetByName(const std::string_view member_name) const
 {
-  for (std::size_t offset = 0; const auto& member : members) {
+  for (std::size_t offset = 0; const auto& member : body->members) {
     if (member.name == member_name)
       return offset;
     ++offset;
@@ -342,6 +387,14 @@ UnionType::UnionType(CGContext&         ctx,
   , name{name}
   , actual{createActual(ctx, members, this->name)}
 {
+  is_canonical = true;
+  identity     = this;
+}
+
+[[nodiscard]] std::shared_ptr<Type>
+UnionType::withMutable(CGContext& ctx, const bool is_mutable)
+{
+  return ctx.types.getVariantType(*this, is_mutable);
 }
 
 [[nodiscard]] std::optional<const std::reference_wrapper<const UnionVariant>>
@@ -355,15 +408,169 @@ UnionType::getUnionVariantType(const std::string& tag) const
   return std::nullopt;
 }
 
-[[nodiscard]] std::string PointerType::getMangledName(CGContext& ctx) const
+PointerType::PointerType(CGContext&                   ctx,
+                         const std::shared_ptr<Type>& pointee_type,
+                         const bool                   is_mutable)
+  : Type{is_mutable}
+  , pointee_type{pointee_type}
+  , llvm_type{llvm::PointerType::getUnqual(pointee_type->getLLVMType(ctx))}
+  , mangled_name{"P" + pointee_type->getMangledName(ctx)}
+{
+}
+
+[[nodiscard]] std::shared_ptr<Type>
+PointerType::withMutable(CGContext& ctx, const bool is_mutable)
+{
+  return ctx.types.getPointerType(pointee_type->withMutable(ctx, is_mutable),
+                                  is_mutable);
+}
+
+ArrayType::ArrayType(CGContext&                   ctx,
+                     const std::shared_ptr<Type>& element_type,
+                     const std::uint64_t          array_size,
+                     const bool                   is_mutable)
+  : Type{is_mutable}
+  , element_type{element_type}
+  , array_size{array_size}
+  , llvm_type{llvm::ArrayType::get(element_type->getLLVMType(ctx), array_size)}
+  , mangled_name{"A" + boost::lexical_cast<std::string>(array_size) + "_"
+                 + element_type->getMangledName(ctx)}
+{
+}
+
+[[nodiscard]] std::shared_ptr<Type>
+ArrayType::withMutable(CGContext& ctx, const bool is_mutable)
+{
+  return ctx.types.getArrayType(element_type->withMutable(ctx, is_mutable),
+                                array_size,
+                                is_mutable);
+}
+
+ReferenceType::ReferenceType(CGContext&                   ctx,
+                             const std::shared_ptr<Type>& refee_type,
+                             const bool                   is_mutable)
+  : Type{is_mutable}
+  , refee_type{refee_type}
+  , llvm_type{llvm::PointerType::getUnqual(refee_type->getLLVMType(ctx))}
+  , mangled_name{"R" + refee_type->getMangledName(ctx)}
+  , sign_kind{refee_type->getSignKind(ctx)}
+{
+}
+
+[[nodiscard]] std::shared_ptr<Type>
+ReferenceType::withMutable(CGContext& ctx, const bool is_mutable)
+{
+  return ctx.types.getReferenceType(refee_type->withMutable(ctx, is_mutable),
+                                    is_mutable);
+}
+
+[[nodiscard]] std::shared_ptr<Type>
+TypeInterner::getBuiltinType(const BuiltinTypeKind kind, const bool is_mutable)
+{
+  auto& type = builtin_types[static_cast<std::size_t>(kind)][is_mutable];
+
+  if (!type) {
+    type = std::make_shared<BuiltinType>(ctx, kind, is_mutable);
+    setIdentity(*type);
+  }
+
+  return type;
+}
+
+[[nodiscard]] std::shared_ptr<Type>
+TypeInterner::getPointerType(const std::shared_ptr<Type>& pointee_type,
+                             const bool                   is_mutable)
 {
-  return "P" + pointee_type->getMangledName(ctx);
+  const auto canonical_pointee_type = canonicalize(pointee_type);
+
+  auto& type = pointer_types[is_mutable][canonical_pointee_type.get()];
+
+  if (!type) {
+    type
+      = std::make_shared<PointerType>(ctx, canonical_pointee_type, is_mutable);
+    setIdentity(*type);
+  }
+
+  return type;
 }
 
-[[nodiscard]] std::string ArrayType::getMangledName(CGContext& ctx) const
+[[nodiscard]] std::shared_ptr<Type>
+TypeInterner::getArrayType(const std::shared_ptr<Type>& element_type,
+                           const std::uint64_t          array_size,
+                           const bool                   is_mutable)
 {
-  return "A" + boost::lexical_cast<std::string>(array_size) + "_"
-         + element_type->getMangledName(ctx);
+  const auto canonical_element_type = canonicalize(element_type);
+
+  auto& type
+    = array_types[is_mutable][canonical_element_type.get()][array_size];
+
+  if (!type) {
+    type = std::make_shared<ArrayType>(ctx,
+                                       canonical_element_type,
+                                       array_size,
+                                       is_mutable);
+    setIdentity(*type);
+  }
+
+  return type;
+}
+
+[[nodiscard]] std::shared_ptr<Type>
+TypeInterner::getReferenceType(const std::shared_ptr<Type>& refee_type,
+                               const bool                   is_mutable)
+{
+  const auto canonical_refee_type = canonicalize(refee_type);
+
+  auto& type = reference_types[is_mutable][canonical_refee_type.get()];
+
+  if (!type) {
+    type
+      = std::make_shared<ReferenceType>(ctx, canonical_refee_type, is_mutable);
+    setIdentity(*type);
+  }
+
+  return type;
+}
+
+[[nodiscard]] std::shared_ptr<Type>
+TypeInterner::getVariantType(Type& type, const bool is_mutable)
+{
+  assert(type.identity);
+
+  auto& variant = variant_types[is_mutable][type.identity];
+
+  if (!variant) {
+    // The identity is the type in the class or union table
+    auto& original = *type.identity;
+
+    if (original.is_mutable == is_mutable)
+      variant = original.shared_from_this();
+    else {
+      // The clone shares the identity of the original
+      variant             = original.clone();
+      variant->is_mutable = is_mutable;
+    }
+  }
+
+  return variant;
+}
+
+[[nodiscard]] std::shared_ptr<Type>
+TypeInterner::canonicalize(const std::shared_ptr<Type>& type) const
+{
+  if (type->isCanonical())
+    return type;
+
+  return type->withMutable(ctx, type->isMutable());
+}
+
+void TypeInterner::setIdentity(Type& type) const
+{
+  type.is_canonical = true;
+
+  // The type without mutability is the type itself if it is already in the
+  // table, so 'withMutable' does not recurse endlessly
+  type.identity = type.withMutable(ctx, false).get();
 }
 
 void verifyType(CGContext&                   ctx,
@@ -390,7 +597,7 @@ struct TypeVisitor : public boost::static_visitor<std::shared_ptr<Type>> {
   [[nodiscard]] std::shared_ptr<Type>
   operator()(const ast::BuiltinType& node) const
   {
-    return std::make_shared<BuiltinType>(node.kind, false);
+    return ctx.types.getBuiltinType(node.kind, false);
   }
 
   [[nodiscard]] std::shared_ptr<Type>
@@ -400,7 +607,7 @@ struct TypeVisitor : public boost::static_visitor<std::shared_ptr<Type>> {
 
     verifyType(ctx, type, ctx.positionOf(node));
 
-    return std::make_shared<ArrayType>(type, node.size, false);
+    return ctx.types.getArrayType(type, node.size, false);
   }
 
   [[nodiscard]] std::shared_ptr<Type>
@@ -413,7 +620,7 @@ struct TypeVisitor : public boost::static_visitor<std::shared_ptr<Type>> {
     verifyType(ctx, type, ctx.positionOf(node));
 
     for (std::size_t i = 0; i < node.n_ops.size(); ++i)
-      type = std::make_shared<PointerType>(type, false);
+      type = ctx.types.getPointerType(type, false);
 
     return type;
   }
@@ -434,12 +641,6 @@ struct TypeVisitor : public boost::static_visitor<std::shared_ptr<Type>> {
 
     const auto class_name = node.template_type.name.utf8();
 
-    const auto mangled_class_name
-      = ctx.mangler.mangleClassTemplateName(class_name, node.template_args);
-
-    const auto template_type
-      = std::make_shared<UserDefinedType>(mangled_class_name, false);
-
     const auto class_template
       = findClassTemplate(ctx, class_name, node.template_args);
 
@@ -449,30 +650,40 @@ struct TypeVisitor : public boost::static_visitor<std::shared_ptr<Type>> {
         fmt::format("unknown class template '{}'", class_name))};
     }
 
-    auto table_key = CreatedClassTemplateTableKey{class_name,
-                                                  node.template_args,
-                                                  class_template->second};
+    auto table_key
+      = ctx.created_class_template_table.createKey(*class_template->first,
+                                                   node.template_args);
 
     if (const auto type = ctx.created_class_template_table[table_key])
       return *type;
 
-    const auto type = createClassFromTemplate(mangled_class_name,
-                                              class_template->first,
-                                              node.template_args,
-                                              class_template->second,
-                                              pos);
+    const auto mangled_class_name
+      = ctx.mangler.mangleClassTemplateName(class_name, node.template_args);
 
-    ctx.created_class_template_table.insert(std::move(table_key), type);
+    // Register the declaration before instantiating the class because the
+    // class may refer to itself, e.g. in the parameters of its methods
+    if (!ctx.class_table.exists(mangled_class_name)) {
+      ctx.class_table.insert(
+        mangled_class_name,
+        ClassType::createOpaqueClass(ctx, mangled_class_name));
+    }
 
-    return type;
+    ctx.created_class_template_table.insert(
+      std::move(table_key),
+      ctx.class_table[mangled_class_name]->get());
+
+    return createClassFromTemplate(mangled_class_name,
+                                   *class_template->first,
+                                   node.template_args,
+                                   class_template->second,
+                                   pos);
   }
 
   [[nodiscard]] std::shared_ptr<Type>
   operator()(const ast::ReferenceType& node) const
   {
-    return std::make_shared<ReferenceType>(
-      createType(ctx, node.refee_type, pos),
-      false);
+    return ctx.types.getReferenceType(createType(ctx, node.refee_type, pos),
+                                      false);
   }
 
 private:
@@ -483,6 +694,13 @@ private:
     const NamespaceStack&          space, // FIXME: Use this argument
     const PositionRange&           pos) const
   {
+    const llvm::TimeTraceScope time_trace_scope{"Instantiate class", [&] {
+                                                  return fmt::format(
+                                                    "{} ({})",
+                                                    mangled_class_name,
+                                                    ctx.current_file.string());
+                                                }};
+
     const TemplateArgumentsDefiner ta_definer{ctx,
                                               template_args,
                                               ast.template_params,
@@ -8,18 +8,26 @@
 #include <twinkle/compile/compile.hpp>
 #include <twinkle/codegen/codegen.hpp>
 #include <twinkle/jit/jit.hpp>
+#include <twinkle/linker/linker.hpp>
 #include <twinkle/parse/parser.hpp>
+#include <twinkle/parse/exception.hpp>
+#include <twinkle/parse/import_cache.hpp>
+#include <twinkle/parse/interface.hpp>
 #include <twinkle/support/file.hpp>
 #include <twinkle/support/utils.hpp>
+#include <twinkle/support/parallel.hpp>
+#include <twinkle/support/target.hpp>
 #include <twinkle/support/exception.hpp>
+#include <twinkle/cache/cache.hpp>
+#include <llvm/ADT/Triple.h>
 
 namespace twinkle
 {
 
 // Emit object file without error even if target does not exist
 // Returns the created file paths
-static FilePaths emitFile(codegen::CodeGenerator& generator,
-                          const std::string&      target)
+static ModuleFilePaths emitFile(codegen::CodeGenerator& generator,
+                                const std::string&      target)
 {
   if (target == EMIT_EXE_ARG)
     return generator.emitTemporaryObjectFiles();
@@ -52,30 +60,399 @@ getRelocationModel(const std::string_view reloc_model,
   }
 }
 
+static void verifyLinker(const std::string_view linker,
+                         const std::string_view argv_front)
+{
+  if (linker::isLinkerAvailable(linker))
+    return;
+
+  if (linker == LINKER_LLD_ARG) {
+    throw ErrorBase{formatError(
+      argv_front,
+      "--linker=" LINKER_LLD_ARG " is not available since twinkle was built "
+      "without LLD")};
+  }
+
+  throw ErrorBase{formatError(
+    argv_front,
+    fmt::format("the value '{}' for --linker is invalid!", linker))};
+}
+
+[[nodiscard]] static llvm::Optional<llvm::PGOOptions>
+getPGOOptions(const Context& ctx, const std::string_view argv_front)
+{
+  // The runtime decides where the profile is written
+  if (ctx.profile_generate)
+    return llvm::PGOOptions{"", "", "", llvm::PGOOptions::IRInstr};
+
+  if (ctx.profile_use) {
+    if (!std::filesystem::exists(*ctx.profile_use)) {
+      throw FileError{formatError(
+        argv_front,
+        fmt::format("{}: No such file or directory", *ctx.profile_use))};
+    }
+
+    return llvm::PGOOptions{*ctx.profile_use, "", "", llvm::PGOOptions::IRUse};
+  }
+
+  return llvm::None;
+}
+
+// Imported files are also parsed with it
+[[nodiscard]] static parse::ParserKind getParserKind(const Context& ctx)
+{
+  return ctx.x3_parser ? parse::ParserKind::x3
+                       : parse::ParserKind::recursive_descent;
+}
+
+[[nodiscard]] static std::optional<jit::BenchmarkOptions>
+getBenchmarkOptions(const Context& ctx)
+{
+  if (!ctx.bench)
+    return std::nullopt;
+
+  return jit::BenchmarkOptions{*ctx.bench,
+                               ctx.bench_iterations,
+                               ctx.bench_warmup,
+                               ctx.bench_counters};
+}
+
+[[nodiscard]] static std::string
+findProfileRuntime(const Context& ctx, const std::string_view argv_front)
+{
+  if (ctx.profile_runtime) {
+    if (!std::filesystem::exists(*ctx.profile_runtime)) {
+      throw FileError{formatError(
+        argv_front,
+        fmt::format("{}: No such file or directory", *ctx.profile_runtime))};
+    }
+
+    return *ctx.profile_runtime;
+  }
+
+  const llvm::Triple triple{ctx.target_triple
+                              ? *ctx.target_triple
+                              : llvm::sys::getDefaultTargetTriple()};
+
+  // The resource directory of clang is named after the full version in older
+  // releases and after the major version in newer ones
+  const std::filesystem::path llvm_library_dir = TWINKLE_LLVM_LIBRARY_DIR;
+
+  for (const auto& version :
+       {std::string{LLVM_VERSION_STRING},
+        std::to_string(LLVM_VERSION_MAJOR)}) {
+    const auto resource_dir = llvm_library_dir / "clang" / version / "lib";
+
+    for (const auto& path :
+         {resource_dir / "linux"
+            / fmt::format("libclang_rt.profile-{}.a",
+                          triple.getArchName().str()),
+          resource_dir / triple.str() / "libclang_rt.profile.a"}) {
+      if (std::filesystem::exists(path))
+        return path.string();
+    }
+  }
+
+  throw ErrorBase{formatError(
+    argv_front,
+    "could not find the profile runtime (libclang_rt.profile), specify it "
+    "with --profile-runtime")};
+}
+
+[[nodiscard]] static std::vector<std::string>
+getLinkerOptions(const Context& ctx, const std::string_view argv_front)
+{
+  if (!ctx.profile_generate)
+    return {};
+
+  // Instrumented code does not refer to the runtime by itself on Linux
+  return {"-u__llvm_profile_runtime", findProfileRuntime(ctx, argv_front)};
+}
+
+// Returns the key that covers everything the outputs of the file depend on,
+// except the imported files
+[[nodiscard]] static std::string
+createSourceKey(const Context&         ctx,
+                const TargetCPU&       target_cpu,
+                const std::string&     path,
+                const std::string_view source)
+{
+  // The same file may be named differently, e.g. from another working
+  // directory
+  std::error_code ec;
+  const auto      canonical_path = std::filesystem::canonical(path, ec);
+
+  cache::Hasher hasher;
+
+  hasher.add(getVersion())
+    .add(ctx.emit_target)
+    .add(std::to_string(ctx.opt_level))
+    .add(ctx.relocation_model)
+    .add(ctx.target_triple ? *ctx.target_triple
+                           : llvm::sys::getDefaultTargetTriple())
+    .add(target_cpu.name)
+    .add(target_cpu.features)
+    .add(ctx.profile_generate ? "profile-generate" : "")
+    .add(ctx.profile_use ? cache::hashFile(*ctx.profile_use).value_or("") : "")
+    .add(ec ? path : canonical_path.string())
+    .add(source);
+
+  return hasher.finalize();
+}
+
+// Copies the cached outputs to where the code generator would create them
+// Returns std::nullopt if they could not be copied
+[[nodiscard]] static std::optional<FilePaths>
+restoreOutputs(const std::vector<std::filesystem::path>& cached_outputs,
+               const std::string&                        path,
+               const std::string&                        target)
+{
+  static const std::unordered_map<std::string, std::string> extension_map = {
+    {   EMIT_EXE_ARG,  "o"},
+    {   EMIT_OBJ_ARG,  "o"},
+    {   EMIT_ASM_ARG,  "s"},
+    {EMIT_LLVMIR_ARG, "ll"},
+  };
+
+  FilePaths outputs;
+
+  for (const auto& r : cached_outputs) {
+    const auto output
+      = (target == EMIT_EXE_ARG ? createTemporaryFilepath()
+                                : std::filesystem::path{path}.stem().string())
+        + "." + extension_map.at(target);
+
+    std::error_code ec;
+    std::filesystem::copy_file(
+      r,
+      output,
+      std::filesystem::copy_options::overwrite_existing,
+      ec);
+
+    if (ec)
+      return std::nullopt;
+
+    outputs.push_back(output);
+  }
+
+  return outputs;
+}
+
+// Interfaces need only the parse results, so no code is generated
+// Returns the created file paths
+[[nodiscard]] static FilePaths emitInterfaces(const Context&         ctx,
+                                              const std::string_view argv_front)
+{
+  const auto num_files = ctx.input_files.size();
+
+  FilePaths created_files(num_files);
+
+  parallelFor(num_files, ctx.jobs, [&](const std::size_t idx) {
+    const auto& path = ctx.input_files[idx];
+
+    // Syntax errors are buffered so that the output of each file is not
+    // interleaved with the others
+    std::ostringstream diagnostics;
+
+    try {
+      const auto result = parse::Parser{loadFile(argv_front, path),
+                                        path,
+                                        getParserKind(ctx),
+                                        diagnostics}
+                            .getResult();
+
+      created_files[idx] = parse::getInterfacePath(path);
+
+      parse::writeInterface(result, created_files[idx], argv_front);
+    }
+    catch (const parse::ParseError& err) {
+      throw parse::ParseError{diagnostics.str() + err.what()};
+    }
+  });
+
+  return created_files;
+}
+
 std::optional<CompileResult> compile(const Context&         ctx,
                                      const std::string_view argv_front)
+{
+  return compile(ctx, argv_front, parse::ImportCache::getInstance());
+}
+
+static void
+writeClassTemplateStatistics(std::ostream&                           ostm,
+                             const codegen::ClassTemplateStatistics& statistics)
+{
+  fmt::print(ostm,
+             "class template instantiations  {}\n"
+             "lookups                        {}\n"
+             "hits                           {}\n"
+             "hit rate                       {:.2f} %\n",
+             statistics.instantiations,
+             statistics.lookups,
+             statistics.hits,
+             statistics.lookups
+               ? 100.0 * statistics.hits / statistics.lookups
+               : 0.0);
+}
+
+std::optional<CompileResult>
+compile(const Context&                             ctx,
+        const std::string_view                     argv_front,
+        const std::shared_ptr<parse::ImportCache>& import_cache)
 try {
+  const llvm::TimeTraceScope time_trace_scope{"Compile"};
+
+  if (!ctx.jit && ctx.emit_target == EMIT_EXE_ARG)
+    verifyLinker(ctx.linker, argv_front);
+
+  // Find the runtime before emitting so that no files are left on error
+  auto linker_options = !ctx.jit && ctx.emit_target == EMIT_EXE_ARG
+                        ? getLinkerOptions(ctx, argv_front)
+                        : std::vector<std::string>{};
+
+  if (!ctx.jit && ctx.emit_target == EMIT_INTERFACE_ARG)
+    return AOTResult{emitInterfaces(ctx, argv_front)};
+
+  const auto target_cpu  = resolveTargetCPU(ctx.cpu, ctx.cpu_features);
+  const auto pgo_options = getPGOOptions(ctx, argv_front);
+
+  // Linked modules of LTO do not correspond to a single file, so they are not
+  // cached
+  // The JIT caches the objects of modules instead of the outputs of files
+  std::optional<cache::Cache> cache;
+  if (ctx.cache_dir && !ctx.lto)
+    cache.emplace(*ctx.cache_dir, ctx.cache_max_size);
+
+  const auto num_files = ctx.input_files.size();
+
+  std::vector<std::optional<parse::Parser::Result>> parsed(num_files);
+  std::vector<std::string>                          source_keys(num_files);
+
+  // Outputs of the files found in the cache
+  std::vector<std::optional<FilePaths>> restored(num_files);
+
+  parallelFor(num_files, ctx.jobs, [&](const std::size_t idx) {
+    const auto& path = ctx.input_files[idx];
+
+    auto source = loadFile(argv_front, path);
+
+    if (cache && !ctx.jit) {
+      source_keys[idx]
+        = createSourceKey(ctx, target_cpu, path, source->getText());
+
+      if (const auto cached_outputs = cache->lookup(source_keys[idx])) {
+        restored[idx]
+          = restoreOutputs(*cached_outputs, path, ctx.emit_target);
+
+        if (restored[idx])
+          return;
+      }
+    }
+
+    // Syntax errors are buffered so that the output of each file is not
+    // interleaved with the others
+    std::ostringstream diagnostics;
+
+    try {
+      parsed[idx] = parse::Parser{std::move(source),
+                                  path,
+                                  getParserKind(ctx),
+                                  diagnostics}
+                      .getResult();
+    }
+    catch (const parse::ParseError& err) {
+      throw parse::ParseError{diagnostics.str() + err.what()};
+    }
+  });
+
+  // Keep the order of the input files
   std::vector<parse::Parser::Result> parse_results;
+  std::vector<std::size_t>           parsed_indices;
 
-  for (const auto& path : ctx.input_files) {
-    parse_results.emplace_back(
-      parse::Parser{loadFile(argv_front, path), path}.getResult());
+  for (std::size_t idx = 0; idx < num_files; ++idx) {
+    if (parsed[idx]) {
+      parse_results.push_back(std::move(*parsed[idx]));
+      parsed_indices.push_back(idx);
+    }
   }
 
-  codegen::CodeGenerator code_generator{
-    argv_front,
-    std::move(parse_results),
-    ctx.opt_level,
-    getRelocationModel(ctx.relocation_model, argv_front),
-    ctx.target_triple,
-    ctx.jit};
+  ModuleFilePaths created_files(num_files);
+
+  if (!parse_results.empty()) {
+    codegen::CodeGenerator code_generator{
+      argv_front,
+      std::move(parse_results),
+      ctx.opt_level,
+      ctx.lto,
+      pgo_options,
+      getRelocationModel(ctx.relocation_model, argv_front),
+      ctx.target_triple,
+      target_cpu,
+      ctx.jit,
+      ctx.jobs,
+      getParserKind(ctx),
+      import_cache};
 
-  if (ctx.jit)
-    return JITResult{code_generator.doJIT()};
-  else
-    return AOTResult{emitFile(code_generator, ctx.emit_target)};
+    if (ctx.template_stats) {
+      writeClassTemplateStatistics(std::cerr,
+                                   code_generator.getClassTemplateStatistics());
+    }
 
-  unreachable();
+    if (ctx.jit) {
+      const auto exit_status = code_generator.doJIT(
+        cache ? &*cache : nullptr,
+        {ctx.jit_tier_threshold, ctx.jit_print_tier_up},
+        ctx.jit_threads,
+        {ctx.jit_perf, ctx.jit_gdb},
+        getBenchmarkOptions(ctx));
+
+      if (cache)
+        cache->flush();
+
+      return JITResult{exit_status};
+    }
+
+    auto emitted_files = emitFile(code_generator, ctx.emit_target);
+
+    if (ctx.lto) {
+      // All modules have been linked into one
+      assert(emitted_files.size() == 1);
+      created_files.front() = std::move(emitted_files.front());
+    }
+    else {
+      assert(emitted_files.size() == parsed_indices.size());
+
+      const auto imported_files = code_generator.getImportedFiles();
+
+      for (std::size_t idx = 0; idx < parsed_indices.size(); ++idx) {
+        const auto file_idx = parsed_indices[idx];
+
+        if (cache) {
+          cache->store(source_keys[file_idx],
+                       imported_files[idx],
+                       emitted_files[idx]);
+        }
+
+        created_files[file_idx] = std::move(emitted_files[idx]);
+      }
+    }
+  }
+
+  for (std::size_t idx = 0; idx < num_files; ++idx) {
+    if (restored[idx])
+      created_files[idx] = std::move(*restored[idx]);
+  }
+
+  if (cache)
+    cache->flush();
+
+  FilePaths flattened;
+
+  for (auto&& r : created_files)
+    flattened.insert(flattened.end(), r.begin(), r.end());
+
+  return AOTResult{std::move(flattened), std::move(linker_options)};
 }
 catch (const ErrorBase& err) {
   std::cerr << err.what() << (isBackNewline(err.what()) ? "" : "\n")
@@ -84,4 +461,42 @@ catch (const ErrorBase& err) {
   return std::nullopt;
 }
 
+void writeCacheStatistics(std::ostream&                ostm,
+                          const std::filesystem::path& cache_dir,
+                          const std::uintmax_t         max_size)
+{
+  const auto statistics = cache::Cache::readStatistics(cache_dir);
+
+  const auto lookups = statistics.hits + statistics.misses;
+
+  fmt::print(ostm,
+             "cache directory  {}\n"
+             "hits             {}\n"
+             "misses           {}\n"
+             "hit rate         {:.2f} %\n"
+             "stored           {}\n"
+             "evicted          {}\n"
+             "cache size       {:.1f} / {:.1f} MiB\n",
+             cache_dir.string(),
+             statistics.hits,
+             statistics.misses,
+             lookups ? 100.0 * statistics.hits / lookups : 0.0,
+             statistics.stored,
+             statistics.evicted,
+             statistics.size / 1024.0 / 1024.0,
+             max_size / 1024.0 / 1024.0);
+}
+
+[[nodiscard]] bool clearCache(const std::filesystem::path& cache_dir)
+try {
+  cache::Cache::clear(cache_dir);
+  return true;
+}
+catch (const ErrorBase& err) {
+  std::cerr << err.what() << (isBackNewline(err.what()) ? "" : "\n")
+            << std::flush;
+
+  return false;
+}
+
 } // namespace twinkle
@@ -0,0 +1,142 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twinkle/engine/c_api.h>
+#include <twinkle/engine/engine.hpp>
+#include <optional>
+#include <string>
+
+struct twinkle_engine {
+  std::unique_ptr<twinkle::Engine> engine;
+};
+
+// Exceptions do not cross the C interface, so the functions that can throw
+// catch them and return their errors
+
+// Reasons why the last twinkle_engine_create on the thread failed
+static thread_local std::optional<std::string> create_error;
+
+void twinkle_engine_options_init(twinkle_engine_options* const options)
+{
+  const twinkle::EngineOptions defaults;
+
+  options->opt_level    = defaults.opt_level;
+  options->cpu          = nullptr;
+  options->cpu_features = nullptr;
+  options->jit_threads  = defaults.jit_threads;
+}
+
+twinkle_engine* twinkle_engine_create(const twinkle_engine_options* options)
+try {
+  create_error.reset();
+
+  twinkle::EngineOptions engine_options;
+
+  if (options) {
+    engine_options.opt_level   = options->opt_level;
+    engine_options.jit_threads = options->jit_threads;
+
+    if (options->cpu)
+      engine_options.cpu = options->cpu;
+    if (options->cpu_features)
+      engine_options.cpu_features = options->cpu_features;
+  }
+
+  std::vector<twinkle::Diagnostic> diagnostics;
+
+  auto engine = twinkle::Engine::create(engine_options, diagnostics);
+
+  if (!engine) {
+    std::string reasons;
+
+    for (const auto& r : diagnostics)
+      reasons += (reasons.empty() ? "" : "\n") + r.message;
+
+    create_error = std::move(reasons);
+    return nullptr;
+  }
+
+  return new twinkle_engine{std::move(engine)};
+}
+catch (const std::exception& err) {
+  create_error = err.what();
+  return nullptr;
+}
+catch (...) {
+  create_error = "unknown error";
+  return nullptr;
+}
+
+const char* twinkle_engine_create_error(void)
+{
+  return create_error ? create_error->c_str() : nullptr;
+}
+
+void twinkle_engine_destroy(twinkle_engine* const engine)
+{
+  delete engine;
+}
+
+int twinkle_engine_add_module(twinkle_engine* const engine,
+                              const char* const     name,
+                              const char* const     source,
+                              const size_t          source_size,
+                              twinkle_module* const module)
+try {
+  const auto handle
+    = engine->engine->addModule(name, std::string{source, source_size});
+
+  if (!handle)
+    return 1;
+
+  *module = *handle;
+
+  return 0;
+}
+catch (...) {
+  return 1;
+}
+
+int twinkle_engine_remove_module(twinkle_engine* const engine,
+                                 const twinkle_module  module)
+try {
+  return engine->engine->removeModule(module) ? 0 : 1;
+}
+catch (...) {
+  return 1;
+}
+
+void* twinkle_engine_lookup(twinkle_engine* const engine,
+                            const char* const     name)
+try {
+  return engine->engine->lookupAddress(name);
+}
+catch (...) {
+  return nullptr;
+}
+
+size_t twinkle_engine_diagnostic_count(const twinkle_engine* const engine)
+{
+  return engine->engine->getDiagnostics().size();
+}
+
+twinkle_diagnostic
+twinkle_engine_diagnostic(const twinkle_engine* const engine,
+                          const size_t                index)
+{
+  const auto& diagnostics = engine->engine->getDiagnostics();
+
+  if (index >= diagnostics.size())
+    return {nullptr, 0, 0, nullptr};
+
+  const auto& diagnostic = diagnostics[index];
+
+  return {diagnostic.file.c_str(),
+          diagnostic.line,
+          diagnostic.column,
+          diagnostic.message.c_str()};
+}
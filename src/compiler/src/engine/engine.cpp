@@ -0,0 +1,266 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twinkle/engine/engine.hpp>
+#include <twinkle/codegen/codegen.hpp>
+#include <twinkle/jit/jit.hpp>
+#include <twinkle/parse/parser.hpp>
+#include <twinkle/parse/import_cache.hpp>
+#include <twinkle/support/exception.hpp>
+#include <twinkle/support/parallel.hpp>
+#include <twinkle/support/target.hpp>
+#include <regex>
+
+namespace twinkle
+{
+
+// Used in place of the program name in errors that are not in source files
+constexpr std::string_view engine_name = "twinkle";
+
+struct Engine::Impl {
+  struct Module {
+    // Frees the code of the module
+    llvm::orc::ResourceTrackerSP resource_tracker;
+
+    // Symbols that can be looked up
+    std::vector<std::string> functions;
+  };
+
+  Impl(const unsigned int                opt_level,
+       const parse::ParserKind           parser_kind,
+       TargetCPU&&                       target_cpu,
+       std::unique_ptr<jit::JitCompiler> jit)
+    : opt_level{opt_level}
+    , parser_kind{parser_kind}
+    , target_cpu{std::move(target_cpu)}
+    , jit{std::move(jit)}
+  {
+  }
+
+  const unsigned int opt_level;
+
+  const parse::ParserKind parser_kind;
+
+  const TargetCPU target_cpu;
+
+  // Declared before the modules, as their trackers refer to the session
+  const std::unique_ptr<jit::JitCompiler> jit;
+
+  // Files imported by several modules are parsed once
+  const std::shared_ptr<parse::ImportCache> import_cache
+    = parse::ImportCache::getInstance();
+
+  std::unordered_map<ModuleHandle, Module> modules;
+
+  ModuleHandle next_handle = 0;
+
+  std::vector<Diagnostic> diagnostics;
+
+  // Returns the symbol of the function that 'name' refers to
+  [[nodiscard]] std::optional<std::string>
+  findFunction(const std::string& name);
+};
+
+[[nodiscard]] std::optional<std::string>
+Engine::Impl::findFunction(const std::string& name)
+{
+  // Functions of the global namespace begin with it, followed by the types of
+  // their parameters
+  const auto prefix
+    = fmt::format("{}{}{}E", codegen::mangle::prefix, name.length(), name);
+
+  std::vector<std::string> candidates;
+
+  for (const auto& [handle, module] : modules) {
+    for (const auto& symbol : module.functions) {
+      if (symbol == name)
+        return symbol;
+
+      if (symbol.starts_with(prefix))
+        candidates.push_back(symbol);
+    }
+  }
+
+  if (candidates.size() == 1)
+    return candidates.front();
+
+  diagnostics.push_back(
+    {{},
+     0,
+     0,
+     candidates.empty()
+       ? fmt::format("function '{}' could not be found", name)
+       : fmt::format("function '{}' is overloaded, so it must be looked up by "
+                     "its symbol",
+                     name)});
+
+  return std::nullopt;
+}
+
+// Errors that are not in source files only have the text for the terminal
+[[nodiscard]] static Diagnostic toDiagnostic(const ErrorBase&   err,
+                                             const std::string& file)
+{
+  if (const auto& diagnostic = err.getDiagnostic())
+    return *diagnostic;
+
+  static const std::regex color{"\x1b\\[[0-9;]*m"};
+
+  auto message = std::regex_replace(std::string{err.what()}, color, "");
+
+  // Drops the name in front of the error
+  if (const auto pos = message.find("error: "); pos != std::string::npos)
+    message.erase(0, pos + std::string_view{"error: "}.length());
+
+  return {file, 0, 0, std::move(message)};
+}
+
+[[nodiscard]] std::unique_ptr<Engine>
+Engine::create(const EngineOptions&     options,
+               std::vector<Diagnostic>& diagnostics)
+{
+  if (options.opt_level > 3) {
+    diagnostics.push_back({{}, 0, 0, "invalid optimization level"});
+    return nullptr;
+  }
+
+  initializeTargets();
+
+  auto target_cpu = resolveTargetCPU(options.cpu, options.cpu_features);
+
+  // Code tiered up cannot be removed with its module, so tiering is disabled
+  auto jit = jit::JitCompiler::create(target_cpu,
+                                      getCodeGenOptLevel(options.opt_level),
+                                      nullptr,
+                                      {0, false},
+                                      resolveJobs(options.jit_threads),
+                                      {false, false});
+
+  if (auto err = jit.takeError()) {
+    diagnostics.push_back({{}, 0, 0, llvm::toString(std::move(err))});
+    return nullptr;
+  }
+
+  const auto parser_kind = options.x3_parser
+                             ? parse::ParserKind::x3
+                             : parse::ParserKind::recursive_descent;
+
+  return std::unique_ptr<Engine>{
+    new Engine{std::make_unique<Impl>(options.opt_level,
+                                      parser_kind,
+                                      std::move(target_cpu),
+                                      std::move(*jit))}};
+}
+
+Engine::Engine(std::unique_ptr<Impl> impl)
+  : impl{std::move(impl)}
+{
+}
+
+Engine::~Engine() = default;
+
+[[nodiscard]] std::optional<ModuleHandle>
+Engine::addModule(const std::string& name, std::string source)
+try {
+  impl->diagnostics.clear();
+
+  // Syntax errors are returned as diagnostics instead
+  std::ostringstream syntax_errors;
+
+  std::vector<parse::Parser::Result> parse_results;
+  parse_results.push_back(
+    parse::Parser{std::move(source), name, impl->parser_kind, syntax_errors}
+      .getResult());
+
+  codegen::CodeGenerator generator{engine_name,
+                                   std::move(parse_results),
+                                   impl->opt_level,
+                                   false,
+                                   llvm::None,
+                                   llvm::Reloc::PIC_,
+                                   std::nullopt,
+                                   impl->target_cpu,
+                                   true,
+                                   1,
+                                   impl->parser_kind,
+                                   impl->import_cache};
+
+  auto functions = generator.getExternalFunctions();
+
+  auto resource_tracker
+    = impl->jit->getMainJitDylib().createResourceTracker();
+
+  generator.addToJIT(*impl->jit, resource_tracker);
+
+  const auto handle = impl->next_handle++;
+
+  impl->modules.emplace(
+    handle,
+    Impl::Module{std::move(resource_tracker), std::move(functions)});
+
+  return handle;
+}
+catch (const ErrorBase& err) {
+  impl->diagnostics.push_back(toDiagnostic(err, name));
+  return std::nullopt;
+}
+catch (const std::exception& err) {
+  impl->diagnostics.push_back({name, 0, 0, err.what()});
+  return std::nullopt;
+}
+
+bool Engine::removeModule(const ModuleHandle module)
+{
+  impl->diagnostics.clear();
+
+  const auto it = impl->modules.find(module);
+
+  if (it == impl->modules.end()) {
+    impl->diagnostics.push_back(
+      {{}, 0, 0, fmt::format("module {} does not exist", module)});
+    return false;
+  }
+
+  auto err = it->second.resource_tracker->remove();
+
+  impl->modules.erase(it);
+
+  if (err) {
+    impl->diagnostics.push_back({{}, 0, 0, llvm::toString(std::move(err))});
+    return false;
+  }
+
+  return true;
+}
+
+[[nodiscard]] void* Engine::lookupAddress(const std::string& name)
+{
+  impl->diagnostics.clear();
+
+  const auto symbol = impl->findFunction(name);
+
+  if (!symbol)
+    return nullptr;
+
+  auto address = impl->jit->lookup(*symbol);
+
+  if (auto err = address.takeError()) {
+    impl->diagnostics.push_back({{}, 0, 0, llvm::toString(std::move(err))});
+    return nullptr;
+  }
+
+  return reinterpret_cast<void*>(
+    static_cast<std::uintptr_t>(address->getAddress()));
+}
+
+[[nodiscard]] const std::vector<Diagnostic>&
+Engine::getDiagnostics() const noexcept
+{
+  return impl->diagnostics;
+}
+
+} // namespace twinkle
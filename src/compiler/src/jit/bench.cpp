@@ -0,0 +1,258 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twinkle/pch/pch.hpp>
+#include <twinkle/jit/bench.hpp>
+#include <twinkle/support/utils.hpp>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace twinkle::jit
+{
+
+struct CounterValues {
+  std::uint64_t cycles;
+  std::uint64_t instructions;
+};
+
+// Counts the cycles and instructions of the calling thread in user space
+struct HardwareCounters : private boost::noncopyable {
+  HardwareCounters();
+
+  ~HardwareCounters();
+
+  // The counters may be unsupported, or forbidden by perf_event_paranoid
+  [[nodiscard]] bool isAvailable() const noexcept
+  {
+    return instructions_fd != -1;
+  }
+
+  // Returns std::nullopt if the counters could not be read
+  [[nodiscard]] std::optional<CounterValues> read() const;
+
+private:
+  // Leader of the group, so both are read at once
+  int cycles_fd = -1;
+
+  int instructions_fd = -1;
+};
+
+#if defined(__linux__)
+
+[[nodiscard]] static int openCounter(const std::uint64_t config,
+                                     const int           group_fd)
+{
+  perf_event_attr attr{};
+
+  attr.type           = PERF_TYPE_HARDWARE;
+  attr.size           = sizeof attr;
+  attr.config         = config;
+  attr.disabled       = group_fd == -1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv     = 1;
+  attr.read_format    = PERF_FORMAT_GROUP;
+
+  return static_cast<int>(
+    syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0));
+}
+
+HardwareCounters::HardwareCounters()
+{
+  cycles_fd = openCounter(PERF_COUNT_HW_CPU_CYCLES, -1);
+  if (cycles_fd == -1)
+    return;
+
+  instructions_fd = openCounter(PERF_COUNT_HW_INSTRUCTIONS, cycles_fd);
+  if (instructions_fd == -1)
+    return;
+
+  ioctl(cycles_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+HardwareCounters::~HardwareCounters()
+{
+  if (instructions_fd != -1)
+    close(instructions_fd);
+  if (cycles_fd != -1)
+    close(cycles_fd);
+}
+
+[[nodiscard]] std::optional<CounterValues> HardwareCounters::read() const
+{
+  assert(isAvailable());
+
+  // Layout of PERF_FORMAT_GROUP
+  struct {
+    std::uint64_t nr;
+    std::uint64_t values[2];
+  } group;
+
+  if (::read(cycles_fd, &group, sizeof group) != sizeof group)
+    return std::nullopt;
+
+  return CounterValues{group.values[0], group.values[1]};
+}
+
+#else
+
+HardwareCounters::HardwareCounters()
+{
+}
+
+HardwareCounters::~HardwareCounters()
+{
+}
+
+[[nodiscard]] std::optional<CounterValues> HardwareCounters::read() const
+{
+  unreachable();
+}
+
+#endif
+
+// Sorts 'values'
+[[nodiscard]] static double calcMedian(std::vector<double>& values)
+{
+  std::sort(values.begin(), values.end());
+
+  const auto mid = values.size() / 2;
+
+  return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+}
+
+[[nodiscard]] static std::string formatDuration(const double ns)
+{
+  if (ns < 1e3)
+    return fmt::format("{:.1f} ns", ns);
+  if (ns < 1e6)
+    return fmt::format("{:.3f} us", ns / 1e3);
+  if (ns < 1e9)
+    return fmt::format("{:.3f} ms", ns / 1e6);
+
+  return fmt::format("{:.3f} s", ns / 1e9);
+}
+
+void runBenchmark(const BenchmarkedFunction   func,
+                  const BenchmarkOptions&      options,
+                  const std::function<void()>& after_warmup,
+                  std::ostream&                ostm,
+                  const std::string_view       argv_front)
+{
+  assert(options.iterations);
+
+  for (std::uint64_t i = 0; i < options.warmup; ++i)
+    func();
+
+  after_warmup();
+
+  std::optional<HardwareCounters> counters;
+
+  if (options.counters) {
+    counters.emplace();
+
+    if (!counters->isAvailable()) {
+      std::cerr << formatError(argv_front,
+                               "hardware counters are not available, so only "
+                               "durations are measured\n")
+                << std::flush;
+
+      counters.reset();
+    }
+  }
+
+  // In nanoseconds
+  std::vector<double> durations(options.iterations);
+
+  std::vector<double> cycles;
+  std::vector<double> instructions;
+
+  if (counters) {
+    cycles.resize(options.iterations);
+    instructions.resize(options.iterations);
+  }
+
+  for (std::uint64_t i = 0; i < options.iterations; ++i) {
+    const auto counters_start
+      = counters ? counters->read() : std::optional<CounterValues>{};
+    const auto start = std::chrono::steady_clock::now();
+
+    func();
+
+    const auto end = std::chrono::steady_clock::now();
+    const auto counters_end
+      = counters ? counters->read() : std::optional<CounterValues>{};
+
+    durations[i]
+      = std::chrono::duration<double, std::nano>{end - start}.count();
+
+    if (!counters)
+      continue;
+
+    if (!counters_start || !counters_end) {
+      std::cerr << formatError(argv_front,
+                               "hardware counters could not be read, so only "
+                               "durations are measured\n")
+                << std::flush;
+
+      counters.reset();
+      continue;
+    }
+
+    cycles[i]       = counters_end->cycles - counters_start->cycles;
+    instructions[i] = counters_end->instructions - counters_start->instructions;
+  }
+
+  const auto mean
+    = std::accumulate(durations.begin(), durations.end(), 0.0)
+      / durations.size();
+
+  const auto median = calcMedian(durations);
+
+  // Nearest rank
+  const auto p99 = durations[static_cast<std::size_t>(
+    std::ceil(0.99 * durations.size()) - 1)];
+
+  // Flush the output of the benchmarked function first
+  std::fflush(stdout);
+
+  ostm << fmt::format("{}: {} iterations, {} warmup\n",
+                      options.symbol,
+                      options.iterations,
+                      options.warmup)
+       << fmt::format("  min:     {}\n", formatDuration(durations.front()))
+       << fmt::format("  median:  {}\n", formatDuration(median))
+       << fmt::format("  p99:     {}\n", formatDuration(p99))
+       << fmt::format("  mean:    {}\n", formatDuration(mean));
+
+  if (counters) {
+    const auto total_cycles
+      = std::accumulate(cycles.begin(), cycles.end(), 0.0);
+    const auto total_instructions
+      = std::accumulate(instructions.begin(), instructions.end(), 0.0);
+
+    ostm << fmt::format("  cycles:       {:.0f} (median)\n",
+                        calcMedian(cycles))
+         << fmt::format("  instructions: {:.0f} (median)\n",
+                        calcMedian(instructions))
+         << fmt::format("  IPC:          {:.2f}\n",
+                        total_cycles ? total_instructions / total_cycles : 0.0);
+  }
+  else if (options.counters)
+    ostm << "  counters:     unavailable\n";
+
+  ostm << std::flush;
+}
+
+} // namespace twinkle::jit
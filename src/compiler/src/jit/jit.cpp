@@ -7,58 +7,215 @@
 
 #include <twinkle/jit/jit.hpp>
 #include <twinkle/support/utils.hpp>
+#include <twinkle/support/time_trace.hpp>
+#include <twinkle/jit/perf_plugin.hpp>
+#include <llvm/ExecutionEngine/JITLink/EHFrameSupport.h>
+#include <llvm/ExecutionEngine/Orc/DebugObjectManagerPlugin.h>
+#include <llvm/ExecutionEngine/Orc/EPCDebugObjectRegistrar.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/xxhash.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <chrono>
 
 namespace twinkle::jit
 {
 
+// Symbols that instrumented functions refer to
+constexpr std::string_view tier_up_hook_symbol     = "__twinkle_jit_tier_up";
+constexpr std::string_view jit_compiler_symbol     = "__twinkle_jit_compiler";
+constexpr std::string_view baseline_symbol_suffix  = ".tier0";
+constexpr std::string_view optimized_symbol_suffix = ".tier1";
+
+// Traces the compilation of each module by the compiler it wraps
+struct TimeTracedIRCompiler : public llvm::orc::IRCompileLayer::IRCompiler {
+  explicit TimeTracedIRCompiler(std::unique_ptr<IRCompiler> compiler)
+    : IRCompiler{compiler->getManglingOptions()}
+    , compiler{std::move(compiler)}
+  {
+  }
+
+  [[nodiscard]] llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>>
+  operator()(llvm::Module& module) override
+  {
+    const llvm::TimeTraceScope time_trace_scope{"JIT compile",
+                                                module.getName()};
+
+    return (*compiler)(module);
+  }
+
+private:
+  std::unique_ptr<IRCompiler> compiler;
+};
+
 JitCompiler::JitCompiler(
   std::unique_ptr<llvm::orc::ExecutionSession>    exec_session,
   std::unique_ptr<llvm::orc::EPCIndirectionUtils> epciu,
   llvm::orc::JITTargetMachineBuilder              jit_tmb,
-  llvm::DataLayout                                data_layout)
+  llvm::orc::JITTargetMachineBuilder              optimized_jit_tmb,
+  llvm::DataLayout                                data_layout,
+  std::unique_ptr<ObjectCache>                    object_cache,
+  std::unique_ptr<ObjectCache>                    optimized_object_cache,
+  const TieringOptions&                           tiering,
+  std::vector<std::unique_ptr<llvm::orc::ObjectLinkingLayer::Plugin>>
+    object_layer_plugins)
   : exec_session{std::move(exec_session)}
   , epciu{std::move(epciu)}
   , data_layout{std::move(data_layout)}
   , mangle{*this->exec_session, this->data_layout}
-  , object_layer{*this->exec_session,
-                 []() {
-                   return std::make_unique<llvm::SectionMemoryManager>();
-                 }}
+  , object_cache{std::move(object_cache)}
+  , optimized_object_cache{std::move(optimized_object_cache)}
+  , tiering{tiering}
+  , object_layer{*this->exec_session}
   , compile_layer{*this->exec_session,
                   object_layer,
-                  std::make_unique<llvm::orc::ConcurrentIRCompiler>(
-                    std::move(jit_tmb))}
-  , optimize_layer(*this->exec_session, compile_layer, optimizeModule)
+                  std::make_unique<TimeTracedIRCompiler>(
+                    std::make_unique<llvm::orc::ConcurrentIRCompiler>(
+                      std::move(jit_tmb),
+                      this->object_cache.get()))}
+  , optimize_layer{*this->exec_session,
+                   compile_layer,
+                   [this](llvm::orc::ThreadSafeModule                     tsm,
+                          const llvm::orc::MaterializationResponsibility& r)
+                     -> llvm::Expected<llvm::orc::ThreadSafeModule> {
+                     if (this->tiering.threshold)
+                       return instrumentModule(std::move(tsm), r);
+                     return optimizeModule(std::move(tsm), r);
+                   }}
   , cod_layer{*this->exec_session,
               optimize_layer,
               this->epciu->getLazyCallThroughManager(),
               [this] {
                 return this->epciu->createIndirectStubsManager();
               }}
+  , optimized_jit_tmb{optimized_jit_tmb}
+  , optimized_compile_layer{*this->exec_session,
+                            object_layer,
+                            std::make_unique<TimeTracedIRCompiler>(
+                              std::make_unique<llvm::orc::ConcurrentIRCompiler>(
+                                std::move(optimized_jit_tmb),
+                                this->optimized_object_cache.get()))}
   , main_jd{this->exec_session->createBareJITDylib("<main>")}
+  , baseline_jd{this->exec_session->createBareJITDylib("<baseline>")}
+  , optimized_jd{this->exec_session->createBareJITDylib("<optimized>")}
 {
+  for (auto& r : object_layer_plugins)
+    object_layer.addPlugin(std::move(r));
+
   main_jd.addGenerator(llvm::cantFail(
     llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
       data_layout.getGlobalPrefix())));
+
+  if (!tiering.threshold)
+    return;
+
+  llvm::cantFail(main_jd.define(llvm::orc::absoluteSymbols({
+    {mangle(std::string{tier_up_hook_symbol}),
+     llvm::JITEvaluatedSymbol{
+       llvm::pointerToJITTargetAddress(&onThresholdReached),
+       llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable}},
+    {mangle(std::string{jit_compiler_symbol}),
+     llvm::JITEvaluatedSymbol{llvm::pointerToJITTargetAddress(this),
+                              llvm::JITSymbolFlags::Exported}},
+  })));
+
+  stubs_manager = this->epciu->createIndirectStubsManager();
+
+  // Functions are called through their stubs in the main dylib, and global
+  // variables are defined in the baseline dylib
+  baseline_jd.addToLinkOrder(main_jd);
+  optimized_jd.addToLinkOrder(main_jd);
+  optimized_jd.addToLinkOrder(baseline_jd);
+
+  tier_up_thread = std::thread{[this] {
+    runTierUpThread();
+  }};
 }
 
 JitCompiler::~JitCompiler()
 {
+  if (tier_up_thread.joinable()) {
+    {
+      std::lock_guard lock{tier_up_mutex};
+      tier_up_stopped = true;
+    }
+
+    tier_up_cv.notify_one();
+    tier_up_thread.join();
+  }
+
+  // Compilations in progress must finish before the dylibs are cleared
+  exec_session->getExecutorProcessControl().getDispatcher().shutdown();
+
   if (auto err = exec_session->endSession())
     exec_session->reportError(std::move(err));
   if (auto err = epciu->cleanup())
     exec_session->reportError(std::move(err));
 }
 
-[[nodiscard]] llvm::Expected<std::unique_ptr<JitCompiler>> JitCompiler::create()
+[[nodiscard]] static llvm::Expected<
+  std::vector<std::unique_ptr<llvm::orc::ObjectLinkingLayer::Plugin>>>
+createObjectLayerPlugins(llvm::orc::ExecutionSession& exec_session,
+                         const DebugOptions&          debug)
+{
+  std::vector<std::unique_ptr<llvm::orc::ObjectLinkingLayer::Plugin>> plugins;
+
+  // Lets the compiled code be unwound, as the memory manager of RuntimeDyld
+  // did
+  plugins.push_back(std::make_unique<llvm::orc::EHFrameRegistrationPlugin>(
+    exec_session,
+    std::make_unique<llvm::jitlink::InProcessEHFrameRegistrar>()));
+
+  if (debug.gdb) {
+    auto registrar = llvm::orc::createJITLoaderGDBRegistrar(exec_session);
+    if (!registrar)
+      return registrar.takeError();
+
+    plugins.push_back(std::make_unique<llvm::orc::DebugObjectManagerPlugin>(
+      exec_session,
+      std::move(*registrar)));
+  }
+
+  if (debug.perf) {
+    auto perf_plugin = PerfPlugin::create(
+      exec_session.getExecutorProcessControl().getTargetTriple());
+    if (!perf_plugin)
+      return perf_plugin.takeError();
+
+    plugins.push_back(std::move(*perf_plugin));
+  }
+
+  return std::move(plugins);
+}
+
+[[nodiscard]] llvm::Expected<std::unique_ptr<JitCompiler>>
+JitCompiler::create(const TargetCPU&              target_cpu,
+                    const llvm::CodeGenOpt::Level opt_level,
+                    cache::Cache*                 cache,
+                    const TieringOptions&         tiering,
+                    const unsigned int            num_threads,
+                    const DebugOptions&           debug)
 {
-  auto epc = llvm::orc::SelfExecutorProcessControl::Create();
+  auto epc = llvm::orc::SelfExecutorProcessControl::Create(
+    nullptr,
+    std::make_unique<TaskDispatcher>(num_threads));
   if (!epc)
     return epc.takeError();
 
   auto exec_session
     = std::make_unique<llvm::orc::ExecutionSession>(std::move(*epc));
 
+  // Materialization runs on the threads of the dispatcher instead of the
+  // thread that looks up the symbols
+  exec_session->setDispatchTask(
+    [&dispatcher = exec_session->getExecutorProcessControl().getDispatcher()](
+      std::unique_ptr<llvm::orc::Task> task) {
+      dispatcher.dispatch(std::move(task));
+    });
+
   auto epciu = llvm::orc::EPCIndirectionUtils::Create(
     exec_session->getExecutorProcessControl());
   if (!epciu)
@@ -74,31 +231,237 @@ JitCompiler::~JitCompiler()
   llvm::orc::JITTargetMachineBuilder jtmb(
     exec_session->getExecutorProcessControl().getTargetTriple());
 
+  // JITLink places code anywhere in the address space, and reaches other
+  // objects and the process through the GOT and PLT it creates
+  jtmb.setCPU(target_cpu.name)
+    .setFeatures(target_cpu.features)
+    .setRelocationModel(llvm::Reloc::PIC_)
+    .setCodeModel(llvm::CodeModel::Small);
+
+  auto optimized_jtmb = jtmb;
+  optimized_jtmb.setCodeGenOptLevel(llvm::CodeGenOpt::Aggressive);
+
+  // The first tier is compiled as fast as possible, which selects FastISel
+  const auto baseline_opt_level
+    = tiering.threshold ? llvm::CodeGenOpt::None : opt_level;
+
+  jtmb.setCodeGenOptLevel(baseline_opt_level);
+
   auto dl = jtmb.getDefaultDataLayoutForTarget();
   if (!dl)
     return dl.takeError();
 
+  auto object_layer_plugins = createObjectLayerPlugins(*exec_session, debug);
+  if (!object_layer_plugins)
+    return object_layer_plugins.takeError();
+
+  auto object_cache
+    = cache ? std::make_unique<ObjectCache>(*cache, jtmb, baseline_opt_level)
+            : nullptr;
+
+  auto optimized_object_cache
+    = cache ? std::make_unique<ObjectCache>(*cache,
+                                            optimized_jtmb,
+                                            llvm::CodeGenOpt::Aggressive)
+            : nullptr;
+
   return std::make_unique<JitCompiler>(std::move(exec_session),
                                        std::move(*epciu),
                                        std::move(jtmb),
-                                       std::move(*dl));
+                                       std::move(optimized_jtmb),
+                                       std::move(*dl),
+                                       std::move(object_cache),
+                                       std::move(optimized_object_cache),
+                                       tiering,
+                                       std::move(*object_layer_plugins));
+}
+
+// Local symbols are made visible to the optimized functions
+// Names are made unique with the module, as other modules may have local
+// symbols of the same names
+static void externalizeLocalSymbols(llvm::Module& module)
+{
+  const auto suffix
+    = fmt::format(".{:x}", llvm::xxHash64(module.getModuleIdentifier()));
+
+  for (auto& r : module.global_values()) {
+    if (!r.hasLocalLinkage() || r.isDeclaration())
+      continue;
+
+    r.setName((r.hasName() ? r.getName() : "anon") + suffix);
+    r.setLinkage(llvm::GlobalValue::ExternalLinkage);
+    r.setVisibility(llvm::GlobalValue::DefaultVisibility);
+  }
+}
+
+// Renames the functions defined in the module, so that every call, even in
+// the module, refers to their original names and goes through their stubs
+// Returns the stubs to create
+[[nodiscard]] static llvm::orc::SymbolAliasMap
+redirectCallsToStubs(llvm::Module&                 module,
+                     llvm::orc::MangleAndInterner& mangle)
+{
+  std::vector<llvm::Function*> definitions;
+
+  for (auto& r : module) {
+    if (!r.isDeclaration())
+      definitions.push_back(&r);
+  }
+
+  llvm::orc::SymbolAliasMap stubs;
+
+  for (auto const definition : definitions) {
+    const auto name = definition->getName().str();
+
+    definition->setName(name + std::string{baseline_symbol_suffix});
+
+    auto const declaration
+      = llvm::Function::Create(definition->getFunctionType(),
+                               llvm::GlobalValue::ExternalLinkage,
+                               name,
+                               module);
+
+    declaration->copyAttributesFrom(definition);
+    definition->replaceAllUsesWith(declaration);
+
+    stubs.try_emplace(
+      mangle(name),
+      mangle(definition->getName()),
+      llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable);
+  }
+
+  return stubs;
 }
 
 [[nodiscard]] llvm::Error
 JitCompiler::addModule(llvm::orc::ThreadSafeModule  thread_safe_module,
                        llvm::orc::ResourceTrackerSP resource_tracker)
 {
+  if (!tiering.threshold) {
+    // Each function is compiled on its own, so all of them are looked up
+    auto symbols = thread_safe_module.withModuleDo([this](llvm::Module& m) {
+      llvm::orc::SymbolLookupSet symbols;
+
+      // Weakly referenced, so that a symbol that is not emitted does not fail
+      // the lookup of the others
+      for (const auto& r : m) {
+        if (!r.isDeclaration() && !r.hasLocalLinkage()
+            && !r.hasAvailableExternallyLinkage())
+          symbols.add(mangle(r.getName()),
+                      llvm::orc::SymbolLookupFlags::WeaklyReferencedSymbol);
+      }
+
+      return symbols;
+    });
+
+    // Code split off by the compile on demand layer is not removed with the
+    // tracker, so modules that are removed are compiled as a whole
+    if (resource_tracker) {
+      if (auto err = optimize_layer.add(resource_tracker,
+                                        std::move(thread_safe_module)))
+        return err;
+
+      modules_to_compile.push_back({&main_jd, std::move(symbols), false});
+      return llvm::Error::success();
+    }
+
+    if (auto err = cod_layer.add(main_jd, std::move(thread_safe_module)))
+      return err;
+
+    modules_to_compile.push_back({&main_jd, std::move(symbols), true});
+
+    return llvm::Error::success();
+  }
+
   if (!resource_tracker)
     resource_tracker = main_jd.getDefaultResourceTracker();
 
-  return cod_layer.add(resource_tracker, std::move(thread_safe_module));
+  // The whole module is compiled when one of its functions is first called,
+  // since compiling each function on its own costs more without optimization
+  auto stubs = thread_safe_module.withModuleDo([this](llvm::Module& m) {
+    externalizeLocalSymbols(m);
+    return redirectCallsToStubs(m, mangle);
+  });
+
+  // Any symbol materializes the whole module
+  const auto first_symbol
+    = stubs.empty() ? nullptr : stubs.begin()->second.Aliasee;
+
+  if (auto err = optimize_layer.add(baseline_jd, std::move(thread_safe_module)))
+    return err;
+
+  if (auto err = main_jd.define(
+        llvm::orc::lazyReexports(epciu->getLazyCallThroughManager(),
+                                 *stubs_manager,
+                                 baseline_jd,
+                                 std::move(stubs)),
+        resource_tracker))
+    return err;
+
+  if (first_symbol) {
+    modules_to_compile.push_back(
+      {&baseline_jd, llvm::orc::SymbolLookupSet{first_symbol}, false});
+  }
+
+  return llvm::Error::success();
+}
+
+void JitCompiler::compileAddedModules()
+{
+  for (auto& r : modules_to_compile)
+    compileInBackground(std::move(r));
+
+  modules_to_compile.clear();
+}
+
+void JitCompiler::compileInBackground(ModuleToCompile module)
+{
+  auto const jd      = module.jd;
+  auto       symbols = module.symbols;
+
+  exec_session->lookup(
+    llvm::orc::LookupKind::Static,
+    llvm::orc::makeJITDylibSearchOrder(jd),
+    std::move(symbols),
+    llvm::orc::SymbolState::Ready,
+    [this, module = std::move(module)](
+      llvm::Expected<llvm::orc::SymbolMap> result) mutable {
+      // Failures are reported by the lookups that need the module
+      if (auto err = result.takeError()) {
+        llvm::consumeError(std::move(err));
+        return;
+      }
+
+      if (!module.on_demand)
+        return;
+
+      // The dylib of the layer is created when the stubs are materialized
+      auto const impl_jd
+        = exec_session->getJITDylibByName(module.jd->getName() + ".impl");
+
+      if (impl_jd)
+        compileInBackground({impl_jd, std::move(module.symbols), false});
+    },
+    llvm::orc::NoDependenciesToRegister);
 }
 
 [[nodiscard]] llvm::Expected<llvm::orc::ThreadSafeModule>
 JitCompiler::optimizeModule(llvm::orc::ThreadSafeModule tsm,
                             const llvm::orc::MaterializationResponsibility&)
 {
+  // Objects compiled by earlier runs are loaded without optimizing the module
+  // again, so it is looked up before it is optimized
+  const auto cached = object_cache && tsm.withModuleDo([this](llvm::Module& m) {
+    return object_cache->lookupBeforeTransform(m);
+  });
+
+  if (cached)
+    return std::move(tsm);
+
   tsm.withModuleDo([](llvm::Module& m) {
+    // Each function is traced by the pass manager
+    const llvm::TimeTraceScope time_trace_scope{"JIT optimize", m.getName()};
+
     // Create a function pass manager
     auto fpm = std::make_unique<llvm::legacy::FunctionPassManager>(&m);
 
@@ -122,4 +485,452 @@ JitCompiler::optimizeModule(llvm::orc::ThreadSafeModule tsm,
   return std::move(tsm);
 }
 
+// Returns the blocks where the execution of the function starts or loops
+[[nodiscard]] static std::vector<llvm::BasicBlock*>
+findCountedBlocks(llvm::Function& func)
+{
+  std::vector<llvm::BasicBlock*> blocks = {&func.getEntryBlock()};
+
+  const llvm::DominatorTree dom_tree{func};
+
+  // Blocks that dominate one of their predecessors are loop headers
+  for (auto& block : func) {
+    if (&block == &func.getEntryBlock())
+      continue;
+
+    if (std::any_of(llvm::pred_begin(&block),
+                    llvm::pred_end(&block),
+                    [&](const llvm::BasicBlock* pred) {
+                      return dom_tree.dominates(&block, pred);
+                    }))
+      blocks.push_back(&block);
+  }
+
+  return blocks;
+}
+
+// Counts calls and loop iterations of the function, and calls the hook once
+// when the count reaches the threshold
+// The function may run on several threads, so the counter is incremented
+// atomically and a flag makes sure that only one of them calls the hook
+static void instrumentFunction(llvm::Function&       func,
+                               const std::string&    name,
+                               llvm::FunctionCallee  hook,
+                               llvm::Constant* const jit_compiler,
+                               const std::uint64_t   threshold)
+{
+  auto& context = func.getContext();
+  auto& module  = *func.getParent();
+
+  auto const counter_type = llvm::Type::getInt64Ty(context);
+  auto const flag_type    = llvm::Type::getInt8Ty(context);
+
+  auto const counter
+    = new llvm::GlobalVariable{module,
+                               counter_type,
+                               false,
+                               llvm::GlobalValue::InternalLinkage,
+                               llvm::ConstantInt::get(counter_type, 0),
+                               name + ".counter"};
+
+  auto const requested
+    = new llvm::GlobalVariable{module,
+                               flag_type,
+                               false,
+                               llvm::GlobalValue::InternalLinkage,
+                               llvm::ConstantInt::get(flag_type, 0),
+                               name + ".tier_up_requested"};
+
+  const auto branch_weights
+    = llvm::MDBuilder{context}.createBranchWeights(1, threshold);
+
+  for (auto const block : findCountedBlocks(func)) {
+    auto insert_point = block->getFirstInsertionPt();
+
+    // Keep the static allocas in the entry block
+    while (llvm::isa<llvm::AllocaInst>(*insert_point))
+      ++insert_point;
+
+    llvm::IRBuilder<> builder{block, insert_point};
+
+    auto const one = llvm::ConstantInt::get(counter_type, 1);
+
+    // atomicrmw returns the count before the increment
+    auto const count = builder.CreateAdd(
+      builder.CreateAtomicRMW(llvm::AtomicRMWInst::Add,
+                              counter,
+                              one,
+                              llvm::MaybeAlign{},
+                              llvm::AtomicOrdering::Monotonic),
+      one);
+
+    // Other threads may increment the counter past the threshold before the
+    // count is compared, so it is not compared for equality
+    auto const reached = llvm::SplitBlockAndInsertIfThen(
+      builder.CreateICmpUGE(count,
+                            llvm::ConstantInt::get(counter_type, threshold)),
+      &*builder.GetInsertPoint(),
+      false,
+      branch_weights);
+
+    builder.SetInsertPoint(reached);
+
+    auto const was_requested
+      = builder.CreateAtomicRMW(llvm::AtomicRMWInst::Xchg,
+                                requested,
+                                llvm::ConstantInt::get(flag_type, 1),
+                                llvm::MaybeAlign{},
+                                llvm::AtomicOrdering::Monotonic);
+
+    auto const then = llvm::SplitBlockAndInsertIfThen(
+      builder.CreateIsNull(was_requested),
+      reached,
+      false);
+
+    builder.SetInsertPoint(then);
+    builder.CreateCall(hook,
+                       {jit_compiler, builder.CreateGlobalStringPtr(name)});
+  }
+}
+
+[[nodiscard]] llvm::Expected<llvm::orc::ThreadSafeModule>
+JitCompiler::instrumentModule(llvm::orc::ThreadSafeModule tsm,
+                              const llvm::orc::MaterializationResponsibility&)
+{
+  tsm.withModuleDo([this](llvm::Module& m) {
+    const llvm::TimeTraceScope time_trace_scope{"JIT instrument", m.getName()};
+
+    auto bitcode = std::make_shared<std::string>();
+
+    {
+      llvm::raw_string_ostream ostm{*bitcode};
+      llvm::WriteBitcodeToFile(m, ostm);
+    }
+
+    auto& context = m.getContext();
+
+    auto const hook = m.getOrInsertFunction(
+      tier_up_hook_symbol,
+      llvm::Type::getVoidTy(context),
+      llvm::Type::getInt8PtrTy(context),
+      llvm::Type::getInt8PtrTy(context));
+
+    auto const jit_compiler
+      = m.getOrInsertGlobal(jit_compiler_symbol, llvm::Type::getInt8Ty(context));
+
+    std::lock_guard lock{tier_up_mutex};
+
+    for (auto& func : m) {
+      if (func.isDeclaration())
+        continue;
+
+      // The name of the stub
+      const auto name
+        = func.getName().drop_back(baseline_symbol_suffix.size()).str();
+
+      baseline_bitcode.insert_or_assign(name, bitcode);
+
+      instrumentFunction(func, name, hook, jit_compiler, tiering.threshold);
+    }
+  });
+
+  return std::move(tsm);
+}
+
+void JitCompiler::onThresholdReached(JitCompiler* const jit,
+                                     const char* const  name)
+{
+  jit->queueTierUp(name);
+}
+
+void JitCompiler::queueTierUp(const std::string& name)
+{
+  {
+    std::lock_guard lock{tier_up_mutex};
+
+    if (!tier_up_queued.insert(name).second)
+      return;
+
+    tier_up_queue.push_back(name);
+  }
+
+  tier_up_cv.notify_one();
+}
+
+void JitCompiler::runTierUpThread()
+{
+  const TimeTraceThreadScope time_trace_scope;
+
+  for (;;) {
+    std::string name;
+
+    {
+      std::unique_lock lock{tier_up_mutex};
+
+      tier_up_cv.wait(lock, [this] {
+        return tier_up_stopped || !tier_up_queue.empty();
+      });
+
+      if (tier_up_stopped)
+        return;
+
+      name = std::move(tier_up_queue.front());
+      tier_up_queue.pop_front();
+
+      tier_up_running = true;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    if (auto err = tierUp(name))
+      exec_session->reportError(std::move(err));
+    else if (tiering.print_tier_up) {
+      const std::chrono::duration<double, std::milli> elapsed
+        = std::chrono::steady_clock::now() - start;
+
+      std::cerr << fmt::format("tier-up: {} ({:.1f} ms)\n",
+                               name,
+                               elapsed.count())
+                << std::flush;
+    }
+
+    {
+      std::lock_guard lock{tier_up_mutex};
+      tier_up_running = false;
+    }
+
+    tier_up_done_cv.notify_all();
+  }
+}
+
+[[nodiscard]] static std::string toBaselineName(const std::string& name)
+{
+  return name + std::string{baseline_symbol_suffix};
+}
+
+void JitCompiler::requestTierUp(const std::string& name)
+{
+  if (!tier_up_thread.joinable())
+    return;
+
+  // Compiles the baseline function if it has not been called yet, as its
+  // bitcode is kept when it is compiled
+  auto symbol = exec_session->lookup({&baseline_jd},
+                                     mangle(toBaselineName(name)));
+
+  if (!symbol) {
+    exec_session->reportError(symbol.takeError());
+    return;
+  }
+
+  queueTierUp(name);
+}
+
+void JitCompiler::waitForTierUps()
+{
+  if (!tier_up_thread.joinable())
+    return;
+
+  std::unique_lock lock{tier_up_mutex};
+
+  tier_up_done_cv.wait(lock, [this] {
+    return tier_up_queue.empty() && !tier_up_running;
+  });
+}
+
+[[nodiscard]] llvm::Error JitCompiler::tierUp(const std::string& name)
+{
+  const llvm::TimeTraceScope time_trace_scope{"JIT tier up", name};
+
+  auto tsm = createOptimizedModule(name);
+  if (!tsm)
+    return tsm.takeError();
+
+  if (auto err = optimized_compile_layer.add(optimized_jd, std::move(*tsm)))
+    return err;
+
+  auto symbol = exec_session->lookup(
+    {&optimized_jd},
+    mangle(name + std::string{optimized_symbol_suffix}));
+
+  if (!symbol)
+    return symbol.takeError();
+
+  // Calls that start after this run the optimized function
+  return stubs_manager->updatePointer(*mangle(name), symbol->getAddress());
+}
+
+// Leaves the functions as the only definitions of the module
+static void
+removeOtherDefinitions(llvm::Module&                                module,
+                       const std::unordered_set<const llvm::Function*>& kept)
+{
+  for (auto& r : module) {
+    if (!kept.contains(&r))
+      r.deleteBody();
+  }
+
+  for (auto& r : module.globals()) {
+    r.setInitializer(nullptr);
+    r.setLinkage(llvm::GlobalValue::ExternalLinkage);
+    r.setComdat(nullptr);
+  }
+}
+
+// Gives the baseline definition the name of its stub, so that calls to the
+// stub can be inlined
+static void makeInlinable(llvm::Module&      module,
+                          llvm::Function&    definition,
+                          const std::string& name)
+{
+  if (auto const stub = module.getFunction(name)) {
+    stub->replaceAllUsesWith(&definition);
+    stub->eraseFromParent();
+  }
+
+  definition.setName(name);
+  definition.setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+}
+
+[[nodiscard]] llvm::Expected<llvm::orc::ThreadSafeModule>
+JitCompiler::createOptimizedModule(const std::string& name)
+{
+  auto context = std::make_unique<llvm::LLVMContext>();
+
+  // Bitcode of the modules, shared with the map
+  using Bitcode = std::shared_ptr<const std::string>;
+
+  auto parse = [&](const Bitcode& bitcode) {
+    return llvm::parseBitcodeFile(llvm::MemoryBufferRef{*bitcode, name},
+                                  *context);
+  };
+
+  Bitcode bitcode;
+
+  {
+    std::lock_guard lock{tier_up_mutex};
+    bitcode = baseline_bitcode.at(name);
+  }
+
+  auto module = parse(bitcode);
+  if (!module)
+    return module.takeError();
+
+  auto const func = (*module)->getFunction(toBaselineName(name));
+
+  // Functions called directly, excluding the ones in the C library
+  std::unordered_set<std::string> callees;
+
+  for (const auto& block : *func) {
+    for (const auto& inst : block) {
+      if (auto const call = llvm::dyn_cast<llvm::CallBase>(&inst)) {
+        auto const callee = call->getCalledFunction();
+
+        if (callee && callee->isDeclaration() && !callee->isIntrinsic()
+            && callee->getName() != name)
+          callees.insert(callee->getName().str());
+      }
+    }
+  }
+
+  // Callees defined in the module of the function, and the callees in each
+  // of the other modules
+  std::vector<std::string>                    local_callees;
+  std::map<Bitcode, std::vector<std::string>> other_callees;
+
+  {
+    std::lock_guard lock{tier_up_mutex};
+
+    for (const auto& callee : callees) {
+      // Not compiled yet
+      const auto it = baseline_bitcode.find(callee);
+      if (it == baseline_bitcode.end())
+        continue;
+
+      if (it->second == bitcode)
+        local_callees.push_back(callee);
+      else
+        other_callees[it->second].push_back(callee);
+    }
+  }
+
+  {
+    std::unordered_set<const llvm::Function*> kept = {func};
+
+    for (const auto& callee : local_callees)
+      kept.insert((*module)->getFunction(toBaselineName(callee)));
+
+    removeOtherDefinitions(**module, kept);
+  }
+
+  // Recursive calls go to the optimized function directly
+  if (auto const stub = (*module)->getFunction(name)) {
+    stub->replaceAllUsesWith(func);
+    stub->eraseFromParent();
+  }
+
+  func->setName(name + std::string{optimized_symbol_suffix});
+
+  // Callees that have been compiled can be inlined
+  for (const auto& callee : local_callees)
+    makeInlinable(**module,
+                  *(*module)->getFunction(toBaselineName(callee)),
+                  callee);
+
+  for (const auto& [other_bitcode, names] : other_callees) {
+    auto other = parse(other_bitcode);
+    if (!other)
+      return other.takeError();
+
+    std::unordered_set<const llvm::Function*> kept;
+
+    for (const auto& callee : names)
+      kept.insert((*other)->getFunction(toBaselineName(callee)));
+
+    removeOtherDefinitions(**other, kept);
+
+    for (const auto& callee : names)
+      makeInlinable(**other,
+                    *(*other)->getFunction(toBaselineName(callee)),
+                    callee);
+
+    if (llvm::Linker::linkModules(**module,
+                                  std::move(*other),
+                                  llvm::Linker::Flags::LinkOnlyNeeded)) {
+      return llvm::make_error<llvm::StringError>(
+        "callees of " + name + " could not be linked",
+        llvm::inconvertibleErrorCode());
+    }
+  }
+
+  auto machine = optimized_jit_tmb.createTargetMachine();
+  if (!machine)
+    return machine.takeError();
+
+  {
+    const llvm::TimeTraceScope time_trace_scope{"JIT optimize", name};
+
+    // The analysis managers must be declared in this order so that they are
+    // destroyed in the reverse order
+    llvm::LoopAnalysisManager     lam;
+    llvm::FunctionAnalysisManager fam;
+    llvm::CGSCCAnalysisManager    cgam;
+    llvm::ModuleAnalysisManager   mam;
+
+    llvm::PassBuilder pass_builder{machine->get()};
+
+    pass_builder.registerModuleAnalyses(mam);
+    pass_builder.registerCGSCCAnalyses(cgam);
+    pass_builder.registerFunctionAnalyses(fam);
+    pass_builder.registerLoopAnalyses(lam);
+    pass_builder.crossRegisterProxies(lam, fam, cgam, mam);
+
+    pass_builder
+      .buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O3)
+      .run(**module, mam);
+  }
+
+  return llvm::orc::ThreadSafeModule{std::move(*module), std::move(context)};
+}
+
 } // namespace twinkle::jit
@@ -0,0 +1,132 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twinkle/jit/object_cache.hpp>
+#include <twinkle/support/utils.hpp>
+#include <llvm/Bitcode/BitcodeWriter.h>
+
+namespace twinkle::jit
+{
+
+[[nodiscard]] static std::string
+createTargetKey(const llvm::orc::JITTargetMachineBuilder& jit_tmb,
+                const llvm::CodeGenOpt::Level             opt_level)
+{
+  return cache::Hasher{}
+    .add(getVersion())
+    .add("jit")
+    .add(jit_tmb.getTargetTriple().str())
+    .add(jit_tmb.getCPU())
+    .add(jit_tmb.getFeatures().getString())
+    .add(std::to_string(static_cast<int>(*jit_tmb.getRelocationModel())))
+    .add(std::to_string(static_cast<int>(*jit_tmb.getCodeModel())))
+    .add(std::to_string(static_cast<int>(opt_level)))
+    .finalize();
+}
+
+ObjectCache::ObjectCache(cache::Cache&                             cache,
+                         const llvm::orc::JITTargetMachineBuilder& jit_tmb,
+                         const llvm::CodeGenOpt::Level             opt_level)
+  : cache{cache}
+  , target_key{createTargetKey(jit_tmb, opt_level)}
+{
+}
+
+void ObjectCache::notifyObjectCompiled(const llvm::Module*         module,
+                                       const llvm::MemoryBufferRef object)
+{
+  std::string key;
+
+  {
+    std::lock_guard lock{mutex};
+
+    auto node = pending_keys.extract(module);
+
+    // Not looked up before compiled
+    if (!node)
+      return;
+
+    key = std::move(node.mapped());
+  }
+
+  cache.store(key, object.getBuffer());
+}
+
+[[nodiscard]] std::unique_ptr<llvm::MemoryBuffer>
+ObjectCache::getObject(const llvm::Module* module)
+{
+  {
+    std::lock_guard lock{mutex};
+
+    // Keyed as it was before it was transformed
+    if (auto node = early_lookups.extract(module)) {
+      auto& [early_key, object] = node.mapped();
+
+      if (object)
+        return std::move(object);
+
+      pending_keys.insert_or_assign(module, std::move(early_key));
+      return nullptr;
+    }
+  }
+
+  auto key = createKey(*module);
+
+  if (auto object = load(key))
+    return object;
+
+  std::lock_guard lock{mutex};
+  pending_keys.insert_or_assign(module, std::move(key));
+
+  return nullptr;
+}
+
+[[nodiscard]] bool
+ObjectCache::lookupBeforeTransform(const llvm::Module& module)
+{
+  auto key    = createKey(module);
+  auto object = load(key);
+
+  const auto found = static_cast<bool>(object);
+
+  std::lock_guard lock{mutex};
+  early_lookups.insert_or_assign(
+    &module,
+    EarlyLookup{std::move(key), std::move(object)});
+
+  return found;
+}
+
+[[nodiscard]] std::unique_ptr<llvm::MemoryBuffer>
+ObjectCache::load(const std::string& key) const
+{
+  if (const auto outputs = cache.lookup(key)) {
+    assert(outputs->size() == 1);
+
+    // Compiled again if the object has just been evicted
+    if (auto buffer = llvm::MemoryBuffer::getFile(outputs->front().string()))
+      return std::move(*buffer);
+  }
+
+  return nullptr;
+}
+
+[[nodiscard]] std::string
+ObjectCache::createKey(const llvm::Module& module) const
+{
+  llvm::SmallVector<char, 0> bitcode;
+  llvm::raw_svector_ostream  ostm{bitcode};
+
+  llvm::WriteBitcodeToFile(module, ostm);
+
+  return cache::Hasher{}
+    .add(target_key)
+    .add({bitcode.data(), bitcode.size()})
+    .finalize();
+}
+
+} // namespace twinkle::jit
@@ -0,0 +1,214 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twinkle/jit/perf_plugin.hpp>
+#include <llvm/BinaryFormat/ELF.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/Threading.h>
+#include <chrono>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace twinkle::jit
+{
+
+// See tools/perf/Documentation/jitdump-specification.txt of Linux
+constexpr std::uint32_t jitdump_magic   = 0x4A695444;
+constexpr std::uint32_t jitdump_version = 1;
+
+constexpr std::uint32_t jitdump_header_size        = 40;
+constexpr std::uint32_t jitdump_record_header_size = 16;
+constexpr std::uint32_t jitdump_code_load_size     = 40;
+
+// Types of the records
+constexpr std::uint32_t jitdump_code_load  = 0;
+constexpr std::uint32_t jitdump_code_close = 3;
+
+template <typename T>
+static void writeValue(llvm::raw_ostream& ostm, const T value)
+{
+  ostm.write(reinterpret_cast<const char*>(&value), sizeof value);
+}
+
+// In nanoseconds of the monotonic clock, as 'perf record -k mono' expects
+[[nodiscard]] static std::uint64_t getTimestamp()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+[[nodiscard]] static std::uint32_t getElfMachine(const llvm::Triple& triple)
+{
+  switch (triple.getArch()) {
+  case llvm::Triple::x86:
+    return llvm::ELF::EM_386;
+  case llvm::Triple::x86_64:
+    return llvm::ELF::EM_X86_64;
+  case llvm::Triple::arm:
+    return llvm::ELF::EM_ARM;
+  case llvm::Triple::aarch64:
+    return llvm::ELF::EM_AARCH64;
+  case llvm::Triple::riscv64:
+    return llvm::ELF::EM_RISCV;
+  default:
+    return llvm::ELF::EM_NONE;
+  }
+}
+
+// Returns the file descriptor
+// The file is readable, as the dump is mapped
+[[nodiscard]] static llvm::Expected<int> openFile(const std::string& path)
+{
+  int fd;
+
+  const auto ec
+    = llvm::sys::fs::openFileForReadWrite(path,
+                                          fd,
+                                          llvm::sys::fs::CD_CreateAlways,
+                                          llvm::sys::fs::OF_None);
+  if (ec)
+    return llvm::createFileError(path, ec);
+
+  return fd;
+}
+
+[[nodiscard]] llvm::Expected<std::unique_ptr<PerfPlugin>>
+PerfPlugin::create(const llvm::Triple& target_triple)
+{
+  const auto pid = llvm::sys::Process::getProcessId();
+
+  auto perf_map_fd = openFile(fmt::format("/tmp/perf-{}.map", pid));
+  if (!perf_map_fd)
+    return perf_map_fd.takeError();
+
+  auto perf_map = std::make_unique<llvm::raw_fd_ostream>(*perf_map_fd, true);
+
+  auto jitdump_fd = openFile(fmt::format("/tmp/jit-{}.dump", pid));
+  if (!jitdump_fd)
+    return jitdump_fd.takeError();
+
+  auto jitdump = std::make_unique<llvm::raw_fd_ostream>(*jitdump_fd, true);
+
+  writeValue<std::uint32_t>(*jitdump, jitdump_magic);
+  writeValue<std::uint32_t>(*jitdump, jitdump_version);
+  writeValue<std::uint32_t>(*jitdump, jitdump_header_size);
+  writeValue<std::uint32_t>(*jitdump, getElfMachine(target_triple));
+  writeValue<std::uint32_t>(*jitdump, 0); // Padding
+  writeValue<std::uint32_t>(*jitdump, pid);
+  writeValue<std::uint64_t>(*jitdump, getTimestamp());
+  writeValue<std::uint64_t>(*jitdump, 0); // Flags
+
+  jitdump->flush();
+
+  void*       jitdump_marker      = nullptr;
+  std::size_t jitdump_marker_size = 0;
+
+#if defined(__linux__)
+  jitdump_marker_size = sysconf(_SC_PAGESIZE);
+
+  jitdump_marker = mmap(nullptr,
+                        jitdump_marker_size,
+                        PROT_READ | PROT_EXEC,
+                        MAP_PRIVATE,
+                        *jitdump_fd,
+                        0);
+
+  if (jitdump_marker == MAP_FAILED) {
+    return llvm::createFileError(
+      fmt::format("/tmp/jit-{}.dump", pid),
+      std::error_code{errno, std::generic_category()});
+  }
+#endif
+
+  return std::unique_ptr<PerfPlugin>{new PerfPlugin{std::move(perf_map),
+                                                    std::move(jitdump),
+                                                    jitdump_marker,
+                                                    jitdump_marker_size}};
+}
+
+PerfPlugin::PerfPlugin(
+  std::unique_ptr<llvm::raw_fd_ostream> perf_map,
+  std::unique_ptr<llvm::raw_fd_ostream> jitdump,
+  void* const                           jitdump_marker,
+  const std::size_t                     jitdump_marker_size)
+  : perf_map{std::move(perf_map)}
+  , jitdump{std::move(jitdump)}
+  , jitdump_marker{jitdump_marker}
+  , jitdump_marker_size{jitdump_marker_size}
+{
+}
+
+PerfPlugin::~PerfPlugin()
+{
+  writeValue<std::uint32_t>(*jitdump, jitdump_code_close);
+  writeValue<std::uint32_t>(*jitdump, jitdump_record_header_size);
+  writeValue<std::uint64_t>(*jitdump, getTimestamp());
+
+#if defined(__linux__)
+  munmap(jitdump_marker, jitdump_marker_size);
+#endif
+}
+
+void PerfPlugin::modifyPassConfig(llvm::orc::MaterializationResponsibility&,
+                                  llvm::jitlink::LinkGraph&,
+                                  llvm::jitlink::PassConfiguration& config)
+{
+  // The code is complete once it is fixed up
+  config.PostFixupPasses.push_back([this](llvm::jitlink::LinkGraph& graph) {
+    recordFunctions(graph);
+    return llvm::Error::success();
+  });
+}
+
+void PerfPlugin::recordFunctions(const llvm::jitlink::LinkGraph& graph)
+{
+  const auto pid = llvm::sys::Process::getProcessId();
+  const auto tid = llvm::get_threadid();
+
+  std::lock_guard lock{mutex};
+
+  for (auto const symbol : graph.defined_symbols()) {
+    if (!symbol->isCallable() || !symbol->hasName() || !symbol->getSize()
+        || symbol->getBlock().isZeroFill())
+      continue;
+
+    const auto name = symbol->getName();
+    const auto addr = symbol->getAddress().getValue();
+    const auto size = symbol->getSize();
+
+    *perf_map << fmt::format("{:x} {:x} {}\n", addr, size, name.str());
+
+    const auto code
+      = symbol->getBlock().getContent().slice(symbol->getOffset(), size);
+
+    writeValue<std::uint32_t>(*jitdump, jitdump_code_load);
+    writeValue<std::uint32_t>(*jitdump,
+                              jitdump_record_header_size
+                                + jitdump_code_load_size + name.size() + 1
+                                + size);
+    writeValue<std::uint64_t>(*jitdump, getTimestamp());
+    writeValue<std::uint32_t>(*jitdump, pid);
+    writeValue<std::uint32_t>(*jitdump, tid);
+    writeValue<std::uint64_t>(*jitdump, addr); // Virtual address
+    writeValue<std::uint64_t>(*jitdump, addr); // Code address
+    writeValue<std::uint64_t>(*jitdump, size);
+    writeValue<std::uint64_t>(*jitdump, code_index++);
+
+    *jitdump << name << '\0';
+    jitdump->write(code.data(), code.size());
+  }
+
+  // Kept up to date in case the program crashes
+  perf_map->flush();
+  jitdump->flush();
+}
+
+} // namespace twinkle::jit
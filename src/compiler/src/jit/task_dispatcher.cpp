@@ -0,0 +1,89 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twinkle/jit/task_dispatcher.hpp>
+#include <twinkle/support/time_trace.hpp>
+
+namespace twinkle::jit
+{
+
+TaskDispatcher::TaskDispatcher(const unsigned int num_threads)
+{
+  assert(num_threads);
+
+  workers.reserve(num_threads);
+
+  for (unsigned int i = 0; i < num_threads; ++i) {
+    workers.emplace_back([this] {
+      const TimeTraceThreadScope time_trace_scope;
+      runWorker();
+    });
+  }
+}
+
+TaskDispatcher::~TaskDispatcher()
+{
+  shutdown();
+}
+
+void TaskDispatcher::dispatch(std::unique_ptr<llvm::orc::Task> task)
+{
+  {
+    std::lock_guard lock{mutex};
+
+    if (!stopped) {
+      tasks.push_back(std::move(task));
+      cv.notify_one();
+      return;
+    }
+  }
+
+  task->run();
+}
+
+void TaskDispatcher::shutdown()
+{
+  {
+    std::lock_guard lock{mutex};
+
+    if (stopped)
+      return;
+
+    stopped = true;
+  }
+
+  cv.notify_all();
+
+  for (auto& worker : workers)
+    worker.join();
+}
+
+void TaskDispatcher::runWorker()
+{
+  for (;;) {
+    std::unique_ptr<llvm::orc::Task> task;
+
+    {
+      std::unique_lock lock{mutex};
+
+      cv.wait(lock, [this] {
+        return stopped || !tasks.empty();
+      });
+
+      // Tasks queued before the shutdown still run
+      if (tasks.empty())
+        return;
+
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+
+    task->run();
+  }
+}
+
+} // namespace twinkle::jit
@@ -0,0 +1,201 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twinkle/linker/linker.hpp>
+#include <twinkle/pch/pch.hpp>
+#include <llvm/Support/Program.h>
+#include <cstdlib>
+#include <sys/wait.h>
+
+#ifdef TWINKLE_HAVE_LLD
+#include <lld/Common/Driver.h>
+#endif
+
+namespace twinkle::linker
+{
+
+[[nodiscard]] bool isLinkerAvailable(const std::string_view linker)
+{
+  if (linker == LINKER_GCC_ARG || linker == LINKER_LD_ARG)
+    return true;
+
+#ifdef TWINKLE_HAVE_LLD
+  return linker == LINKER_LLD_ARG;
+#else
+  return false;
+#endif
+}
+
+[[nodiscard]] static std::optional<int>
+callGcc(const std::vector<std::filesystem::path>& files,
+        const std::vector<std::string>&           linked_libs,
+        const std::vector<std::string>&           linker_options)
+{
+  if (!std::system(nullptr))
+    return std::nullopt;
+
+  std::string command = "gcc";
+
+  for (const auto& r : files)
+    command += (' ' + r.string());
+
+  for (const auto& r : linker_options)
+    command += (' ' + r);
+
+  for (const auto& r : linked_libs)
+    command += (" -l" + r);
+
+  // std::system returns the wait status, not the exit status
+  const auto status = std::system(command.c_str());
+
+  if (status == -1 || !WIFEXITED(status))
+    return std::nullopt;
+
+  return WEXITSTATUS(status);
+}
+
+// Arguments that gcc passes to the linker for a C program on this system,
+// found when twinkle was built
+// Returns std::nullopt if the C runtime was not found
+[[nodiscard]] static std::optional<std::vector<std::string>>
+createLinkerArgs(const std::vector<std::filesystem::path>& files,
+                 const std::vector<std::string>&           linked_libs,
+                 const std::vector<std::string>&           linker_options,
+                 const bool                                pie)
+{
+  const std::filesystem::path crt_dir     = TWINKLE_C_RUNTIME_DIR;
+  const std::filesystem::path gcc_lib_dir = TWINKLE_GCC_LIBRARY_DIR;
+
+  const auto crt1     = crt_dir / (pie ? "Scrt1.o" : "crt1.o");
+  const auto crti     = crt_dir / "crti.o";
+  const auto crtn     = crt_dir / "crtn.o";
+  const auto crtbegin = gcc_lib_dir / (pie ? "crtbeginS.o" : "crtbegin.o");
+  const auto crtend   = gcc_lib_dir / (pie ? "crtendS.o" : "crtend.o");
+
+  if (std::string_view{TWINKLE_DYNAMIC_LINKER}.empty())
+    return std::nullopt;
+
+  for (const auto& r : {crt1, crti, crtn, crtbegin, crtend}) {
+    if (!std::filesystem::exists(r))
+      return std::nullopt;
+  }
+
+  std::vector<std::string> args = {"--eh-frame-hdr",
+                                   "--hash-style=gnu",
+                                   "--build-id",
+                                   "-dynamic-linker",
+                                   TWINKLE_DYNAMIC_LINKER};
+
+  if (pie)
+    args.emplace_back("-pie");
+
+  args.insert(args.end(),
+              {"-o", "a.out", crt1.string(), crti.string(), crtbegin.string()});
+
+  // Colon separated, as printed by 'gcc -print-search-dirs'
+  std::vector<std::string> library_dirs;
+  boost::algorithm::split(library_dirs,
+                          TWINKLE_LIBRARY_DIRS,
+                          boost::is_any_of(":"));
+
+  for (const std::filesystem::path r : library_dirs) {
+    if (!r.empty() && std::filesystem::is_directory(r))
+      args.push_back("-L" + r.lexically_normal().string());
+  }
+
+  for (const auto& r : files)
+    args.push_back(r.string());
+
+  args.insert(args.end(), linker_options.begin(), linker_options.end());
+
+  for (const auto& r : linked_libs)
+    args.push_back("-l" + r);
+
+  // libgcc_s is only needed by programs that unwind
+  args.insert(args.end(),
+              {"-lgcc",
+               "--push-state",
+               "--as-needed",
+               "-lgcc_s",
+               "--pop-state",
+               "-lc",
+               "-lgcc",
+               "--push-state",
+               "--as-needed",
+               "-lgcc_s",
+               "--pop-state",
+               crtend.string(),
+               crtn.string()});
+
+  return args;
+}
+
+[[nodiscard]] static std::optional<int>
+callLd(const std::vector<std::string>& args)
+{
+  const auto ld = llvm::sys::findProgramByName("ld");
+
+  if (!ld)
+    return std::nullopt;
+
+  std::vector<llvm::StringRef> argv = {*ld};
+  argv.insert(argv.end(), args.begin(), args.end());
+
+  const auto exit_status = llvm::sys::ExecuteAndWait(*ld, argv);
+
+  // The program could not be executed
+  if (exit_status < 0)
+    return std::nullopt;
+
+  return exit_status;
+}
+
+#ifdef TWINKLE_HAVE_LLD
+
+[[nodiscard]] static int callLld(const std::vector<std::string>& args)
+{
+  std::vector<const char*> argv = {"ld.lld"};
+
+  for (const auto& r : args)
+    argv.push_back(r.c_str());
+
+  // Keep the process alive to return the exit status
+  return lld::elf::link(argv, llvm::outs(), llvm::errs(), false, false)
+           ? EXIT_SUCCESS
+           : EXIT_FAILURE;
+}
+
+#endif
+
+[[nodiscard]] std::optional<int>
+link(const std::string_view                    linker,
+     const std::vector<std::filesystem::path>& files,
+     const std::vector<std::string>&           linked_libs,
+     const std::vector<std::string>&           linker_options,
+     const bool                                pie)
+{
+  assert(isLinkerAvailable(linker));
+
+  const llvm::TimeTraceScope time_trace_scope{"Link", linker};
+
+  if (linker == LINKER_GCC_ARG)
+    return callGcc(files, linked_libs, linker_options);
+
+  const auto args = createLinkerArgs(files, linked_libs, linker_options, pie);
+
+  if (!args)
+    return std::nullopt;
+
+#ifdef TWINKLE_HAVE_LLD
+  if (linker == LINKER_LLD_ARG)
+    return callLld(*args);
+#endif
+
+  return callLd(*args);
+}
+
+} // namespace twinkle::linker
@@ -99,73 +99,6 @@ Mangler::mangleFunctionTemplateCall(const std::string_view        callee,
   return candidates;
 }
 
-[[nodiscard]] std::vector<std::string>
-Mangler::mangleFunctionCall(const std::string_view   callee,
-                            const std::deque<Value>& args) const
-{
-  std::vector<std::string> candidates;
-
-  // Previous
-  {
-    std::ostringstream mangled;
-
-    mangled << prefix;
-
-    for (const auto& r : mangleNamespaceHierarchy(ctx.ns_hierarchy))
-      candidates.push_back(mangled.str() + r);
-  }
-
-  // Back
-  {
-    std::ostringstream mangled;
-
-    mangled << mangleFunctionName(std::string{callee}) << "E";
-
-    mangled << mangleArgs(args);
-
-    for (auto& r : candidates)
-      r += mangled.str();
-  }
-
-  return candidates;
-}
-
-[[nodiscard]] std::vector<std::string>
-Mangler::mangleMethodCall(const std::string_view   callee,
-                          const std::string&       class_name,
-                          const std::deque<Value>& args,
-                          const Accessibility      accessibility) const
-{
-  std::vector<std::string> candidates;
-
-  // Previous
-  {
-    std::ostringstream mangled;
-
-    mangled << prefix;
-
-    mangled << getMangledAccessibility(accessibility);
-
-    for (const auto& r : mangleNamespaceHierarchy(ctx.ns_hierarchy))
-      candidates.push_back(mangled.str() + r);
-  }
-
-  {
-    std::ostringstream mangled;
-
-    mangled << mangleFunctionName(std::string{callee}) << "E";
-
-    mangled << mangleThisPointer(class_name);
-
-    mangled << mangleArgs(args);
-
-    for (auto& r : candidates)
-      r += mangled.str();
-  }
-
-  return candidates;
-}
-
 [[nodiscard]] std::vector<std::string>
 Mangler::mangleConstructorCall(const std::deque<Value>& args) const
 {
@@ -274,9 +207,10 @@ Mangler::mangleNamespaceHierarchy(const NamespaceStack& namespaces) const
 [[nodiscard]] std::string
 Mangler::mangleThisPointer(const std::string& class_name) const
 {
-  return PointerType{std::make_shared<UserDefinedType>(class_name, false),
-                     false}
-    .getMangledName(ctx);
+  return ctx.types
+    .getPointerType(std::make_shared<UserDefinedType>(class_name, false),
+                    false)
+    ->getMangledName(ctx);
 }
 
 [[nodiscard]] std::string
@@ -297,7 +231,7 @@ Mangler::mangleParams(const ast::ParameterList& params) const
 
   for (const auto& param : *params) {
     if (param.is_vararg)
-      mangled << "z";
+      mangled << ellipsis;
     else {
       const auto type = createType(ctx, param.type, ctx.positionOf(params));
       mangled << type->getMangledName(ctx);
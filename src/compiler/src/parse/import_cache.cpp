@@ -0,0 +1,87 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twinkle/parse/import_cache.hpp>
+
+namespace twinkle::parse
+{
+
+[[nodiscard]] const std::shared_ptr<ImportCache>& ImportCache::getInstance()
+{
+  static const auto instance = std::make_shared<ImportCache>();
+  return instance;
+}
+
+[[nodiscard]] ImportCache::ResultPtr
+ImportCache::load(const std::filesystem::path&           path,
+                  const ParserKind                       kind,
+                  const std::function<Parser::Result()>& parse)
+{
+  namespace fs = std::filesystem;
+
+  std::error_code ec;
+  const auto      last_write_time = fs::last_write_time(path, ec);
+  const auto      file_size       = ec ? 0 : fs::file_size(path, ec);
+
+  // Files imported through different relative paths are the same entry
+  const auto canonical_path = ec ? path : fs::canonical(path, ec);
+
+  // Let the parser report the error
+  if (ec)
+    return std::make_shared<const Parser::Result>(parse());
+
+  // Parsers of different kinds may fail differently on the same file
+  const auto key = std::pair{canonical_path.string(), kind};
+
+  std::promise<ResultPtr> promise;
+
+  {
+    std::unique_lock lock{mutex};
+
+    if (const auto it = entries.find(key);
+        it != entries.end() && it->second.last_write_time == last_write_time
+        && it->second.file_size == file_size) {
+      const auto result = it->second.result;
+
+      lock.unlock();
+
+      // Rethrows the error if the parse failed
+      return result.get();
+    }
+
+    entries.insert_or_assign(
+      key,
+      Entry{last_write_time, file_size, promise.get_future().share()});
+  }
+
+  // Parsed without the lock so that other files are not blocked
+  try {
+    auto parsed = parse();
+    parsed.file = canonical_path;
+
+    auto result = std::make_shared<const Parser::Result>(std::move(parsed));
+    promise.set_value(result);
+    return result;
+  }
+  catch (...) {
+    {
+      std::lock_guard lock{mutex};
+
+      // Unless the file has been modified and parsed again since
+      if (const auto it = entries.find(key);
+          it != entries.end() && it->second.last_write_time == last_write_time
+          && it->second.file_size == file_size)
+        entries.erase(it);
+    }
+
+    // Threads waiting for the result get the error as well
+    promise.set_exception(std::current_exception());
+    throw;
+  }
+}
+
+} // namespace twinkle::parse
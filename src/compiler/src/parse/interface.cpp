@@ -0,0 +1,215 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twinkle/parse/interface.hpp>
+#include <twinkle/support/exception.hpp>
+#include <twinkle/support/utils.hpp>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/xxhash.h>
+#include <fstream>
+
+namespace twinkle::parse
+{
+
+constexpr std::array<char, 4> interface_magic   = {'T', 'W', 'K', 'I'};
+constexpr std::uint32_t       interface_version = 1;
+
+// Copies parts of the source, each one to the same line as in the source
+struct InterfaceBuilder : private boost::noncopyable {
+  explicit InterfaceBuilder(const Parser::Result& result)
+    : result{result}
+  {
+  }
+
+  void addTopLevel(const ast::TopLevelWithAttr& node)
+  {
+    const auto& top_level = node.top_level;
+
+    if (const auto func_def = boost::get<ast::FunctionDef>(&top_level);
+        func_def && func_def->is_public) {
+      // Templates are instantiated from their definitions
+      if (func_def->decl.isTemplate())
+        copy(firstOf(node), lastOf(node));
+      else {
+        copy(firstOf(node), lastOf(func_def->decl));
+        text += " {}";
+      }
+    }
+    else if (const auto class_def = boost::get<ast::ClassDef>(&top_level);
+             class_def && class_def->is_public)
+      addClass(*class_def, firstOf(node));
+    else if (const auto union_def = boost::get<ast::UnionDef>(&top_level);
+             union_def && union_def->is_public)
+      copy(firstOf(node), lastOf(node));
+  }
+
+  [[nodiscard]] const std::string& getText() const noexcept
+  {
+    return text;
+  }
+
+private:
+  // Only the methods are declared when a class is imported
+  void addClass(const ast::ClassDef& node, std::size_t first)
+  {
+    if (node.isTemplate()) {
+      copy(first, lastOf(node));
+      return;
+    }
+
+    for (const auto& member : node.members) {
+      if (const auto method = boost::get<ast::FunctionDef>(&member);
+          method && !method->decl.isTemplate()) {
+        copy(first, lastOf(method->decl));
+        text += " {}";
+        first = lastOf(*method);
+      }
+      else if (const auto destructor = boost::get<ast::Destructor>(&member)) {
+        copy(first, lastOf(destructor->decl));
+        text += " {}";
+        first = lastOf(*destructor);
+      }
+    }
+
+    copy(first, lastOf(node));
+  }
+
+  // Offsets in bytes
+  [[nodiscard]] std::size_t firstOf(const x3::position_tagged& ast) const
+  {
+    return result.positions->positionOf(ast).begin().base()
+           - result.source->getText().cbegin();
+  }
+
+  [[nodiscard]] std::size_t lastOf(const x3::position_tagged& ast) const
+  {
+    return result.positions->positionOf(ast).end().base()
+           - result.source->getText().cbegin();
+  }
+
+  void copy(const std::size_t first, const std::size_t last)
+  {
+    assert(copied <= first && first <= last);
+
+    const auto source = result.source->getText();
+
+    source_line += std::count(&source[copied], &source[first], '\n');
+
+    text.append(source_line - line, '\n');
+    line = source_line;
+
+    const auto copied_lines = std::count(&source[first], &source[last], '\n');
+
+    text.append(source.substr(first, last - first));
+
+    line += copied_lines;
+    source_line += copied_lines;
+    copied = last;
+  }
+
+  const Parser::Result& result;
+
+  std::string text;
+
+  // Lines of the ends of the text and of the source copied or skipped
+  std::size_t line        = 0;
+  std::size_t source_line = 0;
+
+  std::size_t copied = 0;
+};
+
+template <typename T>
+static void writeValue(std::ostream& ostm, const T value)
+{
+  ostm.write(reinterpret_cast<const char*>(&value), sizeof value);
+}
+
+template <typename T>
+[[nodiscard]] static T readValue(std::istream& istm)
+{
+  T value{};
+  istm.read(reinterpret_cast<char*>(&value), sizeof value);
+  return value;
+}
+
+[[nodiscard]] std::filesystem::path
+getInterfacePath(const std::filesystem::path& source_file)
+{
+  return std::filesystem::path{source_file}.replace_extension(".twki");
+}
+
+void writeInterface(const Parser::Result&        result,
+                    const std::filesystem::path& output_file,
+                    const std::string_view       argv_front)
+{
+  const llvm::TimeTraceScope time_trace_scope{"Write interface",
+                                              output_file.string()};
+
+  InterfaceBuilder builder{result};
+
+  for (const auto& r : result.ast)
+    builder.addTopLevel(r);
+
+  const auto& text = builder.getText();
+
+  std::ofstream ofs{output_file, std::ios_base::binary};
+
+  ofs.write(interface_magic.data(), interface_magic.size());
+  writeValue<std::uint32_t>(ofs, interface_version);
+
+  // Identifies the source that the interface is up to date with
+  const auto source = result.source->getText();
+
+  writeValue<std::uint64_t>(ofs, source.size());
+  writeValue<std::uint64_t>(ofs, llvm::xxHash64(source));
+
+  writeValue<std::uint64_t>(ofs, text.size());
+  ofs.write(text.data(), text.size());
+
+  if (!ofs) {
+    throw ErrorBase{formatError(
+      argv_front,
+      fmt::format("{}: Could not write file", output_file.string()))};
+  }
+}
+
+[[nodiscard]] std::optional<std::string>
+loadInterface(const std::filesystem::path& source_file)
+{
+  std::ifstream ifs{getInterfacePath(source_file), std::ios_base::binary};
+  if (!ifs)
+    return std::nullopt;
+
+  std::array<char, interface_magic.size()> magic;
+  ifs.read(magic.data(), magic.size());
+
+  const auto version     = readValue<std::uint32_t>(ifs);
+  const auto source_size = readValue<std::uint64_t>(ifs);
+  const auto source_hash = readValue<std::uint64_t>(ifs);
+  const auto text_size   = readValue<std::uint64_t>(ifs);
+
+  if (!ifs || magic != interface_magic || version != interface_version)
+    return std::nullopt;
+
+  // Interfaces can be used without their sources
+  if (const auto source = mapSourceFile(source_file)) {
+    const auto text = (*source)->getText();
+
+    if (text.size() != source_size || llvm::xxHash64(text) != source_hash)
+      return std::nullopt;
+  }
+
+  std::string text(text_size, '\0');
+  ifs.read(text.data(), text_size);
+
+  if (!ifs)
+    return std::nullopt;
+
+  return text;
+}
+
+} // namespace twinkle::parse
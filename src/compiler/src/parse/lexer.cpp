@@ -0,0 +1,475 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twinkle/pch/pch.hpp>
+#include <twinkle/parse/lexer.hpp>
+
+namespace x3 = boost::spirit::x3;
+
+namespace twinkle::parse
+{
+
+using Unicode = boost::spirit::char_encoding::unicode;
+
+//===----------------------------------------------------------------------===//
+// Character classes
+//===----------------------------------------------------------------------===//
+
+struct DecodedChar {
+  char32_t code;
+
+  // 0 if the sequence is invalid
+  std::size_t length;
+};
+
+[[nodiscard]] static DecodedChar decode(const std::string_view input,
+                                        const std::size_t      offset)
+{
+  const auto lead = static_cast<unsigned char>(input[offset]);
+
+  if (lead < 0x80)
+    return {lead, 1};
+
+  std::size_t length;
+  char32_t    code;
+
+  if ((lead & 0xe0) == 0xc0) {
+    length = 2;
+    code   = lead & 0x1f;
+  }
+  else if ((lead & 0xf0) == 0xe0) {
+    length = 3;
+    code   = lead & 0x0f;
+  }
+  else if ((lead & 0xf8) == 0xf0) {
+    length = 4;
+    code   = lead & 0x07;
+  }
+  else
+    return {0, 0};
+
+  if (input.size() - offset < length)
+    return {0, 0};
+
+  for (std::size_t i = 1; i < length; ++i) {
+    const auto trail = static_cast<unsigned char>(input[offset + i]);
+
+    if ((trail & 0xc0) != 0x80)
+      return {0, 0};
+
+    code = (code << 6) | (trail & 0x3f);
+  }
+
+  return {code, length};
+}
+
+// The grammar also separates identifiers with these
+[[nodiscard]] static bool isPunct(const char32_t c)
+{
+  return Unicode::ispunct(c) || c == U'^' || c == U'"' || c == U'<'
+         || c == U'>';
+}
+
+[[nodiscard]] static bool isIdentifierTail(const char32_t c)
+{
+  return (Unicode::isgraph(c) && !isPunct(c)) || c == U'_';
+}
+
+[[nodiscard]] static bool isIdentifierHead(const char32_t c)
+{
+  // The grammar allows identifiers to start with these, but since tokens do
+  // not depend on where they are, they are operators
+  if (c == U'+' || c == U'=' || c == U'|' || c == U'~')
+    return false;
+
+  return isIdentifierTail(c) && !Unicode::isdigit(c);
+}
+
+constexpr std::uint8_t identifier_head = 1 << 0;
+constexpr std::uint8_t identifier_tail = 1 << 1;
+
+[[nodiscard]] static std::uint8_t classify(const char32_t c)
+{
+  return (isIdentifierHead(c) ? identifier_head : 0)
+         | (isIdentifierTail(c) ? identifier_tail : 0);
+}
+
+// Classes of ASCII characters are looked up instead of classified
+static const auto ascii_classes = [] {
+  std::array<std::uint8_t, 0x80> classes{};
+
+  for (char32_t c = 0; c < classes.size(); ++c)
+    classes[c] = classify(c);
+
+  return classes;
+}();
+
+struct ClassifiedChar {
+  std::uint8_t classes;
+  std::size_t  length;
+};
+
+[[nodiscard]] static ClassifiedChar classifyAt(const std::string_view input,
+                                               const std::size_t      offset)
+{
+  const auto c = static_cast<unsigned char>(input[offset]);
+
+  if (c < 0x80)
+    return {ascii_classes[c], 1};
+
+  const auto decoded = decode(input, offset);
+
+  if (!decoded.length)
+    return {0, 1};
+
+  return {classify(decoded.code), decoded.length};
+}
+
+//===----------------------------------------------------------------------===//
+// Spaces and comments
+//===----------------------------------------------------------------------===//
+
+// Returns the end of the block comment at 'offset', or std::string_view::npos
+// if it is not closed
+// Comments are nested in the same way as the grammar backtracks, where an
+// unclosed inner comment is a part of the outer one
+// The nested comments are kept in a stack, so that deep nesting does not
+// overflow the call stack
+[[nodiscard]] static std::size_t
+findBlockCommentEnd(const std::string_view input, const std::size_t offset)
+{
+  // Beginnings of the comments that are not closed at 'pos'
+  std::vector<std::size_t> open_comments{offset};
+
+  // Beginnings of the comments that are never closed, which are skipped when
+  // scanned again
+  std::unordered_set<std::size_t> unclosed;
+
+  for (auto pos = offset + 2;;) {
+    if (pos >= input.size()) {
+      // The innermost comment is not closed, so its '/' is a character of the
+      // enclosing one
+      pos = open_comments.back() + 1;
+      unclosed.insert(open_comments.back());
+      open_comments.pop_back();
+
+      if (open_comments.empty())
+        return std::string_view::npos;
+
+      continue;
+    }
+
+    if (input.compare(pos, 2, "*/") == 0) {
+      pos += 2;
+      open_comments.pop_back();
+
+      if (open_comments.empty())
+        return pos;
+
+      continue;
+    }
+
+    if (input.compare(pos, 2, "/*") == 0 && !unclosed.contains(pos)) {
+      open_comments.push_back(pos);
+      pos += 2;
+      continue;
+    }
+
+    ++pos;
+  }
+}
+
+[[nodiscard]] std::size_t skipSpaces(const std::string_view input,
+                                     std::size_t            offset)
+{
+  const auto size = input.size();
+
+  while (offset < size) {
+    switch (input[offset]) {
+    // Only ASCII spaces are skipped
+    case ' ':
+    case '\t':
+    case '\n':
+    case '\v':
+    case '\f':
+    case '\r':
+      ++offset;
+      continue;
+    case '/':
+      if (input.compare(offset, 2, "//") == 0) {
+        offset = std::min(input.find_first_of("\r\n", offset), size);
+        continue;
+      }
+
+      if (input.compare(offset, 2, "/*") == 0) {
+        if (const auto end = findBlockCommentEnd(input, offset);
+            end != std::string_view::npos) {
+          offset = end;
+          continue;
+        }
+      }
+
+      return offset;
+    default:
+      return offset;
+    }
+  }
+
+  return offset;
+}
+
+[[nodiscard]] bool isSpace(const std::string_view input,
+                           const std::size_t      offset)
+{
+  if (offset == input.size())
+    return false;
+
+  const auto decoded = decode(input, offset);
+  return decoded.length && Unicode::isspace(decoded.code);
+}
+
+//===----------------------------------------------------------------------===//
+// Literals
+//===----------------------------------------------------------------------===//
+
+[[nodiscard]] static std::optional<char32_t>
+readEscapeSequence(const std::string_view input, std::size_t& offset)
+{
+  const auto first = input.data() + offset + 1; // After the backslash
+  const auto last  = input.data() + input.size();
+
+  char value;
+
+  // Octal
+  if (auto iter = first;
+      x3::parse(iter, last, x3::int_parser<char, 8, 1, 3>{}, value)) {
+    offset = iter - input.data();
+    return static_cast<unsigned char>(value);
+  }
+
+  // Hexadecimal
+  if (auto iter = first;
+      x3::parse(iter, last, x3::lit('x') >> x3::int_parser<char, 16, 2, 2>{},
+                value)) {
+    offset = iter - input.data();
+    return static_cast<unsigned char>(value);
+  }
+
+  if (first == last)
+    return std::nullopt;
+
+  std::optional<char32_t> escaped;
+
+  switch (*first) {
+  case 'a':
+    escaped = U'\a';
+    break;
+  case 'b':
+    escaped = U'\b';
+    break;
+  case 'f':
+    escaped = U'\f';
+    break;
+  case 'n':
+    escaped = U'\n';
+    break;
+  case 'r':
+    escaped = U'\r';
+    break;
+  case 't':
+    escaped = U'\t';
+    break;
+  case 'v':
+    escaped = U'\v';
+    break;
+  case '\\':
+    escaped = U'\\';
+    break;
+  case '\'':
+    escaped = U'\'';
+    break;
+  case '"':
+    escaped = U'"';
+    break;
+  default:
+    return std::nullopt;
+  }
+
+  offset += 2;
+  return escaped;
+}
+
+[[nodiscard]] std::optional<char32_t> readLiteralChar(
+  const std::string_view input,
+  std::size_t&           offset,
+  const char             quote)
+{
+  if (offset == input.size())
+    return std::nullopt;
+
+  const auto c = input[offset];
+
+  if (c == quote || c == '\r' || c == '\n')
+    return std::nullopt;
+
+  if (c == '\\')
+    return readEscapeSequence(input, offset);
+
+  const auto decoded = decode(input, offset);
+
+  if (!decoded.length)
+    return std::nullopt;
+
+  offset += decoded.length;
+  return decoded.code;
+}
+
+[[nodiscard]] std::optional<NumberValue>
+readNumber(const std::string_view input, std::size_t& offset)
+{
+  const auto first = input.data() + offset;
+  const auto last  = input.data() + input.size();
+
+  std::optional<NumberValue> value;
+
+  const auto read = [&](const auto& parser, auto attr) {
+    auto iter = first;
+
+    if (!x3::parse(iter, last, parser, attr))
+      return false;
+
+    offset += iter - first;
+    value = attr;
+    return true;
+  };
+
+  // In the same order as the grammar
+  // clang-format off
+  read(x3::real_parser<double, x3::strict_real_policies<double>>{}, double{})
+    || read(x3::lit("0b") >> x3::uint_parser<std::uint32_t, 2>{},
+            std::uint32_t{})
+    || read(x3::lit('0') >> x3::uint_parser<std::uint32_t, 8>{},
+            std::uint32_t{})
+    || read(x3::lit("0x") >> x3::uint_parser<std::uint32_t, 16>{},
+            std::uint32_t{})
+    || read(x3::int32, std::int32_t{})
+    || read(x3::uint32, std::uint32_t{})
+    || read(x3::int64, std::int64_t{})
+    || read(x3::uint64, std::uint64_t{});
+  // clang-format on
+
+  return value;
+}
+
+[[nodiscard]] std::size_t scanPath(const std::string_view input,
+                                   std::size_t            offset)
+{
+  for (bool head = true; offset < input.size(); head = false) {
+    const auto decoded = decode(input, offset);
+
+    if (!decoded.length)
+      break;
+
+    const auto c = decoded.code;
+
+    if (c != U'.' && c != U'/'
+        && !(isIdentifierTail(c) && !(head && Unicode::isdigit(c))))
+      break;
+
+    offset += decoded.length;
+  }
+
+  return offset;
+}
+
+//===----------------------------------------------------------------------===//
+// Tokenizer
+//===----------------------------------------------------------------------===//
+
+[[nodiscard]] static Token lexStringLiteral(const std::string_view input,
+                                            const std::size_t      offset)
+{
+  auto last = offset + 1;
+
+  while (readLiteralChar(input, last, '"'))
+    ;
+
+  if (last != input.size() && input[last] == '"')
+    return {TokenKind::string_literal, offset, last + 1};
+
+  return {TokenKind::unterminated_string_literal, offset, last};
+}
+
+// Spaces and comments are skipped inside the quotes as the grammar does
+[[nodiscard]] static Token lexCharLiteral(const std::string_view input,
+                                          const std::size_t      offset)
+{
+  auto last = skipSpaces(input, offset + 1);
+
+  if (!readLiteralChar(input, last, '\''))
+    return {TokenKind::punct, offset, offset + 1};
+
+  last = skipSpaces(input, last);
+
+  if (last != input.size() && input[last] == '\'')
+    return {TokenKind::char_literal, offset, last + 1};
+
+  return {TokenKind::unterminated_char_literal, offset, last};
+}
+
+[[nodiscard]] static Token lexToken(const std::string_view input,
+                                    const std::size_t      offset)
+{
+  const auto c = input[offset];
+
+  if ('0' <= c && c <= '9') {
+    // Digits that are not a number are left to the parser to report
+    if (auto last = offset; readNumber(input, last))
+      return {TokenKind::number, offset, last};
+
+    return {TokenKind::punct, offset, offset + 1};
+  }
+
+  if (c == '"')
+    return lexStringLiteral(input, offset);
+
+  if (c == '\'')
+    return lexCharLiteral(input, offset);
+
+  const auto head = classifyAt(input, offset);
+
+  if (!(head.classes & identifier_head))
+    return {TokenKind::punct, offset, offset + head.length};
+
+  auto last = offset + head.length;
+
+  while (last != input.size()) {
+    const auto tail = classifyAt(input, last);
+
+    if (!(tail.classes & identifier_tail))
+      break;
+
+    last += tail.length;
+  }
+
+  return {TokenKind::identifier, offset, last};
+}
+
+[[nodiscard]] std::vector<Token> tokenize(const std::string_view input)
+{
+  std::vector<Token> tokens;
+
+  for (auto offset = skipSpaces(input, 0); offset != input.size();
+       offset      = skipSpaces(input, tokens.back().last))
+    tokens.push_back(lexToken(input, offset));
+
+  tokens.push_back({TokenKind::eoi, input.size(), input.size()});
+
+  return tokens;
+}
+
+} // namespace twinkle::parse
@@ -8,9 +8,11 @@
 #include <twinkle/pch/pch.hpp>
 #include <twinkle/ast/ast_adapted.hpp>
 #include <twinkle/parse/parser.hpp>
+#include <twinkle/parse/recursive_descent.hpp>
 #include <twinkle/codegen/type.hpp>
 #include <twinkle/codegen/kind.hpp>
 #include <twinkle/parse/exception.hpp>
+#include <cwctype>
 
 namespace x3     = boost::spirit::x3;
 namespace fusion = boost::fusion;
@@ -22,6 +24,33 @@ namespace twinkle::parse
 // Error handling
 //===----------------------------------------------------------------------===//
 
+// Tag used to get the diagnostic of the syntax error from the context.
+struct DiagnosticTag;
+
+// Sets the line and column of 'where' to 'diagnostic', the same as those the
+// error handler prints
+template <typename Iterator>
+static void locate(Diagnostic&     diagnostic,
+                   Iterator        first,
+                   Iterator        where,
+                   const Iterator& last)
+{
+  while (where != last && std::iswspace(static_cast<std::wint_t>(*where)))
+    ++where;
+
+  diagnostic.line   = 1;
+  diagnostic.column = 1;
+
+  for (; first != where; ++first) {
+    if (*first == U'\n') {
+      ++diagnostic.line;
+      diagnostic.column = 1;
+    }
+    else
+      ++diagnostic.column;
+  }
+}
+
 struct ErrorHandle {
   template <typename Iterator, typename Context>
   x3::error_handler_result on_error(Iterator&,
@@ -31,9 +60,24 @@ struct ErrorHandle {
   {
     auto& error_handler = x3::get<x3::error_handler_tag>(context).get();
 
-    error_handler(
-      x.where(),
-      formatError("expected: " + boost::core::demangle(x.which().c_str())));
+    const auto message
+      = "expected: " + boost::core::demangle(x.which().c_str());
+
+    error_handler(x.where(), formatError(message));
+
+    auto& diagnostic = x3::get<DiagnosticTag>(context).get();
+
+    // Parsing stops at the first error
+    if (diagnostic.message.empty()) {
+      const auto& position_cache = error_handler.get_position_cache();
+
+      locate(diagnostic,
+             position_cache.first(),
+             x.where(),
+             position_cache.last());
+
+      diagnostic.message = message;
+    }
 
     return x3::error_handler_result::fail;
   }
@@ -43,8 +87,8 @@ struct ErrorHandle {
 // Annotations
 //===----------------------------------------------------------------------===//
 
-// Tag used to get the position cache from the context.
-struct PositionCacheTag;
+// Tag used to get the position table from the context.
+struct PositionTableTag;
 
 struct AnnotatePosition {
   template <typename T, typename Iterator, typename Context>
@@ -53,8 +97,11 @@ struct AnnotatePosition {
                   T&              ast,
                   const Context&  ctx)
   {
-    auto&& position_cache = x3::get<PositionCacheTag>(ctx);
-    position_cache.annotate(ast, first, last);
+    // 'first' is after the spaces skipped before the rule, so a rule that
+    // matched nothing, e.g. empty template parameters, ends before it
+    // Such a node is empty at 'first'
+    auto&& positions = x3::get<PositionTableTag>(ctx);
+    positions.annotate(ast, first, last.base() < first.base() ? first : last);
   }
 };
 
@@ -139,10 +186,8 @@ private:
   {
     // FIXME: There is a bug that causes the position to be annotated one
     // position further than the actual position.
-    auto&& position_cache = x3::get<PositionCacheTag>(ctx);
-    position_cache.annotate(ast,
-                            x3::_where(ctx).begin(),
-                            x3::_where(ctx).end());
+    auto&& positions = x3::get<PositionTableTag>(ctx);
+    positions.annotate(ast, x3::_where(ctx).begin(), x3::_where(ctx).end());
 
     x3::_val(ctx) = std::forward<T>(ast);
   }
@@ -980,32 +1025,101 @@ BOOST_SPIRIT_DEFINE(translation_unit)
 
 } // namespace syntax
 
-Parser::Parser(std::string&& input, const std::filesystem::path& file)
-  : input{std::move(input)}
-  , u32_first{this->input.cbegin()}
-  , u32_last{this->input.cend()}
-  , positions{u32_first, u32_last}
+Parser::Parser(SourceBufferPtr&&            source,
+               const std::filesystem::path& file,
+               const ParserKind             kind,
+               std::ostream&                diagnostics)
+  : source{std::move(source)}
+  , u32_first{this->source->getText().cbegin()}
+  , u32_last{this->source->getText().cend()}
+  , positions{std::make_shared<PositionTable>(this->source)}
   , file{file}
+  , diagnostics{diagnostics}
 {
-  parse();
+  parse(kind);
 }
 
-void Parser::parse()
+Parser::Parser(std::string&&                input,
+               const std::filesystem::path& file,
+               const ParserKind             kind,
+               std::ostream&                diagnostics)
+  : Parser{std::make_shared<const SourceBuffer>(std::move(input)),
+           file,
+           kind,
+           diagnostics}
+{
+}
+
+void Parser::parse(const ParserKind kind)
+{
+  const llvm::TimeTraceScope time_trace_scope{"Parse", file.string()};
+
+  Diagnostic diagnostic{file.string(), 0, 0, {}};
+
+  const auto succeeded = kind == ParserKind::x3
+                           ? parseWithX3(diagnostic)
+                           : parseWithRecursiveDescent(diagnostic);
+
+  // Some error occurred in parsing.
+  if (!succeeded) {
+    throw ParseError{
+      FormattedDiagnostic{"compilation terminated.", std::move(diagnostic)}};
+  }
+}
+
+[[nodiscard]] bool Parser::parseWithX3(Diagnostic& diagnostic)
 {
   x3::error_handler<InputIterator> error_handler{u32_first,
                                                  u32_last,
-                                                 std::cerr,
+                                                 diagnostics,
                                                  file.string()};
 
   const auto parser = x3::with<x3::error_handler_tag>(
-    std::ref(error_handler))[x3::with<PositionCacheTag>(
-    positions)[syntax::translation_unit]];
+    std::ref(error_handler))[x3::with<DiagnosticTag>(std::ref(
+    diagnostic))[x3::with<PositionTableTag>(
+    *positions)[syntax::translation_unit]]];
+
+  const auto first = u32_first;
 
   if (!x3::phrase_parse(u32_first, u32_last, parser, syntax::skipper, ast)
       || u32_first != u32_last) {
-    // Some error occurred in parsing.
-    throw ParseError{"compilation terminated."};
+    // Input that no rule expects is left unparsed
+    if (diagnostic.message.empty()) {
+      locate(diagnostic, first, u32_first, u32_last);
+      diagnostic.message = "unexpected input";
+    }
+
+    return false;
   }
+
+  return true;
+}
+
+[[nodiscard]] bool Parser::parseWithRecursiveDescent(Diagnostic& diagnostic)
+{
+  const auto input = source->getText();
+
+  const auto error = parseRecursiveDescent(input, ast, *positions);
+
+  if (!error)
+    return true;
+
+  const InputIterator where{input.cbegin() + error->where};
+
+  const auto message = "expected: " + error->expected;
+
+  // Written in the same form as the grammar writes it
+  x3::error_handler<InputIterator> error_handler{u32_first,
+                                                 u32_last,
+                                                 diagnostics,
+                                                 file.string()};
+
+  error_handler(where, formatError(message));
+
+  locate(diagnostic, u32_first, where, u32_last);
+  diagnostic.message = message;
+
+  return false;
 }
 
 } // namespace twinkle::parse
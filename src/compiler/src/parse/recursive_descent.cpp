@@ -0,0 +1,1967 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twinkle/pch/pch.hpp>
+#include <twinkle/parse/recursive_descent.hpp>
+#include <twinkle/parse/lexer.hpp>
+#include <twinkle/codegen/type.hpp>
+#include <twinkle/codegen/kind.hpp>
+
+namespace twinkle::parse
+{
+
+//===----------------------------------------------------------------------===//
+// Symbol table
+//===----------------------------------------------------------------------===//
+
+[[nodiscard]] static std::optional<codegen::BuiltinTypeKind>
+getBuiltinTypeKind(const std::string_view name)
+{
+  static const std::unordered_map<std::string_view, codegen::BuiltinTypeKind>
+    kinds = {
+      {"void",  codegen::BuiltinTypeKind::void_},
+      {"i8",    codegen::BuiltinTypeKind::i8   },
+      {"i16",   codegen::BuiltinTypeKind::i16  },
+      {"i32",   codegen::BuiltinTypeKind::i32  },
+      {"i64",   codegen::BuiltinTypeKind::i64  },
+      {"u8",    codegen::BuiltinTypeKind::u8   },
+      {"u16",   codegen::BuiltinTypeKind::u16  },
+      {"u32",   codegen::BuiltinTypeKind::u32  },
+      {"u64",   codegen::BuiltinTypeKind::u64  },
+      {"bool",  codegen::BuiltinTypeKind::bool_},
+      {"char",  codegen::BuiltinTypeKind::char_},
+      {"f64",   codegen::BuiltinTypeKind::f64  },
+      {"f32",   codegen::BuiltinTypeKind::f32  },
+      {"isize", codegen::BuiltinTypeKind::isize},
+      {"usize", codegen::BuiltinTypeKind::usize},
+  };
+
+  if (const auto iter = kinds.find(name); iter != kinds.end())
+    return iter->second;
+
+  return std::nullopt;
+}
+
+[[nodiscard]] static std::optional<codegen::BuiltinMacroKind>
+getBuiltinMacroKind(const std::string_view name)
+{
+  if (name == "__builtin_huge_valf")
+    return codegen::BuiltinMacroKind::huge_valf;
+  if (name == "__builtin_huge_val")
+    return codegen::BuiltinMacroKind::huge_val;
+  if (name == "__builtin_infinity")
+    return codegen::BuiltinMacroKind::infinity_;
+
+  return std::nullopt;
+}
+
+//===----------------------------------------------------------------------===//
+// Parser
+//===----------------------------------------------------------------------===//
+
+// Each function parses the rule of the grammar of the same name, and returns
+// std::nullopt without consuming tokens where the grammar backtracks, or
+// throws SyntaxError where it expects
+struct RecursiveDescentParser : private boost::noncopyable {
+  RecursiveDescentParser(const std::string_view input,
+                         PositionTable&         positions)
+    : input{input}
+    , tokens{tokenize(input)}
+    , positions{positions}
+  {
+  }
+
+  [[nodiscard]] ast::TranslationUnit parseTranslationUnit()
+  {
+    auto top_levels = parseTopLevelList();
+
+    if (peek().kind != TokenKind::eoi)
+      throw SyntaxError{peek().first, "eoi"};
+
+    return top_levels;
+  }
+
+private:
+  struct State {
+    std::size_t index;
+    bool        skipped;
+  };
+
+  //===--------------------------------------------------------------------===//
+  // Tokens
+  //===--------------------------------------------------------------------===//
+
+  [[nodiscard]] const Token& peek(const std::size_t n = 0) const noexcept
+  {
+    return tokens[std::min(index + n, tokens.size() - 1)];
+  }
+
+  [[nodiscard]] std::string_view text(const Token& token) const noexcept
+  {
+    return std::string_view{input}.substr(token.first,
+                                          token.last - token.first);
+  }
+
+  void consume(const std::size_t n = 1) noexcept
+  {
+    index += n;
+    skipped = false;
+  }
+
+  [[nodiscard]] State save() const noexcept
+  {
+    return {index, skipped};
+  }
+
+  void restore(const State& state) noexcept
+  {
+    index   = state.index;
+    skipped = state.skipped;
+  }
+
+  // Operators are consecutive punctuation tokens without spaces between them
+  [[nodiscard]] bool isPunct(const std::string_view op,
+                             const std::size_t      n = 0) const noexcept
+  {
+    for (std::size_t i = 0; i < op.size(); ++i) {
+      const auto& token = peek(n + i);
+
+      if (token.kind != TokenKind::punct || input[token.first] != op[i])
+        return false;
+
+      if (i && peek(n + i - 1).last != token.first)
+        return false;
+    }
+
+    return true;
+  }
+
+  bool acceptPunct(const std::string_view op) noexcept
+  {
+    if (!isPunct(op))
+      return false;
+
+    consume(op.size());
+    return true;
+  }
+
+  // Literals skip the spaces before them even if they fail to match
+  void expectPunct(const std::string_view op)
+  {
+    if (!acceptPunct(op))
+      throw SyntaxError{peek().first, quote(op)};
+  }
+
+  [[nodiscard]] bool isKeyword(const std::string_view keyword,
+                               const std::size_t      n = 0) const noexcept
+  {
+    const auto& token = peek(n);
+    return token.kind == TokenKind::identifier && text(token) == keyword;
+  }
+
+  bool acceptKeyword(const std::string_view keyword) noexcept
+  {
+    if (!isKeyword(keyword))
+      return false;
+
+    consume();
+    return true;
+  }
+
+  // Keywords followed by a space, e.g. 'new'
+  [[nodiscard]] bool isSpacedKeyword(const std::string_view keyword) const
+  {
+    return isKeyword(keyword) && isSpace(input, peek().last);
+  }
+
+  // Rules that failed to match leave the spaces before them
+  [[noreturn]] void fail(std::string&& expected) const
+  {
+    throw SyntaxError{getOffset(), std::move(expected)};
+  }
+
+  [[nodiscard]] static std::string quote(const std::string_view literal)
+  {
+    return fmt::format("\"{}\"", literal);
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Positions
+  //===--------------------------------------------------------------------===//
+
+  // The end of what has been consumed
+  // A literal that failed to match leaves the spaces before the next token
+  // skipped, as the grammar does
+  [[nodiscard]] std::size_t getOffset() const noexcept
+  {
+    if (skipped)
+      return peek().first;
+
+    return index ? tokens[index - 1].last : 0;
+  }
+
+  // A node that consumed nothing is empty at 'first', after the spaces that
+  // 'getOffset' does not include
+  template <typename T>
+  void annotate(T& ast, const std::size_t first)
+  {
+    positions.annotate(ast, first, std::max(first, getOffset()));
+  }
+
+  // Nodes built by semantic actions of the grammar are annotated from the end
+  // of them to the end of the input (see the FIXME in parser.cpp), which is
+  // kept so that diagnostics do not change
+  template <typename T>
+  void annotateAction(T& ast)
+  {
+    positions.annotate(ast, getOffset(), input.size());
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Common rules
+  //===--------------------------------------------------------------------===//
+
+  // Parses 'element % ","'
+  template <typename Container, typename ParseElement>
+  [[nodiscard]] std::optional<Container> parseList(ParseElement parse_element)
+  {
+    auto element = parse_element();
+
+    if (!element)
+      return std::nullopt;
+
+    Container elements;
+    elements.push_back(std::move(*element));
+
+    while (isPunct(",")) {
+      const auto state = save();
+      consume();
+
+      element = parse_element();
+
+      if (!element) {
+        restore(state);
+        break;
+      }
+
+      elements.push_back(std::move(*element));
+    }
+
+    return elements;
+  }
+
+  [[nodiscard]] std::optional<ast::Identifier> parseIdentifier()
+  {
+    const auto& token = peek();
+
+    if (token.kind != TokenKind::identifier)
+      return std::nullopt;
+
+    const auto name = text(token);
+
+    if (name == "true" || name == "false" || name == "nullptr")
+      return std::nullopt;
+
+    consume();
+
+    ast::Identifier identifier{name};
+    annotate(identifier, token.first);
+    return identifier;
+  }
+
+  [[nodiscard]] std::optional<VariableQual> acceptVariableQualifier()
+  {
+    if (acceptKeyword("mut"))
+      return VariableQual::mutable_;
+
+    return std::nullopt;
+  }
+
+  [[nodiscard]] std::optional<ast::Expr> parseNumber()
+  {
+    const auto& token = peek();
+
+    auto offset = token.first;
+
+    if (token.kind == TokenKind::number) {
+      const auto value = readNumber(input, offset);
+      assert(value && offset == token.last);
+
+      consume();
+      return std::visit([](const auto n) { return ast::Expr{n}; }, *value);
+    }
+
+    // Floating point numbers without the integer part, e.g. '.5'
+    if (isPunct(".") && peek(1).kind == TokenKind::number
+        && peek(1).first == token.last) {
+      if (const auto value = readNumber(input, offset);
+          value && offset == peek(1).last) {
+        consume(2);
+        return std::visit([](const auto n) { return ast::Expr{n}; }, *value);
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  [[nodiscard]] std::optional<ast::StringLiteral> parseStringLiteral()
+  {
+    const auto& token = peek();
+
+    if (token.kind == TokenKind::unterminated_string_literal)
+      throw SyntaxError{token.last, quote("\"")};
+
+    if (token.kind != TokenKind::string_literal)
+      return std::nullopt;
+
+    ast::StringLiteral literal;
+
+    for (auto offset = token.first + 1;
+         const auto c = readLiteralChar(input, offset, '"');)
+      literal.str.push_back(*c);
+
+    consume();
+    annotate(literal, token.first);
+    return literal;
+  }
+
+  [[nodiscard]] std::optional<ast::CharLiteral> parseCharLiteral()
+  {
+    const auto& token = peek();
+
+    if (token.kind == TokenKind::unterminated_char_literal)
+      throw SyntaxError{token.last, quote("'")};
+
+    if (token.kind != TokenKind::char_literal)
+      return std::nullopt;
+
+    auto offset = skipSpaces(input, token.first + 1);
+
+    ast::CharLiteral literal;
+    literal.ch = *readLiteralChar(input, offset, '\'');
+
+    consume();
+    annotate(literal, token.first);
+    return literal;
+  }
+
+  [[nodiscard]] std::optional<ast::Attrs> parseAttribute()
+  {
+    if (!isPunct("[[") || peek(2).kind != TokenKind::identifier)
+      return std::nullopt;
+
+    consume(2);
+
+    ast::Attrs attrs;
+
+    for (;;) {
+      attrs.push_back(unicode::utf8toUtf32(text(peek())));
+      consume();
+
+      if (!isPunct(",") || peek(1).kind != TokenKind::identifier)
+        break;
+
+      consume();
+    }
+
+    expectPunct("]]");
+    return attrs;
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Type rules
+  //===--------------------------------------------------------------------===//
+
+  [[nodiscard]] std::optional<ast::Type> parseTypeName()
+  {
+    if (auto type = parseArrayType())
+      return type;
+
+    const auto first = peek().first;
+
+    if (!acceptPunct("&"))
+      return std::nullopt;
+
+    auto refee_type = parseArrayType();
+
+    if (!refee_type)
+      fail("array type");
+
+    ast::ReferenceType type{std::move(*refee_type)};
+    annotate(type, first);
+    return type;
+  }
+
+  [[nodiscard]] std::optional<ast::Type> parseArrayType()
+  {
+    auto type = parsePointerType();
+
+    if (!type)
+      return std::nullopt;
+
+    while (isPunct("[") && peek(1).kind == TokenKind::number
+           && isPunct("]", 2)) {
+
+      const auto& size_token = peek(1);
+
+      auto          iter = input.cbegin() + size_token.first;
+      const auto    last = input.cbegin() + size_token.last;
+      std::uint64_t size;
+
+      // The size is not a number of another type, e.g. a floating point
+      if (!boost::spirit::x3::parse(iter, last, boost::spirit::x3::uint64, size)
+          || iter != last)
+        break;
+
+      consume(3);
+
+      ast::ArrayType array_type{std::move(*type), size};
+      annotateAction(array_type);
+      type = std::move(array_type);
+    }
+
+    return type;
+  }
+
+  [[nodiscard]] std::optional<ast::Type> parsePointerType()
+  {
+    if (auto type = parseTypePrimary())
+      return type;
+
+    const auto first = peek().first;
+
+    std::vector<boost::blank> n_ops;
+
+    while (acceptPunct("^"))
+      n_ops.emplace_back();
+
+    if (n_ops.empty())
+      return std::nullopt;
+
+    skipped = true;
+
+    auto pointee_type = parseTypePrimary();
+
+    if (!pointee_type)
+      fail("type primary");
+
+    ast::PointerType type{std::move(n_ops), std::move(*pointee_type)};
+    annotate(type, first);
+    return type;
+  }
+
+  [[nodiscard]] std::optional<ast::Type> parseTypePrimary()
+  {
+    const auto& token = peek();
+
+    if (token.kind == TokenKind::identifier) {
+      if (const auto kind = getBuiltinTypeKind(text(token))) {
+        consume();
+
+        ast::BuiltinType type{*kind};
+        annotate(type, token.first);
+        return type;
+      }
+
+      if (auto type = parseUserDefinedType()) {
+        if (auto template_args = parseTemplateArgs()) {
+          ast::UserDefinedTemplateType template_type{std::move(*type),
+                                                     std::move(*template_args)};
+          annotate(template_type, token.first);
+          return template_type;
+        }
+
+        return type;
+      }
+    }
+
+    if (isPunct("(")) {
+      const auto state = save();
+      consume();
+
+      if (auto type = parseTypeName(); type && acceptPunct(")"))
+        return type;
+
+      restore(state);
+    }
+
+    return std::nullopt;
+  }
+
+  [[nodiscard]] std::optional<ast::UserDefinedType> parseUserDefinedType()
+  {
+    const auto first = peek().first;
+
+    auto name = parseIdentifier();
+
+    if (!name)
+      return std::nullopt;
+
+    ast::UserDefinedType type{std::move(*name)};
+    annotate(type, first);
+    return type;
+  }
+
+  [[nodiscard]] std::optional<ast::TemplateArguments> parseTemplateArgs()
+  {
+    if (!isPunct("<"))
+      return std::nullopt;
+
+    const auto state = save();
+    const auto first = peek().first;
+    consume();
+
+    auto types = parseList<ast::TemplateArguments::Types>(
+      [this] { return parseTypeName(); });
+
+    if (!types || !acceptPunct(">")) {
+      restore(state);
+      return std::nullopt;
+    }
+
+    ast::TemplateArguments template_args;
+    template_args.types = std::move(*types);
+    annotate(template_args, first);
+    return template_args;
+  }
+
+  // Types in an expression are parsed speculatively, e.g. whether '<' begins
+  // template arguments or is a comparison is known only after parsing them, so
+  // a syntax error in them is not one of the expression
+  template <typename T>
+  [[nodiscard]] std::optional<T>
+  speculate(std::optional<T> (RecursiveDescentParser::*parse)())
+  {
+    const auto state = save();
+
+    try {
+      return (this->*parse)();
+    }
+    catch (const SyntaxError&) {
+      restore(state);
+      return std::nullopt;
+    }
+  }
+
+  [[nodiscard]] std::optional<ast::TemplateArguments> tryParseTemplateArgs()
+  {
+    return speculate(&RecursiveDescentParser::parseTemplateArgs);
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Expression rules
+  //===--------------------------------------------------------------------===//
+
+  struct BinaryOperator {
+    // The higher, the tighter
+    int precedence;
+
+    std::size_t length;
+  };
+
+  static constexpr int pipeline_precedence = 6;
+
+  // Names of the rules of the right operands
+  static constexpr std::array<const char*, 10> rhs_rule_names = {
+    nullptr,
+    "equality operation",
+    "relational operation",
+    "bitwise or operation",
+    "bitwise and operation",
+    "pipeline operation",
+    "bitwise shift operation",
+    "addition operation",
+    "multiplication operation",
+    "cast opeartion",
+  };
+
+  [[nodiscard]] std::optional<BinaryOperator> peekBinaryOperator() const
+  {
+    if (peek().kind != TokenKind::punct)
+      return std::nullopt;
+
+    switch (input[peek().first]) {
+    case '&':
+      return isPunct("&&") ? BinaryOperator{1, 2} : BinaryOperator{5, 1};
+    case '|':
+      if (isPunct("||"))
+        return BinaryOperator{1, 2};
+      if (isPunct("|>"))
+        return BinaryOperator{pipeline_precedence, 2};
+      return BinaryOperator{4, 1};
+    case '=':
+      return isPunct("==") ? std::optional{BinaryOperator{2, 2}}
+                           : std::nullopt;
+    case '!':
+      return isPunct("!=") ? std::optional{BinaryOperator{2, 2}}
+                           : std::nullopt;
+    case '<':
+      if (isPunct("<="))
+        return BinaryOperator{3, 2};
+      if (isPunct("<<"))
+        return BinaryOperator{7, 2};
+      return BinaryOperator{3, 1};
+    case '>':
+      if (isPunct(">="))
+        return BinaryOperator{3, 2};
+      if (isPunct(">>"))
+        return BinaryOperator{7, 2};
+      return BinaryOperator{3, 1};
+    case '+':
+    case '-':
+    case '*':
+    case '/':
+    case '%':
+      // Compound assignment operators
+      if (isPunct("=", 1) && peek().last == peek(1).first)
+        return std::nullopt;
+
+      return input[peek().first] == '+' || input[peek().first] == '-'
+               ? BinaryOperator{8, 1}
+               : BinaryOperator{9, 1};
+    default:
+      return std::nullopt;
+    }
+  }
+
+  [[nodiscard]] std::optional<ast::Expr> parseExpr()
+  {
+    return parseBinary(1);
+  }
+
+  // Operators of the same precedence are left associative
+  [[nodiscard]] std::optional<ast::Expr> parseBinary(const int min_precedence)
+  {
+    auto lhs = parseCast();
+
+    if (!lhs)
+      return std::nullopt;
+
+    for (;;) {
+      const auto op = peekBinaryOperator();
+
+      if (!op || op->precedence < min_precedence)
+        return lhs;
+
+
+      auto op_str = unicode::utf8toUtf32(
+        std::string_view{input}.substr(peek().first, op->length));
+      consume(op->length);
+
+      auto rhs = parseBinary(op->precedence + 1);
+
+      if (!rhs)
+        fail(rhs_rule_names[op->precedence]);
+
+      if (op->precedence == pipeline_precedence) {
+        ast::Pipeline pipeline{std::move(*lhs),
+                               std::move(op_str),
+                               std::move(*rhs)};
+        annotateAction(pipeline);
+        lhs = std::move(pipeline);
+      }
+      else {
+        ast::BinOp bin_op{std::move(*lhs), std::move(op_str), std::move(*rhs)};
+        annotateAction(bin_op);
+        lhs = std::move(bin_op);
+      }
+    }
+  }
+
+  [[nodiscard]] std::optional<ast::Expr> parseCast()
+  {
+    auto lhs = parseUnary();
+
+    if (!lhs)
+      return std::nullopt;
+
+    while (isKeyword("as")) {
+      consume();
+
+      auto type = parseTypeName();
+
+      if (!type)
+        fail("type name");
+
+      ast::Cast cast{std::move(*lhs), std::move(*type)};
+      annotateAction(cast);
+      lhs = std::move(cast);
+    }
+
+    return lhs;
+  }
+
+  [[nodiscard]] std::optional<ast::Expr> parseUnary()
+  {
+    const auto& token = peek();
+
+    const auto is_unary_operator
+      = (token.kind == TokenKind::punct
+         && std::string_view{"+-!*&"}.find(input[token.first])
+              != std::string_view::npos)
+        || isKeyword("sizeof");
+
+    if (is_unary_operator) {
+      const auto state = save();
+      consume();
+
+      if (auto operand = parseReference()) {
+        ast::UnaryOp unary_op{unicode::utf8toUtf32(text(token)),
+                              std::move(*operand)};
+        annotate(unary_op, token.first);
+        return unary_op;
+      }
+
+      restore(state);
+    }
+
+    return parseReference();
+  }
+
+  [[nodiscard]] std::optional<ast::Expr> parseReference()
+  {
+    if (!isSpacedKeyword("ref"))
+      return parseNew();
+
+    const auto first = peek().first;
+    consume();
+
+    auto operand = parseNew();
+
+    if (!operand)
+      fail("new operation");
+
+    ast::Reference reference;
+    reference.operand = std::move(*operand);
+    annotate(reference, first);
+    return reference;
+  }
+
+  [[nodiscard]] std::optional<ast::Expr> parseNew()
+  {
+    if (!isSpacedKeyword("new"))
+      return parseDelete();
+
+    const auto first = peek().first;
+    consume();
+
+    ast::New new_;
+
+    auto type = parseTypeName();
+
+    if (!type)
+      fail("type name");
+
+    new_.type = std::move(*type);
+
+    new_.with_init = acceptPunct("{");
+
+    if (!new_.with_init)
+      skipped = true;
+
+    const auto state = save();
+
+    if (auto initializer = parseList<std::vector<ast::Expr>>(
+          [this] { return parseExpr(); })) {
+      expectPunct("}");
+      new_.initializer = std::move(*initializer);
+    }
+    else
+      restore(state);
+
+    annotate(new_, first);
+    return new_;
+  }
+
+  [[nodiscard]] std::optional<ast::Expr> parseDelete()
+  {
+    if (!isSpacedKeyword("delete"))
+      return parseMemberAccess();
+
+    const auto first = peek().first;
+    consume();
+
+    auto operand = parseExpr();
+
+    if (!operand)
+      fail("expression");
+
+    ast::Delete delete_;
+    delete_.operand = std::move(*operand);
+    annotate(delete_, first);
+    return delete_;
+  }
+
+  [[nodiscard]] std::optional<ast::Expr> parseMemberAccess()
+  {
+    auto lhs = parseSubscript();
+
+    if (!lhs)
+      return std::nullopt;
+
+    while (isPunct(".")) {
+      consume();
+
+      auto rhs = parseSubscript();
+
+      if (!rhs)
+        fail("subscript operation");
+
+      ast::MemberAccess member_access{std::move(*lhs), std::move(*rhs)};
+      annotateAction(member_access);
+      lhs = std::move(member_access);
+    }
+
+    return lhs;
+  }
+
+  [[nodiscard]] std::optional<ast::Expr> parseSubscript()
+  {
+    auto lhs = parseDereference();
+
+    if (!lhs)
+      return std::nullopt;
+
+    while (isPunct("[")) {
+      consume();
+
+      auto subscript = parseExpr();
+
+      if (!subscript)
+        fail("expression");
+
+      expectPunct("]");
+
+      ast::Subscript node{std::move(*lhs), std::move(*subscript)};
+      annotateAction(node);
+      lhs = std::move(node);
+    }
+
+    return lhs;
+  }
+
+  [[nodiscard]] std::optional<ast::Expr> parseDereference()
+  {
+    auto operand = parseScopeResolution();
+
+    if (!operand)
+      return std::nullopt;
+
+    while (isPunct("^")) {
+      consume();
+
+      ast::Dereference dereference{std::move(*operand)};
+      annotateAction(dereference);
+      operand = std::move(dereference);
+    }
+
+    skipped = true;
+    return operand;
+  }
+
+  [[nodiscard]] std::optional<ast::Expr> parseScopeResolution()
+  {
+    auto lhs = parseFunctionCall();
+
+    if (!lhs)
+      return std::nullopt;
+
+    while (isPunct("::")) {
+      consume(2);
+
+      auto rhs = parseFunctionCall();
+
+      if (!rhs)
+        fail("function call");
+
+      ast::ScopeResolution scope_resolution{std::move(*lhs), std::move(*rhs)};
+      annotateAction(scope_resolution);
+      lhs = std::move(scope_resolution);
+    }
+
+    return lhs;
+  }
+
+  [[nodiscard]] std::deque<ast::Expr> parseArgList()
+  {
+    auto args
+      = parseList<std::deque<ast::Expr>>([this] { return parseExpr(); });
+
+    return args ? std::move(*args) : std::deque<ast::Expr>{};
+  }
+
+  [[nodiscard]] std::optional<ast::Expr> parseFunctionCall()
+  {
+    auto callee = parseFunctionTemplateCall();
+
+    if (!callee)
+      return std::nullopt;
+
+    while (isPunct("(")) {
+      consume();
+
+      auto args = parseArgList();
+      expectPunct(")");
+
+      ast::FunctionCall call{std::move(*callee), std::move(args)};
+      annotateAction(call);
+      callee = std::move(call);
+    }
+
+    return callee;
+  }
+
+  [[nodiscard]] std::optional<ast::Expr> parseFunctionTemplateCall()
+  {
+    auto callee = parsePrimary();
+
+    if (!callee)
+      return std::nullopt;
+
+    for (;;) {
+
+      auto template_args = tryParseTemplateArgs();
+
+      if (!template_args)
+        return callee;
+
+      expectPunct("(");
+
+      auto args = parseArgList();
+      expectPunct(")");
+
+      ast::FunctionTemplateCall call{std::move(*callee),
+                                     std::move(*template_args),
+                                     std::move(args)};
+      annotateAction(call);
+      callee = std::move(call);
+    }
+  }
+
+  [[nodiscard]] std::optional<ast::Expr> parsePrimary()
+  {
+    const auto& token = peek();
+
+    if (isKeyword("nullptr")) {
+      consume();
+
+      ast::NullPointer null_pointer;
+      annotate(null_pointer, token.first);
+      return null_pointer;
+    }
+
+    if (token.kind == TokenKind::identifier) {
+      if (const auto kind = getBuiltinMacroKind(text(token))) {
+        consume();
+
+        ast::BuiltinMacro builtin_macro;
+        builtin_macro.kind = *kind;
+        annotate(builtin_macro, token.first);
+        return builtin_macro;
+      }
+    }
+
+    // Size of type or class literal
+    if (const auto state = save();
+        auto type = speculate(&RecursiveDescentParser::parseTypeName)) {
+      if (isPunct(".") && isKeyword("sizeof", 1)) {
+        consume(2);
+
+        ast::SizeOfType size_of_type;
+        size_of_type.type = std::move(*type);
+        annotate(size_of_type, token.first);
+        return size_of_type;
+      }
+
+      if (acceptPunct("{")) {
+        ast::ClassLiteral class_literal;
+        class_literal.type = std::move(*type);
+
+        if (auto initializer_list = parseList<std::vector<ast::Expr>>(
+              [this] { return parseExpr(); }))
+          class_literal.initializer_list = std::move(*initializer_list);
+
+        expectPunct("}");
+
+        annotate(class_literal, token.first);
+        return class_literal;
+      }
+
+      restore(state);
+    }
+
+    if (auto identifier = parseIdentifier())
+      return *identifier;
+
+    if (auto number = parseNumber())
+      return number;
+
+    if (acceptKeyword("true"))
+      return true;
+
+    if (acceptKeyword("false"))
+      return false;
+
+    if (auto string_literal = parseStringLiteral())
+      return *string_literal;
+
+    if (auto char_literal = parseCharLiteral())
+      return *char_literal;
+
+    if (acceptPunct("[")) {
+      auto elements
+        = parseList<std::vector<ast::Expr>>([this] { return parseExpr(); });
+
+      if (!elements)
+        fail("expression");
+
+      expectPunct("]");
+
+      ast::ArrayLiteral array_literal;
+      array_literal.elements = std::move(*elements);
+      annotate(array_literal, token.first);
+      return array_literal;
+    }
+
+    if (auto template_args = tryParseTemplateArgs())
+      return *template_args;
+
+    if (acceptPunct("(")) {
+      auto expr = parseExpr();
+
+      if (!expr)
+        fail("expression");
+
+      expectPunct(")");
+      return expr;
+    }
+
+    return std::nullopt;
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Statement rules
+  //===--------------------------------------------------------------------===//
+
+  [[nodiscard]] std::optional<ast::Stmt> parseStmt()
+  {
+    // Null statement
+    if (acceptPunct(";"))
+      return ast::Stmt{};
+
+    if (acceptPunct("{")) {
+      ast::CompoundStatement statements;
+
+      while (auto statement = parseStmt())
+        statements.push_back(std::move(*statement));
+
+      expectPunct("}");
+      return statements;
+    }
+
+    if (isKeyword("loop"))
+      return parseLoop();
+
+    if (isKeyword("while"))
+      return parseWhile();
+
+    if (isKeyword("for"))
+      return parseFor();
+
+    if (isKeyword("if"))
+      return parseIf();
+
+    return parseSimpleStmt();
+  }
+
+  // Statements that begin with an expression, or a keyword that can also be
+  // an identifier
+  [[nodiscard]] std::optional<ast::Stmt> parseSimpleStmt()
+  {
+    const auto state = save();
+    const auto first = peek().first;
+
+    // The grammar tries a match statement first, and if the expression is
+    // wrong, the error is reported if no other statement matches either
+    std::optional<ast::Expr>   expr;
+    std::optional<SyntaxError> expr_error;
+
+    try {
+      expr = parseExpr();
+    }
+    catch (SyntaxError& err) {
+      expr_error = std::move(err);
+      restore(state);
+    }
+
+    const auto after_expr = save();
+
+    try {
+      if (expr && isKeyword("match"))
+        return parseMatch(std::move(*expr), first);
+
+      restore(state);
+
+      if (isKeyword("break") && isPunct(";", 1)) {
+        consume();
+
+        ast::Break break_;
+        annotate(break_, first);
+
+        consume();
+        return break_;
+      }
+
+      if (isKeyword("continue") && isPunct(";", 1)) {
+        consume();
+
+        ast::Continue continue_;
+        annotate(continue_, first);
+
+        consume();
+        return continue_;
+      }
+
+      if (acceptKeyword("return")) {
+        ast::Return return_;
+        return_.rhs = parseExpr();
+        annotate(return_, first);
+
+        if (acceptPunct(";"))
+          return return_;
+
+        restore(state);
+      }
+
+      if (isPunct("++") || isPunct("--")) {
+        auto prefix = parsePrefixIncrementDecrement();
+
+        if (acceptPunct(";"))
+          return prefix;
+
+        restore(state);
+      }
+
+      if (expr) {
+        restore(after_expr);
+
+        if (auto assignment = parseAssignmentRhs(std::move(*expr), first);
+            assignment && acceptPunct(";"))
+          return *assignment;
+
+        restore(state);
+      }
+
+      if (isKeyword("let")) {
+        auto variable_def = parseVariableDef();
+
+        if (acceptPunct(";"))
+          return variable_def;
+
+        restore(state);
+      }
+
+      if (expr) {
+        restore(after_expr);
+
+        // The expression has not been moved if it is not followed by an
+        // assignment operator
+        if (acceptPunct(";"))
+          return *expr;
+
+        restore(state);
+      }
+    }
+    catch (const SyntaxError&) {
+      if (expr_error)
+        throw *expr_error;
+
+      throw;
+    }
+
+    if (expr_error)
+      throw *expr_error;
+
+    return std::nullopt;
+  }
+
+  [[nodiscard]] ast::Match parseMatch(ast::Expr&& target,
+                                      const std::size_t first)
+  {
+    consume();
+    expectPunct("{");
+
+    ast::Match match;
+    match.target = std::move(target);
+
+    while (auto match_case = parseMatchCase())
+      match.cases.push_back(std::move(*match_case));
+
+    expectPunct("}");
+
+    annotate(match, first);
+    return match;
+  }
+
+  [[nodiscard]] std::optional<ast::MatchCase> parseMatchCase()
+  {
+    const auto first = peek().first;
+
+    auto match_case = parseExpr();
+
+    if (!match_case)
+      return std::nullopt;
+
+    expectPunct("=>");
+
+    auto statement = parseStmt();
+
+    if (!statement)
+      fail("statement");
+
+    ast::MatchCase node;
+    node.match_case = std::move(*match_case);
+    node.statement  = std::move(*statement);
+    annotate(node, first);
+    return node;
+  }
+
+  [[nodiscard]] std::optional<std::u32string> acceptAssignmentOperator()
+  {
+    for (const std::string_view op : {"=", "+=", "-=", "*=", "/=", "%="}) {
+      if (acceptPunct(op))
+        return unicode::utf8toUtf32(op);
+    }
+
+    return std::nullopt;
+  }
+
+  // The left operand has been parsed
+  [[nodiscard]] std::optional<ast::Assignment>
+  parseAssignmentRhs(ast::Expr&& lhs, const std::size_t first)
+  {
+    auto op = acceptAssignmentOperator();
+
+    if (!op)
+      return std::nullopt;
+
+    auto rhs = parseExpr();
+
+    if (!rhs)
+      fail("expression");
+
+    ast::Assignment assignment{std::move(lhs), std::move(*op), std::move(*rhs)};
+    annotate(assignment, first);
+    return assignment;
+  }
+
+  [[nodiscard]] std::optional<ast::Assignment> parseAssignment()
+  {
+    const auto state = save();
+    const auto first = peek().first;
+
+    if (auto lhs = parseExpr()) {
+      if (auto assignment = parseAssignmentRhs(std::move(*lhs), first))
+        return assignment;
+    }
+
+    restore(state);
+    return std::nullopt;
+  }
+
+  [[nodiscard]] ast::PrefixIncrementDecrement parsePrefixIncrementDecrement()
+  {
+    const auto first = peek().first;
+
+    ast::PrefixIncrementDecrement prefix;
+    prefix.op = isPunct("++") ? U"++" : U"--";
+    consume(2);
+
+    auto operand = parseExpr();
+
+    if (!operand)
+      fail("expression");
+
+    prefix.operand = std::move(*operand);
+    annotate(prefix, first);
+    return prefix;
+  }
+
+  [[nodiscard]] ast::VariableDef parseVariableDef()
+  {
+    const auto first = peek().first;
+    consume();
+
+    ast::VariableDef variable_def;
+    variable_def.qualifier = acceptVariableQualifier();
+
+    auto name = parseIdentifier();
+
+    if (!name)
+      fail("identifier");
+
+    variable_def.name = std::move(*name);
+
+    if (acceptPunct(":")) {
+      variable_def.type = parseTypeName();
+
+      if (!variable_def.type)
+        fail("type name");
+    }
+
+    if (acceptPunct("=")) {
+      variable_def.initializer = parseExpr();
+
+      if (!variable_def.initializer)
+        fail("expression");
+    }
+
+    annotate(variable_def, first);
+    return variable_def;
+  }
+
+  [[nodiscard]] ast::Stmt expectStmt()
+  {
+    auto statement = parseStmt();
+
+    if (!statement)
+      fail("statement");
+
+    return std::move(*statement);
+  }
+
+  [[nodiscard]] ast::Expr expectParenthesizedExpr()
+  {
+    expectPunct("(");
+
+    auto expr = parseExpr();
+
+    if (!expr)
+      fail("expression");
+
+    expectPunct(")");
+    return std::move(*expr);
+  }
+
+  [[nodiscard]] ast::If parseIf()
+  {
+    const auto first = peek().first;
+    consume();
+
+    auto condition      = expectParenthesizedExpr();
+    auto then_statement = expectStmt();
+
+    std::optional<ast::Stmt> else_statement;
+
+    if (acceptKeyword("else"))
+      else_statement = expectStmt();
+
+    ast::If if_{std::move(condition),
+                std::move(then_statement),
+                std::move(else_statement)};
+    annotate(if_, first);
+    return if_;
+  }
+
+  [[nodiscard]] ast::Loop parseLoop()
+  {
+    const auto first = peek().first;
+    consume();
+
+    ast::Loop loop;
+    loop.body = expectStmt();
+    annotate(loop, first);
+    return loop;
+  }
+
+  [[nodiscard]] ast::While parseWhile()
+  {
+    const auto first = peek().first;
+    consume();
+
+    ast::While while_;
+    while_.cond_expr = expectParenthesizedExpr();
+    while_.body      = expectStmt();
+    annotate(while_, first);
+    return while_;
+  }
+
+  [[nodiscard]] ast::For parseFor()
+  {
+    const auto first = peek().first;
+    consume();
+
+    expectPunct("(");
+
+    ast::For for_;
+
+    if (auto assignment = parseAssignment())
+      for_.init_stmt = std::move(*assignment);
+    else if (isKeyword("let"))
+      for_.init_stmt = parseVariableDef();
+
+    expectPunct(";");
+
+    for_.cond_expr = parseExpr();
+
+    expectPunct(";");
+
+    if (isPunct("++") || isPunct("--"))
+      for_.loop_stmt = parsePrefixIncrementDecrement();
+    else if (auto assignment = parseAssignment())
+      for_.loop_stmt = std::move(*assignment);
+
+    expectPunct(")");
+
+    for_.body = expectStmt();
+
+    annotate(for_, first);
+    return for_;
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Top level rules
+  //===--------------------------------------------------------------------===//
+
+  [[nodiscard]] ast::Identifier expectIdentifier()
+  {
+    auto identifier = parseIdentifier();
+
+    if (!identifier)
+      fail("identifier");
+
+    return std::move(*identifier);
+  }
+
+  [[nodiscard]] ast::Type expectTypeName()
+  {
+    auto type = parseTypeName();
+
+    if (!type)
+      fail("type name");
+
+    return std::move(*type);
+  }
+
+  [[nodiscard]] ast::TemplateParameters parseTemplateParams()
+  {
+    const auto first = peek().first;
+
+    ast::TemplateParameters template_params;
+
+    if (acceptPunct("<")) {
+      auto type_names = parseList<ast::TemplateParameters::TypeNames>(
+        [this] { return parseIdentifier(); });
+
+      if (!type_names)
+        fail("identifier");
+
+      template_params.type_names = std::move(*type_names);
+
+      expectPunct(">");
+    }
+
+    annotate(template_params, first);
+    return template_params;
+  }
+
+  [[nodiscard]] std::optional<ast::Parameter> parseParameter()
+  {
+    const auto first = peek().first;
+
+    if (auto name = parseIdentifier()) {
+      expectPunct(":");
+
+      std::unordered_set<VariableQual> qualifier;
+
+      while (const auto variable_qualifier = acceptVariableQualifier())
+        qualifier.insert(*variable_qualifier);
+
+      ast::Parameter parameter{std::move(*name),
+                               std::move(qualifier),
+                               expectTypeName(),
+                               false};
+      annotate(parameter, first);
+      return parameter;
+    }
+
+    if (acceptPunct("...")) {
+      auto parameter = ast::Parameter::createVarArgParameter();
+      annotate(parameter, first);
+      return parameter;
+    }
+
+    return std::nullopt;
+  }
+
+  [[nodiscard]] ast::ParameterList parseParameterList()
+  {
+    const auto first = peek().first;
+
+    ast::ParameterList parameter_list;
+
+    if (auto params = parseList<std::deque<ast::Parameter>>(
+          [this] { return parseParameter(); }))
+      parameter_list.params = std::move(*params);
+
+    annotate(parameter_list, first);
+    return parameter_list;
+  }
+
+  [[nodiscard]] std::optional<ast::FunctionDecl> parseFunctionProto()
+  {
+    const auto first = peek().first;
+
+    auto name = parseIdentifier();
+
+    if (!name)
+      return std::nullopt;
+
+    ast::FunctionDecl decl;
+    decl.name            = std::move(*name);
+    decl.template_params = parseTemplateParams();
+
+    expectPunct("(");
+    decl.params = parseParameterList();
+    expectPunct(")");
+
+    if (acceptPunct("->"))
+      decl.return_type = expectTypeName();
+    else
+      decl.return_type = ast::BuiltinType{codegen::BuiltinTypeKind::void_};
+
+    annotate(decl, first);
+    return decl;
+  }
+
+  [[nodiscard]] ast::FunctionDecl expectFunctionProto()
+  {
+    auto decl = parseFunctionProto();
+
+    if (!decl)
+      fail("function prototype");
+
+    return std::move(*decl);
+  }
+
+  [[nodiscard]] ast::FunctionDecl parseFunctionDecl()
+  {
+    const auto first = peek().first;
+    consume(2);
+
+    auto decl = expectFunctionProto();
+    expectPunct(";");
+
+    annotate(decl, first);
+    return decl;
+  }
+
+  [[nodiscard]] ast::FunctionDef parseFunctionDef()
+  {
+    const auto first     = peek().first;
+    const auto is_public = acceptKeyword("pub");
+    consume();
+
+    auto decl = expectFunctionProto();
+
+    ast::FunctionDef function_def{is_public, std::move(decl), expectStmt()};
+    annotate(function_def, first);
+    return function_def;
+  }
+
+  [[nodiscard]] ast::ClassDecl parseClassDecl()
+  {
+    const auto first = peek().first;
+    consume(2);
+
+    ast::ClassDecl class_decl{expectIdentifier()};
+    expectPunct(";");
+
+    annotate(class_decl, first);
+    return class_decl;
+  }
+
+  [[nodiscard]] ast::VariableDefWithoutInit parseVariableDefWithoutInit()
+  {
+    const auto first = peek().first;
+    consume();
+
+    auto qualifier = acceptVariableQualifier();
+    auto name      = expectIdentifier();
+
+    expectPunct(":");
+
+    ast::VariableDefWithoutInit variable_def{std::move(qualifier),
+                                             std::move(name),
+                                             expectTypeName()};
+    annotate(variable_def, first);
+    return variable_def;
+  }
+
+  [[nodiscard]] std::optional<ast::MemberInitializer> parseMemberInitializer()
+  {
+    const auto first = peek().first;
+
+    auto member_name = parseIdentifier();
+
+    if (!member_name)
+      return std::nullopt;
+
+    expectPunct("{");
+
+    auto initializer = parseExpr();
+
+    if (!initializer)
+      fail("expression");
+
+    expectPunct("}");
+
+    ast::MemberInitializer member_initializer;
+    member_initializer.member_name = std::move(*member_name);
+    member_initializer.initializer = std::move(*initializer);
+    annotate(member_initializer, first);
+    return member_initializer;
+  }
+
+  [[nodiscard]] std::optional<ast::Constructor> parseConstructor()
+  {
+    const auto first = peek().first;
+
+    auto decl = parseFunctionProto();
+
+    if (!decl)
+      return std::nullopt;
+
+    ast::Constructor constructor;
+    constructor.decl = std::move(*decl);
+
+    if (isPunct(":")) {
+      const auto list_first = peek().first;
+      consume();
+
+      auto initializers = parseList<std::vector<ast::MemberInitializer>>(
+        [this] { return parseMemberInitializer(); });
+
+      if (!initializers)
+        fail("member initializer");
+
+      constructor.member_initializers.initializers = std::move(*initializers);
+      annotate(constructor.member_initializers, list_first);
+    }
+
+    constructor.body = expectStmt();
+
+    annotate(constructor, first);
+    return constructor;
+  }
+
+  [[nodiscard]] std::optional<ast::Destructor> parseDestructor()
+  {
+    const auto state = save();
+    const auto first = peek().first;
+
+    if (!acceptPunct("~"))
+      return std::nullopt;
+
+    auto decl = parseFunctionProto();
+
+    if (!decl) {
+      restore(state);
+      return std::nullopt;
+    }
+
+    ast::Destructor destructor;
+    destructor.decl = std::move(*decl);
+    destructor.body = expectStmt();
+
+    annotate(destructor, first);
+    return destructor;
+  }
+
+  [[nodiscard]] ast::ClassMemberList parseClassMemberList()
+  {
+    ast::ClassMemberList members;
+
+    for (;;) {
+      if (isKeyword("let")) {
+        members.emplace_back(parseVariableDefWithoutInit());
+        expectPunct(";");
+        continue;
+      }
+
+      if (isKeyword("public") || isKeyword("private")) {
+        members.emplace_back(isKeyword("public") ? Accessibility::public_
+                                                 : Accessibility::private_);
+        consume();
+        expectPunct(":");
+        continue;
+      }
+
+      const std::size_t keyword = isKeyword("pub") ? 1 : 0;
+
+      if (isKeyword("class", keyword)) {
+        members.emplace_back(parseClassDef());
+        continue;
+      }
+
+      if (isKeyword("func", keyword)) {
+        members.emplace_back(parseFunctionDef());
+        continue;
+      }
+
+      if (auto destructor = parseDestructor()) {
+        members.emplace_back(std::move(*destructor));
+        continue;
+      }
+
+      if (auto constructor = parseConstructor()) {
+        members.emplace_back(std::move(*constructor));
+        continue;
+      }
+
+      return members;
+    }
+  }
+
+  [[nodiscard]] ast::ClassDef parseClassDef()
+  {
+    const auto first     = peek().first;
+    const auto is_public = acceptKeyword("pub");
+    consume();
+
+    auto name            = expectIdentifier();
+    auto template_params = parseTemplateParams();
+
+    expectPunct("{");
+    auto members = parseClassMemberList();
+    expectPunct("}");
+
+    ast::ClassDef class_def{is_public,
+                            std::move(name),
+                            std::move(template_params),
+                            std::move(members)};
+    annotate(class_def, first);
+    return class_def;
+  }
+
+  [[nodiscard]] std::optional<ast::UnionTag> parseUnionTag()
+  {
+    const auto first = peek().first;
+
+    auto tag_name = parseIdentifier();
+
+    if (!tag_name)
+      return std::nullopt;
+
+    expectPunct("(");
+
+    ast::UnionTag union_tag;
+    union_tag.tag_name = std::move(*tag_name);
+    union_tag.type     = expectTypeName();
+
+    expectPunct(")");
+
+    annotate(union_tag, first);
+    return union_tag;
+  }
+
+  [[nodiscard]] ast::UnionDef parseUnionDef()
+  {
+    const auto first     = peek().first;
+    const auto is_public = acceptKeyword("pub");
+    consume();
+
+    auto name            = expectIdentifier();
+    auto template_params = parseTemplateParams();
+
+    expectPunct("{");
+
+    auto type_list = parseList<ast::UnionTagList>(
+      [this] { return parseUnionTag(); });
+
+    if (!type_list)
+      fail("union tag list");
+
+    // Trailing comma
+    if (!acceptPunct(","))
+      skipped = true;
+
+    expectPunct("}");
+
+    ast::UnionDef union_def{is_public,
+                            std::move(name),
+                            std::move(template_params),
+                            std::move(*type_list)};
+    annotate(union_def, first);
+    return union_def;
+  }
+
+  [[nodiscard]] ast::Typedef parseTypedef()
+  {
+    const auto first = peek().first;
+    consume();
+
+    ast::Typedef type_def;
+    type_def.alias = expectIdentifier();
+
+    expectPunct("=");
+    type_def.type = expectTypeName();
+    expectPunct(";");
+
+    annotate(type_def, first);
+    return type_def;
+  }
+
+  // The path is not a string literal, e.g. spaces around it are skipped
+  [[nodiscard]] ast::Import parseImport()
+  {
+    const auto first = peek().first;
+    consume();
+
+    if (peek().kind == TokenKind::eoi || input[peek().first] != '"')
+      fail(quote("\""));
+
+    const auto path_first = skipSpaces(input, peek().first + 1);
+    const auto path_last  = scanPath(input, path_first);
+
+    if (path_first == path_last)
+      throw SyntaxError{peek().first + 1, "path"};
+
+    const auto quote_offset = skipSpaces(input, path_last);
+
+    if (quote_offset == input.size() || input[quote_offset] != '"')
+      throw SyntaxError{quote_offset, quote("\"")};
+
+    // Skips the tokens of the quoted path
+    while (peek().kind != TokenKind::eoi && peek().last <= quote_offset + 1)
+      consume();
+
+    if (tokens[index - 1].last != quote_offset + 1)
+      throw SyntaxError{quote_offset, quote("\"")};
+
+    ast::Import import;
+    import.path = ast::Path{unicode::utf8toUtf32(
+      std::string_view{input}.substr(path_first, path_last - path_first))};
+
+    positions.annotate(import.path, path_first, path_last);
+
+    expectPunct(";");
+
+    annotate(import, first);
+    return import;
+  }
+
+  [[nodiscard]] ast::Namespace parseNamespace()
+  {
+    const auto first = peek().first;
+    consume();
+
+    ast::Namespace name_space;
+    name_space.name = expectIdentifier();
+
+    expectPunct("{");
+    name_space.top_levels = parseTopLevelList();
+    expectPunct("}");
+
+    annotate(name_space, first);
+    return name_space;
+  }
+
+  [[nodiscard]] std::optional<ast::TopLevel> parseTopLevel()
+  {
+    const std::size_t keyword = isKeyword("pub") ? 1 : 0;
+
+    if (isKeyword("namespace"))
+      return parseNamespace();
+
+    if (isKeyword("declare") && isKeyword("func", 1))
+      return parseFunctionDecl();
+
+    if (isKeyword("func", keyword))
+      return parseFunctionDef();
+
+    if (isKeyword("declare") && isKeyword("class", 1))
+      return parseClassDecl();
+
+    if (isKeyword("class", keyword))
+      return parseClassDef();
+
+    if (isKeyword("union", keyword))
+      return parseUnionDef();
+
+    if (isKeyword("typedef"))
+      return parseTypedef();
+
+    if (isKeyword("import"))
+      return parseImport();
+
+    return std::nullopt;
+  }
+
+  [[nodiscard]] std::optional<ast::TopLevelWithAttr> parseTopLevelWithAttr()
+  {
+    const auto state = save();
+    const auto first = peek().first;
+
+    ast::TopLevelWithAttr top_level_with_attr;
+
+    if (auto attrs = parseAttribute())
+      top_level_with_attr.attrs = std::move(*attrs);
+
+    auto top_level = parseTopLevel();
+
+    if (!top_level) {
+      restore(state);
+      return std::nullopt;
+    }
+
+    top_level_with_attr.top_level = std::move(*top_level);
+    annotate(top_level_with_attr, first);
+    return top_level_with_attr;
+  }
+
+  [[nodiscard]] ast::TopLevelList parseTopLevelList()
+  {
+    ast::TopLevelList top_levels;
+
+    while (auto top_level = parseTopLevelWithAttr())
+      top_levels.push_back(std::move(*top_level));
+
+    return top_levels;
+  }
+
+  const std::string_view input;
+
+  const std::vector<Token> tokens;
+
+  PositionTable& positions;
+
+  std::size_t index = 0;
+
+  // Whether a literal that failed to match has skipped the spaces before the
+  // current token
+  bool skipped = false;
+};
+
+[[nodiscard]] std::optional<SyntaxError>
+parseRecursiveDescent(const std::string_view input,
+                      ast::TranslationUnit&  ast,
+                      PositionTable&         positions)
+{
+  RecursiveDescentParser parser{input, positions};
+
+  try {
+    ast = parser.parseTranslationUnit();
+  }
+  catch (SyntaxError& err) {
+    return std::move(err);
+  }
+
+  return std::nullopt;
+}
+
+} // namespace twinkle::parse
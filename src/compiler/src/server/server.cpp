@@ -0,0 +1,452 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twinkle/server/server.hpp>
+#include <twinkle/parse/import_cache.hpp>
+#include <twinkle/support/utils.hpp>
+#include <twinkle/support/target.hpp>
+#include <twinkle/support/exception.hpp>
+#include <boost/asio.hpp>
+#include <csignal>
+#include <cstring>
+#include <sstream>
+
+namespace twinkle::server
+{
+
+namespace asio = boost::asio;
+
+using Protocol = asio::local::stream_protocol;
+
+// Exception class for malformed messages.
+struct ProtocolError : public ErrorBase {
+  explicit ProtocolError(const std::string& what_arg)
+    : ErrorBase{what_arg}
+  {
+  }
+};
+
+// Every value is written as a string prefixed with its length
+struct MessageWriter {
+  MessageWriter& write(const std::string_view value)
+  {
+    const std::uint64_t size = value.size();
+
+    buffer.append(reinterpret_cast<const char*>(&size), sizeof size);
+    buffer.append(value);
+
+    return *this;
+  }
+
+  MessageWriter& write(const std::string& value)
+  {
+    return write(std::string_view{value});
+  }
+
+  MessageWriter& write(const bool value)
+  {
+    return write(std::string_view{value ? "1" : "0"});
+  }
+
+  MessageWriter& write(const std::uintmax_t value)
+  {
+    return write(std::to_string(value));
+  }
+
+  MessageWriter& write(const std::optional<std::string>& value)
+  {
+    write(value.has_value());
+    return value ? write(*value) : *this;
+  }
+
+  template <typename T>
+  MessageWriter& write(const std::vector<T>& values)
+  {
+    write(std::uintmax_t{values.size()});
+
+    // Also converts paths
+    for (const std::string& r : values)
+      write(r);
+
+    return *this;
+  }
+
+  std::string buffer;
+};
+
+struct MessageReader {
+  explicit MessageReader(const std::string& buffer) noexcept
+    : buffer{buffer}
+  {
+  }
+
+  [[nodiscard]] std::string readString()
+  {
+    std::uint64_t size;
+
+    if (buffer.size() - pos < sizeof size)
+      throw ProtocolError{"truncated message"};
+
+    std::memcpy(&size, buffer.data() + pos, sizeof size);
+    pos += sizeof size;
+
+    if (buffer.size() - pos < size)
+      throw ProtocolError{"truncated message"};
+
+    auto value = buffer.substr(pos, size);
+    pos += size;
+
+    return value;
+  }
+
+  [[nodiscard]] bool readBool()
+  {
+    return readString() == "1";
+  }
+
+  [[nodiscard]] std::uintmax_t readNumber()
+  try {
+    return std::stoull(readString());
+  }
+  catch (const std::logic_error&) {
+    throw ProtocolError{"malformed number"};
+  }
+
+  [[nodiscard]] std::optional<std::string> readOptional()
+  {
+    if (readBool())
+      return readString();
+    else
+      return std::nullopt;
+  }
+
+  [[nodiscard]] std::vector<std::string> readStrings()
+  {
+    std::vector<std::string> values(readNumber());
+
+    for (auto& r : values)
+      r = readString();
+
+    return values;
+  }
+
+private:
+  const std::string& buffer;
+  std::size_t        pos = 0;
+};
+
+static void writeMessage(Protocol::socket& socket, const std::string& message)
+{
+  const std::uint64_t size = message.size();
+
+  asio::write(socket,
+              std::array{asio::buffer(&size, sizeof size),
+                         asio::buffer(message)});
+}
+
+[[nodiscard]] static std::string readMessage(Protocol::socket& socket)
+{
+  std::uint64_t size;
+  asio::read(socket, asio::buffer(&size, sizeof size));
+
+  std::string message(size, '\0');
+  asio::read(socket, asio::buffer(message));
+
+  return message;
+}
+
+enum class Status : std::uintmax_t {
+  succeeded,
+  failed,
+  version_mismatch,
+};
+
+// Relative paths of the context are resolved in the working directory of the
+// client
+[[nodiscard]] static std::string encodeRequest(const Context& ctx)
+{
+  MessageWriter writer;
+
+  writer.write(getVersion())
+    .write(std::filesystem::current_path().string())
+    .write(ctx.input_files)
+    .write(ctx.jit)
+    .write(ctx.emit_target)
+    .write(std::uintmax_t{ctx.opt_level})
+    .write(ctx.lto)
+    .write(ctx.profile_generate)
+    .write(ctx.profile_use)
+    .write(ctx.profile_runtime)
+    .write(ctx.relocation_model)
+    .write(ctx.linked_libs)
+    .write(ctx.linker)
+    .write(ctx.target_triple)
+    .write(ctx.cpu)
+    .write(ctx.cpu_features)
+    .write(ctx.cache_dir)
+    .write(ctx.cache_max_size)
+    .write(std::uintmax_t{ctx.jobs})
+    .write(ctx.x3_parser)
+    .write(ctx.template_stats);
+
+  return std::move(writer.buffer);
+}
+
+// The fields are read in the order they are written by 'encodeRequest', as
+// the initializers of a braced list are evaluated in order
+// The server never forwards to itself, is not profiled and never runs the
+// JIT, so the other fields keep their defaults
+[[nodiscard]] static Context decodeContext(MessageReader& reader)
+{
+  return {
+    .input_files      = reader.readStrings(),
+    .jit              = reader.readBool(),
+    .emit_target      = reader.readString(),
+    .opt_level        = static_cast<unsigned int>(reader.readNumber()),
+    .lto              = reader.readBool(),
+    .profile_generate = reader.readBool(),
+    .profile_use      = reader.readOptional(),
+    .profile_runtime  = reader.readOptional(),
+    .relocation_model = reader.readString(),
+    .linked_libs      = reader.readStrings(),
+    .linker           = reader.readString(),
+    .target_triple    = reader.readOptional(),
+    .cpu              = reader.readString(),
+    .cpu_features     = reader.readString(),
+    .cache_dir        = reader.readOptional(),
+    .cache_max_size   = reader.readNumber(),
+    .jobs             = static_cast<unsigned int>(reader.readNumber()),
+    .x3_parser        = reader.readBool(),
+    .template_stats   = reader.readBool(),
+  };
+}
+
+// Restores the working directory and the standard error on destruction
+struct RequestScope : private boost::noncopyable {
+  RequestScope(const std::filesystem::path& working_directory,
+               std::ostream&                diagnostics)
+    : working_directory_backup{std::filesystem::current_path()}
+  {
+    std::filesystem::current_path(working_directory);
+
+    cerr_backup = std::cerr.rdbuf(diagnostics.rdbuf());
+  }
+
+  ~RequestScope()
+  {
+    std::cerr.rdbuf(cerr_backup);
+
+    std::error_code ec;
+    std::filesystem::current_path(working_directory_backup, ec);
+  }
+
+private:
+  const std::filesystem::path working_directory_backup;
+  std::streambuf*             cerr_backup;
+};
+
+// Requests are handled one at a time, since the working directory is shared by
+// the whole process
+// Input files are still processed in parallel as requested by the client
+[[nodiscard]] static std::string
+handleRequest(const std::string&                         request,
+              const std::string_view                     argv_front,
+              const std::shared_ptr<parse::ImportCache>& import_cache)
+{
+  MessageReader reader{request};
+
+  MessageWriter writer;
+
+  if (reader.readString() != getVersion()) {
+    writer.write(static_cast<std::uintmax_t>(Status::version_mismatch));
+    return std::move(writer.buffer);
+  }
+
+  const std::filesystem::path working_directory = reader.readString();
+
+  const auto ctx = decodeContext(reader);
+
+  std::ostringstream diagnostics;
+
+  const auto result = [&]() -> std::optional<CompileResult> {
+    try {
+      const RequestScope scope{working_directory, diagnostics};
+
+      return compile(ctx, argv_front, import_cache);
+    }
+    catch (const std::filesystem::filesystem_error& err) {
+      diagnostics << formatError(argv_front, err.what()) << '\n';
+      return std::nullopt;
+    }
+  }();
+
+  if (!result || !std::holds_alternative<AOTResult>(*result)) {
+    writer.write(static_cast<std::uintmax_t>(Status::failed))
+      .write(diagnostics.str());
+
+    return std::move(writer.buffer);
+  }
+
+  const auto& aot_result = std::get<AOTResult>(*result);
+
+  writer.write(static_cast<std::uintmax_t>(Status::succeeded))
+    .write(diagnostics.str())
+    .write(aot_result.created_files)
+    .write(aot_result.linker_options);
+
+  return std::move(writer.buffer);
+}
+
+static void serve(Protocol::socket&                         socket,
+                  const std::string_view                     argv_front,
+                  const std::shared_ptr<parse::ImportCache>& import_cache)
+try {
+  writeMessage(socket,
+               handleRequest(readMessage(socket), argv_front, import_cache));
+}
+catch (const boost::system::system_error& err) {
+  // Clients that only check if the server is listening send nothing
+  if (err.code() != asio::error::eof)
+    std::cerr << formatError(argv_front, err.what()) << std::endl;
+}
+catch (const std::exception& err) {
+  // A broken request must not bring down the server
+  std::cerr << formatError(argv_front, err.what()) << std::endl;
+}
+
+[[nodiscard]] static bool isListening(asio::io_context&            io_context,
+                                      const std::filesystem::path& socket_path)
+{
+  Protocol::socket socket{io_context};
+
+  boost::system::error_code ec;
+  socket.connect(Protocol::endpoint{socket_path.string()}, ec);
+
+  return !ec;
+}
+
+[[nodiscard]] int runServer(const std::filesystem::path& socket_path,
+                            const std::string_view       argv_front)
+try {
+  asio::io_context io_context;
+
+  if (std::filesystem::exists(socket_path)) {
+    if (isListening(io_context, socket_path)) {
+      std::cerr << formatError(argv_front,
+                               fmt::format("a server is already listening on "
+                                           "{}\n",
+                                           socket_path.string()))
+                << std::flush;
+      return EXIT_FAILURE;
+    }
+
+    // Left by a server that was killed
+    std::filesystem::remove(socket_path);
+  }
+
+  initializeTargets();
+
+  const auto& import_cache = parse::ImportCache::getInstance();
+
+  Protocol::acceptor acceptor{io_context,
+                              Protocol::endpoint{socket_path.string()}};
+
+  asio::signal_set signals{io_context, SIGINT, SIGTERM};
+  signals.async_wait([&](const boost::system::error_code&, int) {
+    acceptor.close();
+  });
+
+  std::function<void()> accept = [&] {
+    acceptor.async_accept([&](const boost::system::error_code& ec,
+                              Protocol::socket                 socket) {
+      // The acceptor has been closed
+      if (ec == asio::error::operation_aborted)
+        return;
+
+      if (!ec)
+        serve(socket, argv_front, import_cache);
+
+      accept();
+    });
+  };
+
+  accept();
+
+  std::cout << "twinkle server listening on " << socket_path.string()
+            << std::endl;
+
+  io_context.run();
+
+  std::filesystem::remove(socket_path);
+
+  return EXIT_SUCCESS;
+}
+catch (const std::exception& err) {
+  std::cerr << formatError(argv_front, err.what())
+            << (isBackNewline(err.what()) ? "" : "\n") << std::flush;
+  return EXIT_FAILURE;
+}
+
+std::optional<CompileResult> compileOnServer(const Context&         ctx,
+                                             const std::string_view argv_front)
+{
+  assert(ctx.server_socket);
+
+  // The compilation is profiled in this process
+  if (ctx.jit || ctx.time_trace)
+    return compile(ctx, argv_front);
+
+  asio::io_context io_context;
+  Protocol::socket socket{io_context};
+
+  boost::system::error_code ec;
+  socket.connect(Protocol::endpoint{*ctx.server_socket}, ec);
+
+  if (ec)
+    return compile(ctx, argv_front);
+
+  std::string response;
+
+  try {
+    writeMessage(socket, encodeRequest(ctx));
+    response = readMessage(socket);
+  }
+  catch (const boost::system::system_error&) {
+    // The server went away in the middle of the request
+    return compile(ctx, argv_front);
+  }
+
+  try {
+    MessageReader reader{response};
+
+    const auto status = static_cast<Status>(reader.readNumber());
+
+    if (status == Status::version_mismatch)
+      return compile(ctx, argv_front);
+
+    std::cerr << reader.readString() << std::flush;
+
+    if (status == Status::failed)
+      return std::nullopt;
+
+    auto created_files  = reader.readStrings();
+    auto linker_options = reader.readStrings();
+
+    return AOTResult{{created_files.begin(), created_files.end()},
+                     std::move(linker_options)};
+  }
+  catch (const ProtocolError& err) {
+    std::cerr << formatError(argv_front,
+                             fmt::format("invalid response from the server: "
+                                         "{}\n",
+                                         err.what()))
+              << std::flush;
+    return std::nullopt;
+  }
+}
+
+} // namespace twinkle::server
@@ -7,29 +7,42 @@
 
 #include <twinkle/support/file.hpp>
 #include <twinkle/support/utils.hpp>
+#include <boost/filesystem.hpp>
 
 namespace twinkle
 {
 
-// Load a file to std::string
-[[nodiscard]] std::string loadFile(const std::string_view       program_name,
-                                   const std::filesystem::path& path)
+[[nodiscard]] std::string_view describeLoadError(const std::error_code ec)
 {
-  if (!std::filesystem::exists(path)) {
-    throw FileError{
-      formatError(program_name,
-                  fmt::format("{}: No such file or directory", path.string()))};
-  }
-
-  if (auto file = std::ifstream{path, std::ios_base::binary}) {
-    std::stringstream ss;
-    ss << file.rdbuf();
-    return ss.str();
-  }
+  return ec == std::errc::no_such_file_or_directory
+           ? "No such file or directory"
+           : "Could not open file";
+}
+
+// Load a file to a shared source buffer
+[[nodiscard]] SourceBufferPtr
+loadFile(const std::string_view       program_name,
+         const std::filesystem::path& path)
+{
+  const llvm::TimeTraceScope time_trace_scope{"Load file", path.string()};
+
+  auto source = mapSourceFile(path);
+
+  if (source)
+    return std::move(*source);
 
   throw FileError{
     formatError(program_name,
-                fmt::format("{}: Could not open file", path.string()))};
+                fmt::format("{}: {}",
+                            path.string(),
+                            describeLoadError(source.getError())))};
+}
+
+[[nodiscard]] std::string createTemporaryFilepath()
+{
+  return (boost::filesystem::temp_directory_path()
+          / boost::filesystem::unique_path())
+    .native();
 }
 
 } // namespace twinkle
@@ -0,0 +1,90 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twinkle/pch/pch.hpp>
+#include <twinkle/support/parallel.hpp>
+#include <twinkle/support/time_trace.hpp>
+#include <atomic>
+#include <exception>
+#include <thread>
+
+namespace twinkle
+{
+
+[[nodiscard]] unsigned int resolveJobs(const unsigned int jobs) noexcept
+{
+  if (jobs != 0)
+    return jobs;
+
+  // hardware_concurrency() may return 0 if it is not computable
+  return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+void parallelFor(const std::size_t                              count,
+                 const unsigned int                             jobs,
+                 const std::function<void(const std::size_t)>& fn)
+{
+  const auto num_threads
+    = std::min(static_cast<std::size_t>(resolveJobs(jobs)), count);
+
+  if (num_threads <= 1) {
+    for (std::size_t idx = 0; idx < count; ++idx)
+      fn(idx);
+
+    return;
+  }
+
+  // Indices are handed out in increasing order, so every index below the
+  // lowest failing one has been started by the time the workers stop
+  std::atomic<std::size_t>        next_idx{0};
+  std::atomic<std::size_t>        lowest_failed_idx{count};
+  std::vector<std::exception_ptr> errors(count);
+
+  const auto worker = [&] {
+    for (;;) {
+      const auto idx = next_idx.fetch_add(1);
+
+      if (idx >= count || idx > lowest_failed_idx.load())
+        return;
+
+      try {
+        fn(idx);
+      }
+      catch (...) {
+        errors[idx] = std::current_exception();
+
+        auto expected = lowest_failed_idx.load();
+        while (idx < expected
+               && !lowest_failed_idx.compare_exchange_weak(expected, idx))
+          ;
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+
+  for (std::size_t i = 1; i < num_threads; ++i) {
+    threads.emplace_back([&] {
+      const TimeTraceThreadScope time_trace_scope;
+      worker();
+    });
+  }
+
+  // The calling thread is also one of the workers
+  worker();
+
+  for (auto& thread : threads)
+    thread.join();
+
+  for (const auto& error : errors) {
+    if (error)
+      std::rethrow_exception(error);
+  }
+}
+
+} // namespace twinkle
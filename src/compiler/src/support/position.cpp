@@ -0,0 +1,25 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twinkle/support/position.hpp>
+
+namespace twinkle
+{
+
+// Files imported by several translation units are parsed only once, so IDs
+// are unique in the process rather than in a translation unit
+static std::atomic<int> next_file_id = 0;
+
+PositionTable::PositionTable(const SourceBufferPtr& source)
+  : file_id{next_file_id++}
+  , source{source}
+{
+  // Offsets are stored in 32 bits
+  assert(source->getText().size() <= UINT32_MAX);
+}
+
+} // namespace twinkle
@@ -0,0 +1,92 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twinkle/support/source.hpp>
+
+namespace twinkle
+{
+
+SourceBuffer::SourceBuffer(std::unique_ptr<llvm::MemoryBuffer>&& buffer)
+  : buffer{std::move(buffer)}
+  , text{this->buffer->getBufferStart(), this->buffer->getBufferSize()}
+{
+}
+
+SourceBuffer::SourceBuffer(std::string&& text)
+  : owned{std::move(text)}
+  , text{owned}
+{
+}
+
+[[nodiscard]] std::size_t SourceBuffer::getLine(const std::size_t offset) const
+{
+  assert(offset <= text.size());
+
+  const auto& starts = getLineStarts();
+
+  return std::upper_bound(starts.cbegin(), starts.cend(), offset)
+         - starts.cbegin();
+}
+
+[[nodiscard]] std::size_t
+SourceBuffer::getColumn(const std::size_t offset) const
+{
+  const auto line_start = getLineStarts()[getLine(offset) - 1];
+
+  // Counts the bytes that are not continuations of UTF-8 sequences
+  return 1
+         + std::count_if(text.cbegin() + line_start,
+                         text.cbegin() + offset,
+                         [](const char c) {
+                           return (static_cast<unsigned char>(c) & 0xc0)
+                                  != 0x80;
+                         });
+}
+
+[[nodiscard]] std::string_view
+SourceBuffer::getLineText(const std::size_t line) const
+{
+  const auto& starts = getLineStarts();
+
+  assert(1 <= line && line <= starts.size());
+
+  const auto first = starts[line - 1];
+  const auto last  = line == starts.size() ? text.size() : starts[line] - 1;
+
+  return text.substr(first, last - first);
+}
+
+[[nodiscard]] const std::vector<std::size_t>&
+SourceBuffer::getLineStarts() const
+{
+  // Results of imported files are shared between threads
+  std::call_once(line_starts_flag, [this] {
+    line_starts.push_back(0);
+
+    for (std::size_t offset{}; offset != text.size(); ++offset) {
+      if (text[offset] == '\n')
+        line_starts.push_back(offset + 1);
+    }
+  });
+
+  return line_starts;
+}
+
+[[nodiscard]] llvm::ErrorOr<SourceBufferPtr>
+mapSourceFile(const std::filesystem::path& path)
+{
+  auto buffer = llvm::MemoryBuffer::getFile(path.string(),
+                                            false,
+                                            false /* No null terminator */);
+
+  if (!buffer)
+    return buffer.getError();
+
+  return std::make_shared<const SourceBuffer>(std::move(*buffer));
+}
+
+} // namespace twinkle
@@ -0,0 +1,108 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twinkle/support/target.hpp>
+#include <twinkle/support/utils.hpp>
+
+namespace twinkle
+{
+
+[[nodiscard]] static std::string getHostCPUFeatures()
+{
+  llvm::StringMap<bool> host_features;
+
+  if (!llvm::sys::getHostCPUFeatures(host_features))
+    return "";
+
+  std::vector<std::string> features;
+
+  for (const auto& r : host_features)
+    features.push_back((r.second ? "+" : "-") + r.first().str());
+
+  // The order of llvm::StringMap is unspecified
+  std::sort(features.begin(), features.end());
+
+  return boost::algorithm::join(features, ",");
+}
+
+[[nodiscard]] TargetCPU resolveTargetCPU(const std::string& cpu,
+                                         const std::string& features)
+{
+  if (cpu != "native")
+    return {cpu, features};
+
+  auto host_features = getHostCPUFeatures();
+
+  if (!features.empty())
+    host_features += (host_features.empty() ? "" : ",") + features;
+
+  return {llvm::sys::getHostCPUName().str(), std::move(host_features)};
+}
+
+[[nodiscard]] llvm::CodeGenOpt::Level
+getCodeGenOptLevel(const unsigned int opt_level)
+{
+  switch (opt_level) {
+  case 0:
+    return llvm::CodeGenOpt::None;
+  case 1:
+    return llvm::CodeGenOpt::Less;
+  case 2:
+    return llvm::CodeGenOpt::Default;
+  case 3:
+    return llvm::CodeGenOpt::Aggressive;
+  default:
+    unreachable();
+  }
+}
+
+void initializeTargets()
+{
+  static std::once_flag initialized;
+
+  std::call_once(initialized, [] {
+    llvm::InitializeAllTargetInfos();
+    llvm::InitializeAllTargets();
+    llvm::InitializeAllTargetMCs();
+    llvm::InitializeAllAsmParsers();
+    llvm::InitializeAllAsmPrinters();
+  });
+}
+
+[[nodiscard]] TargetMachinePool& TargetMachinePool::getInstance()
+{
+  static TargetMachinePool pool;
+  return pool;
+}
+
+[[nodiscard]] TargetMachinePool::Handle
+TargetMachinePool::acquire(const std::string& key, const Factory& create)
+{
+  std::unique_ptr<llvm::TargetMachine> machine;
+
+  {
+    std::lock_guard lock{mutex};
+
+    if (auto& idle = idle_machines[key]; !idle.empty()) {
+      machine = std::move(idle.back());
+      idle.pop_back();
+    }
+  }
+
+  if (!machine)
+    machine = create();
+
+  if (!machine)
+    return nullptr;
+
+  return {machine.release(), [this, key](llvm::TargetMachine* const released) {
+            std::lock_guard lock{mutex};
+            idle_machines[key].emplace_back(released);
+          }};
+}
+
+} // namespace twinkle
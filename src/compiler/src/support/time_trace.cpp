@@ -0,0 +1,66 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include <twinkle/pch/pch.hpp>
+#include <twinkle/support/time_trace.hpp>
+#include <twinkle/support/utils.hpp>
+#include <atomic>
+
+namespace twinkle
+{
+
+// The profiler of LLVM is per thread, so worker threads have to know the
+// session
+static std::atomic<bool> session_active = false;
+
+static std::atomic<unsigned int> session_granularity = 0;
+
+TimeTraceSession::TimeTraceSession(const std::filesystem::path& path,
+                                   const unsigned int           granularity,
+                                   const std::string_view       argv_front)
+  : path{path}
+  , argv_front{argv_front}
+{
+  assert(!session_active);
+
+  llvm::timeTraceProfilerInitialize(granularity, "twinkle");
+
+  session_granularity = granularity;
+  session_active      = true;
+}
+
+TimeTraceSession::~TimeTraceSession()
+{
+  session_active = false;
+
+  // Includes the traces of the finished worker threads
+  if (auto err = llvm::timeTraceProfilerWrite(path.string(), "")) {
+    std::cerr << formatError(argv_front,
+                             fmt::format("{}: {}\n",
+                                         path.string(),
+                                         llvm::toString(std::move(err))))
+              << std::flush;
+  }
+
+  llvm::timeTraceProfilerCleanup();
+}
+
+TimeTraceThreadScope::TimeTraceThreadScope()
+{
+  if (session_active && !llvm::timeTraceProfilerEnabled()) {
+    llvm::timeTraceProfilerInitialize(session_granularity, "twinkle");
+    joined = true;
+  }
+}
+
+TimeTraceThreadScope::~TimeTraceThreadScope()
+{
+  if (joined)
+    llvm::timeTraceProfilerFinishThread();
+}
+
+} // namespace twinkle
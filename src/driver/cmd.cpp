@@ -8,10 +8,14 @@
 #include "cmd.hpp"
 #include <boost/program_options.hpp>
 #include <twinkle/support/utils.hpp>
+#include <twinkle/compile/compile.hpp>
+#include <twinkle/server/server.hpp>
+#include <twinkle/linker/linker.hpp>
 #include <fmt/color.h>
 #include <fmt/core.h>
 #include <fmt/ostream.h>
 #include <iostream>
+#include <unistd.h>
 
 namespace program_options = boost::program_options;
 
@@ -31,20 +35,114 @@ namespace
     ("emit", program_options::value<std::string>()->default_value(EMIT_EXE_ARG),
      "Set a compilation target. Executable file is '" EMIT_EXE_ARG
      "', Assembly file is '" EMIT_ASM_ARG "', "
-     "object file is '" EMIT_OBJ_ARG "', LLVM IR is '" EMIT_LLVMIR_ARG "'.\n"
+     "object file is '" EMIT_OBJ_ARG "', LLVM IR is '" EMIT_LLVMIR_ARG "', "
+     "interface file for imports is '" EMIT_INTERFACE_ARG "'.\n"
      "If there are multiple input files, compile each to the target. Not linked.")
     ("Opt,O", program_options::value<unsigned int>()->default_value(twinkle::DEFAULT_OPT_LEVEL),
      "Specify the optimization level.\n"
      "Possible values are 0 1 2 3 and the meaning is the same as clang.")
+    ("lto", "Perform link-time optimization.\n"
+     "All input files are linked at the IR level, optimized as a whole "
+     "and emitted as a single file named after the first input file. "
+     "Ignored with --JIT.")
+    ("profile-generate",
+     "Instrument the program to write its execution profile.\n"
+     "The profile is written to default.profraw unless LLVM_PROFILE_FILE is "
+     "set, and must be merged with llvm-profdata before use.")
+    ("profile-use", program_options::value<std::string>(),
+     "Optimize with the execution profile (.profdata) created by llvm-profdata.")
+    ("profile-runtime", program_options::value<std::string>(),
+     "Specify the profile runtime library linked with --profile-generate.\n"
+     "Defaults to libclang_rt.profile of the clang installation matching LLVM.")
     ("link,l", program_options::value<std::vector<std::string>>()->multitoken(),
      "Specify library names to be linked.\n"
      "The -l option is passed directly to the linker.")
+    ("linker", program_options::value<std::string>()->default_value(LINKER_GCC_ARG),
+     "Set the linker of executables.\n"
+     "'" LINKER_GCC_ARG "' runs gcc, '" LINKER_LD_ARG "' runs the system linker "
+     "directly and '" LINKER_LLD_ARG "' links in this process with LLD, if "
+     "twinkle is built with it. The last two link the C runtime that gcc does.")
     ("relocation-model",
      program_options::value<std::string>()->default_value("pic"),
      "Set the relocation model. Possible values are 'static' or 'pic'.\n"
      "If llvm is specified for the emit option, this option is disabled.")
     ("target", program_options::value<std::string>(),
      "Specify the name of the target processor.")
+    ("mcpu", program_options::value<std::string>()->default_value("generic"),
+     "Specify the target CPU.\n"
+     "'native' means the host CPU and all its features.")
+    ("march", program_options::value<std::string>(),
+     "Same as --mcpu.\n"
+     "--march, --mcpu and --mattr can also be written with a single dash, "
+     "as in -march=native.")
+    ("mattr", program_options::value<std::string>()->default_value(""),
+     "Enable or disable target features, e.g. '+avx2,-fma'.")
+    ("cache", "Reuse the outputs of unchanged input files from the compilation "
+     "cache.\nWith --JIT, objects of unchanged modules are reused instead.\n"
+     "Ignored with --lto.")
+    ("cache-dir", program_options::value<std::string>(),
+     "Specify the directory of the compilation cache. Implies --cache.\n"
+     "Defaults to $XDG_CACHE_HOME/twinkle or ~/.cache/twinkle.")
+    ("cache-max-size",
+     program_options::value<std::uintmax_t>()->default_value(1024),
+     "Maximum size of the compilation cache in MiB.\n"
+     "Least recently used outputs are evicted beyond it.")
+    ("cache-stats", "Display statistics of the compilation cache.")
+    ("cache-clear", "Remove all outputs in the compilation cache.")
+    ("server", "Run as a compile server that keeps targets and parsed imports "
+     "between compilations.\n"
+     "Serves --use-server on the socket of --server-socket until interrupted.")
+    ("use-server", "Compile on the compile server.\n"
+     "Compiled in this process if no server is running, and always with --JIT.")
+    ("server-socket", program_options::value<std::string>(),
+     "Specify the Unix domain socket of the compile server.\n"
+     "Defaults to $XDG_RUNTIME_DIR/twinkle.sock or twinkle-<uid>.sock in the "
+     "temporary directory.")
+    ("time-trace", "Write the time spent in each phase of the compilation as "
+     "Chrome trace JSON, which can be viewed in chrome://tracing or Perfetto.\n"
+     "The trace is named after the first input file, e.g. 'main.json'.")
+    ("time-trace-file", program_options::value<std::string>(),
+     "Specify the path of the trace. Implies --time-trace.")
+    ("time-trace-granularity",
+     program_options::value<unsigned int>()->default_value(500),
+     "Minimum time in microseconds of the spans written to the trace.")
+    ("jit-tier-threshold",
+     program_options::value<std::uint64_t>()->default_value(
+       twinkle::DEFAULT_JIT_TIER_THRESHOLD),
+     "Number of calls and loop iterations after which the JIT optimizes a "
+     "function and compiles it again.\n"
+     "Functions are compiled without optimization until then.\n"
+     "0 disables tiering and optimizes every function before it first runs.")
+    ("jit-print-tier-up", "Print the functions that the JIT compiles again "
+     "with optimization.")
+    ("jit-threads", program_options::value<unsigned int>()->default_value(0),
+     "Number of threads on which the JIT compiles.\n"
+     "0 means the number of hardware threads.")
+    ("jit-perf", "Write /tmp/perf-<pid>.map and /tmp/jit-<pid>.dump, so that "
+     "perf names the functions compiled by the JIT.\n"
+     "Record with 'perf record -k mono' and run 'perf inject --jit' to use "
+     "the dump.")
+    ("jit-gdb", "Register the code compiled by the JIT with GDB.")
+    ("bench", program_options::value<std::string>(),
+     "Benchmark the specified function, which takes no arguments, instead of "
+     "running main. Requires --JIT.\n"
+     "Prints the minimum, median, 99th percentile and mean of the durations "
+     "of the calls.")
+    ("iterations", program_options::value<std::uint64_t>()->default_value(100),
+     "Number of calls measured by --bench.")
+    ("warmup", program_options::value<std::uint64_t>()->default_value(10),
+     "Number of calls before the ones measured by --bench.\n"
+     "With tiering, the function is then optimized, so that the measured "
+     "calls run the optimized code.")
+    ("bench-counters", "Also count the cycles and instructions of the calls "
+     "measured by --bench with perf_event_open.")
+    ("jobs,j", program_options::value<unsigned int>()->default_value(1),
+     "Number of input files parsed and lowered in parallel.\n"
+     "0 means the number of hardware threads.")
+    ("template-stats", "Print the number of class template instantiations "
+     "and the hit rate of the lookups for them after generating code.")
+    ("x3-parser", "Parse with the grammar written with Boost.Spirit X3 instead "
+     "of the recursive descent parser.")
     ("input-file", program_options::value<std::vector<std::string>>(),
      "Input file. Non-optional arguments are equivalent to this.")
     ;
@@ -53,6 +151,32 @@ namespace
   return desc;
 }
 
+// Rewrites -march=, -mcpu= and -mattr= as in gcc and clang to the long
+// options
+// Other arguments are left to the short options, e.g. -lm and -j4
+[[nodiscard]] std::vector<std::string>
+getArguments(const int argc, const char* const* const argv)
+{
+  std::vector<std::string> args;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg{argv[i]};
+
+    if (arg == "--") {
+      args.insert(args.end(), argv + i, argv + argc);
+      break;
+    }
+
+    if (arg.starts_with("-march=") || arg.starts_with("-mcpu=")
+        || arg.starts_with("-mattr="))
+      args.push_back('-' + std::string{arg});
+    else
+      args.emplace_back(arg);
+  }
+
+  return args;
+}
+
 [[nodiscard]] program_options::variables_map
 getVariableMap(const program_options::options_description& desc,
                const int                                   argc,
@@ -63,11 +187,12 @@ getVariableMap(const program_options::options_description& desc,
   p.add("input-file", -1);
 
   program_options::variables_map v_map;
-  program_options::store(program_options::command_line_parser(argc, argv)
-                           .options(desc)
-                           .positional(p)
-                           .run(),
-                         v_map);
+  program_options::store(
+    program_options::command_line_parser(getArguments(argc, argv))
+      .options(desc)
+      .positional(p)
+      .run(),
+    v_map);
   program_options::notify(v_map);
 
   return v_map;
@@ -90,6 +215,83 @@ std::ostream& writeHelp(std::ostream&                               ostm,
   return ostm << desc;
 }
 
+[[nodiscard]] std::string getCPU(const program_options::variables_map& v_map)
+{
+  if (!v_map.contains("march"))
+    return v_map["mcpu"].as<std::string>();
+
+  if (!v_map["mcpu"].defaulted()) {
+    throw program_options::error{
+      "--mcpu and -march cannot be specified together"};
+  }
+
+  return v_map["march"].as<std::string>();
+}
+
+[[nodiscard]] std::optional<std::string>
+getOptionalString(const program_options::variables_map& v_map,
+                  const std::string&                    name)
+{
+  if (v_map.contains(name))
+    return v_map[name].as<std::string>();
+  else
+    return std::nullopt;
+}
+
+[[nodiscard]] std::string getDefaultCacheDir()
+{
+  if (const auto xdg_cache_home = std::getenv("XDG_CACHE_HOME"))
+    return (std::filesystem::path{xdg_cache_home} / "twinkle").string();
+
+  if (const auto home = std::getenv("HOME"))
+    return (std::filesystem::path{home} / ".cache" / "twinkle").string();
+
+  return (std::filesystem::temp_directory_path() / "twinkle-cache").string();
+}
+
+[[nodiscard]] std::optional<std::string>
+getCacheDir(const program_options::variables_map& v_map)
+{
+  if (v_map.contains("cache-dir"))
+    return v_map["cache-dir"].as<std::string>();
+
+  if (v_map.contains("cache"))
+    return getDefaultCacheDir();
+
+  return std::nullopt;
+}
+
+[[nodiscard]] std::string
+getServerSocket(const program_options::variables_map& v_map)
+{
+  if (v_map.contains("server-socket"))
+    return v_map["server-socket"].as<std::string>();
+
+  if (const auto xdg_runtime_dir = std::getenv("XDG_RUNTIME_DIR"))
+    return (std::filesystem::path{xdg_runtime_dir} / "twinkle.sock").string();
+
+  return (std::filesystem::temp_directory_path()
+          / fmt::format("twinkle-{}.sock", getuid()))
+    .string();
+}
+
+[[nodiscard]] std::optional<std::string>
+getTimeTraceFile(const program_options::variables_map& v_map,
+                 const std::vector<std::string>&       input_files)
+{
+  if (v_map.contains("time-trace-file"))
+    return v_map["time-trace-file"].as<std::string>();
+
+  if (v_map.contains("time-trace")) {
+    return std::filesystem::path{input_files.front()}
+      .filename()
+      .replace_extension(".json")
+      .string();
+  }
+
+  return std::nullopt;
+}
+
 std::vector<std::string>
 getLinkedLibs(const program_options::variables_map& v_map)
 {
@@ -123,6 +325,43 @@ try {
     writeHelp(std::cout, *argv, desc);
     std::exit(EXIT_SUCCESS);
   }
+  else if (v_map.contains("cache-stats")) {
+    twinkle::writeCacheStatistics(
+      std::cout,
+      v_map.contains("cache-dir") ? v_map["cache-dir"].as<std::string>()
+                                  : getDefaultCacheDir(),
+      v_map["cache-max-size"].as<std::uintmax_t>() * 1024 * 1024);
+    std::exit(EXIT_SUCCESS);
+  }
+  else if (v_map.contains("cache-clear")) {
+    std::exit(twinkle::clearCache(v_map.contains("cache-dir")
+                                    ? v_map["cache-dir"].as<std::string>()
+                                    : getDefaultCacheDir())
+                ? EXIT_SUCCESS
+                : EXIT_FAILURE);
+  }
+  else if (v_map.contains("server"))
+    std::exit(twinkle::server::runServer(getServerSocket(v_map), *argv));
+
+  if (v_map.contains("profile-generate") && v_map.contains("profile-use")) {
+    throw program_options::error{
+      "--profile-generate and --profile-use cannot be specified together"};
+  }
+
+  if (v_map.contains("JIT")
+      && (v_map.contains("profile-generate")
+          || v_map.contains("profile-use"))) {
+    throw program_options::error{
+      "--profile-generate and --profile-use cannot be used with --JIT"};
+  }
+
+  if (v_map.contains("bench")) {
+    if (!v_map.contains("JIT"))
+      throw program_options::error{"--bench requires --JIT"};
+
+    if (!v_map["iterations"].as<std::uint64_t>())
+      throw program_options::error{"--iterations must be at least 1"};
+  }
 
   auto input_files = getInputFiles(v_map);
 
@@ -131,15 +370,46 @@ try {
     std::exit(EXIT_FAILURE);
   }
 
-  return {std::move(input_files),
-          v_map.contains("JIT"),
-          stringToLower(v_map["emit"].as<std::string>()),
-          v_map["Opt"].as<unsigned int>(),
-          stringToLower(v_map["relocation-model"].as<std::string>()),
-          getLinkedLibs(v_map),
-          v_map.contains("target")
-            ? std::make_optional(v_map["target"].as<std::string>())
-            : std::nullopt};
+  auto time_trace_file = getTimeTraceFile(v_map, input_files);
+
+  return {
+    .input_files      = std::move(input_files),
+    .jit              = v_map.contains("JIT"),
+    .emit_target      = stringToLower(v_map["emit"].as<std::string>()),
+    .opt_level        = v_map["Opt"].as<unsigned int>(),
+    .lto              = v_map.contains("lto"),
+    .profile_generate = v_map.contains("profile-generate"),
+    .profile_use      = getOptionalString(v_map, "profile-use"),
+    .profile_runtime  = getOptionalString(v_map, "profile-runtime"),
+    .relocation_model = stringToLower(
+      v_map["relocation-model"].as<std::string>()),
+    .linked_libs      = getLinkedLibs(v_map),
+    .linker           = stringToLower(v_map["linker"].as<std::string>()),
+    .target_triple    = getOptionalString(v_map, "target"),
+    .cpu              = getCPU(v_map),
+    .cpu_features     = v_map["mattr"].as<std::string>(),
+    .cache_dir        = getCacheDir(v_map),
+    .cache_max_size
+    = v_map["cache-max-size"].as<std::uintmax_t>() * 1024 * 1024,
+    .server_socket    = v_map.contains("use-server")
+                          ? std::make_optional(getServerSocket(v_map))
+                          : std::nullopt,
+    .time_trace       = std::move(time_trace_file),
+    .time_trace_granularity
+    = v_map["time-trace-granularity"].as<unsigned int>(),
+    .jit_tier_threshold = v_map["jit-tier-threshold"].as<std::uint64_t>(),
+    .jit_print_tier_up  = v_map.contains("jit-print-tier-up"),
+    .jit_threads        = v_map["jit-threads"].as<unsigned int>(),
+    .jit_perf           = v_map.contains("jit-perf"),
+    .jit_gdb            = v_map.contains("jit-gdb"),
+    .bench              = getOptionalString(v_map, "bench"),
+    .bench_iterations   = v_map["iterations"].as<std::uint64_t>(),
+    .bench_warmup       = v_map["warmup"].as<std::uint64_t>(),
+    .bench_counters     = v_map.contains("bench-counters"),
+    .jobs               = v_map["jobs"].as<unsigned int>(),
+    .x3_parser          = v_map.contains("x3-parser"),
+    .template_stats     = v_map.contains("template-stats"),
+  };
 }
 catch (const program_options::error& err) {
   std::cerr << formatError(*argv, err.what())
@@ -7,34 +7,27 @@
 
 #include "cmd.hpp"
 #include <twinkle/compile/compile.hpp>
+#include <twinkle/server/server.hpp>
+#include <twinkle/linker/linker.hpp>
+#include <twinkle/support/time_trace.hpp>
 #include <cstdlib>
 #include <iostream>
 
-// If the 'system' function could not be run, return std::nullopt; otherwise,
-// return linker exit status
-[[nodiscard]] std::optional<int>
-callLinker(const std::vector<std::filesystem::path>& files,
-           const std::vector<std::string>&           linked_libs)
-{
-  if (!system(nullptr))
-    return std::nullopt;
-
-  std::string command = "gcc";
-
-  for (const auto& r : files)
-    command += (' ' + r.string());
-
-  for (const auto& r : linked_libs)
-    command += (" -l" + r);
-
-  return system(command.c_str());
-}
-
 int main(const int argc, const char* const* const argv)
 {
   const auto context = twinkle::parseCmdlineOption(argc, argv);
 
-  const auto result = twinkle::compile(context, *argv);
+  // Written when main returns, so that linking is included
+  std::optional<twinkle::TimeTraceSession> time_trace_session;
+  if (context.time_trace) {
+    time_trace_session.emplace(*context.time_trace,
+                               context.time_trace_granularity,
+                               *argv);
+  }
+
+  const auto result = context.server_socket
+                      ? twinkle::server::compileOnServer(context, *argv)
+                      : twinkle::compile(context, *argv);
 
   if (!result)
     return EXIT_FAILURE;
@@ -49,7 +42,11 @@ int main(const int argc, const char* const* const argv)
     {
       // Call linker
       const auto linker_exit_status
-        = callLinker(aotresult.created_files, context.linked_libs);
+        = twinkle::linker::link(context.linker,
+                                aotresult.created_files,
+                                context.linked_libs,
+                                aotresult.linker_options,
+                                context.relocation_model == "pic");
 
       if (linker_exit_status)
         return *linker_exit_status;
@@ -0,0 +1,63 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#ifndef _4b0e6f2a_8d3c_4e51_9a7f_2c6d1e8b5f93
+#define _4b0e6f2a_8d3c_4e51_9a7f_2c6d1e8b5f93
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <cstddef>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+#include <fmt/printf.h>
+#include <fmt/color.h>
+
+namespace test
+{
+
+// Numbers of the passed and failed checks of the test program
+inline std::size_t pass_c{};
+inline std::size_t fail_c{};
+
+inline void check(const std::string_view name, const bool passed)
+{
+  std::cerr << name << " => ";
+
+  if (passed) {
+    fmt::print(stderr, fg(fmt::terminal_color::bright_green), "Passed!\n");
+    ++pass_c;
+  }
+  else {
+    fmt::print(stderr, fg(fmt::terminal_color::bright_red), "Failed!\n");
+    ++fail_c;
+  }
+}
+
+// Prints the numbers of the checks and returns the exit status of the test
+// program
+[[nodiscard]] inline int printSummary()
+{
+  std::cerr << "--------------------\n";
+  std::cerr << "| " + fmt::format(fg(fmt::terminal_color::bright_red), "Failed")
+                 + ": "
+            << std::setw(10) << fail_c << " |\n";
+  std::cerr << "| "
+                 + fmt::format(fg(fmt::terminal_color::bright_green), "Passed")
+                 + ": "
+            << std::setw(10) << pass_c << " |\n";
+  std::cerr << "--------------------\n";
+
+  return fail_c ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+} // namespace test
+
+#endif
@@ -0,0 +1,667 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include "check.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fmt/core.h>
+
+namespace fs = std::filesystem;
+
+namespace test
+{
+
+// Path of the twinkle executable under test
+std::string twinkle;
+
+struct Output {
+  // -1 if twinkle did not exit normally
+  int         exit_status;
+  std::string text;
+};
+
+// Runs the command in the current directory and captures stdout and stderr
+[[nodiscard]] Output runCommand(const std::string& command)
+{
+  const auto pipe = popen((command + " 2>&1").c_str(), "r");
+
+  if (!pipe)
+    return {-1, ""};
+
+  std::string text;
+  char        buffer[256];
+
+  while (const auto n = std::fread(buffer, 1, sizeof buffer, pipe))
+    text.append(buffer, n);
+
+  const auto status = pclose(pipe);
+
+  return {WIFEXITED(status) ? WEXITSTATUS(status) : -1, std::move(text)};
+}
+
+[[nodiscard]] Output runTwinkle(const std::string_view args)
+{
+  return runCommand(fmt::format("{} {}", twinkle, args));
+}
+
+void writeFile(const fs::path& path, const std::string_view source)
+{
+  std::ofstream{path} << source;
+}
+
+// Short options are not mistaken for the long options that they begin
+void testShortOptions()
+{
+  writeFile("main.twk",
+            "func main() -> i32\n"
+            "{\n"
+            "  return 58;\n"
+            "}\n");
+
+  // -l takes the following arguments up to the next option, so the input
+  // file is put before it
+  fs::remove("a.out");
+  check("-l m",
+        !runTwinkle("main.twk -l m").exit_status
+          && runCommand("./a.out").exit_status == 58);
+
+  writeFile("sub.twk",
+            "pub func sub() -> i32\n"
+            "{\n"
+            "  return 10;\n"
+            "}\n");
+
+  fs::remove("main.o");
+  fs::remove("sub.o");
+  check("-j 4",
+        !runTwinkle("-j 4 --emit=obj main.twk sub.twk").exit_status
+          && fs::exists("main.o") && fs::exists("sub.o"));
+
+  check("-j4", !runTwinkle("-j4 --emit=obj main.twk sub.twk").exit_status);
+
+  check("-march=native",
+        runTwinkle("--JIT -march=native main.twk").exit_status == 58);
+
+  check("-mcpu= and -mattr=",
+        runTwinkle("--JIT -mcpu=generic -mattr=+sse2 main.twk").exit_status
+          == 58);
+
+  check("--mcpu with -march",
+        runTwinkle("--JIT --mcpu=generic -march=native main.twk")
+            .text.find("cannot be specified together")
+          != std::string::npos);
+}
+
+// Profiles are only written and used by compiled executables
+void testProfileWithJIT()
+{
+  writeFile("main.twk",
+            "func main() -> i32\n"
+            "{\n"
+            "  return 58;\n"
+            "}\n");
+
+  check("--profile-generate with --JIT",
+        runTwinkle("--JIT --profile-generate main.twk")
+            .text.find("cannot be used with --JIT")
+          != std::string::npos);
+
+  check("--profile-use with --JIT",
+        runTwinkle("--JIT --profile-use=default.profdata main.twk")
+            .text.find("cannot be used with --JIT")
+          != std::string::npos);
+}
+
+// Returns the hits and misses that --cache-stats prints for the cache in
+// 'cache_dir'
+[[nodiscard]] std::pair<std::uint64_t, std::uint64_t>
+getCacheHitsAndMisses(const std::string_view cache_dir)
+{
+  std::istringstream statistics{
+    runTwinkle(fmt::format("--cache-dir={} --cache-stats", cache_dir)).text};
+
+  std::uint64_t hits{};
+  std::uint64_t misses{};
+
+  for (std::string name; statistics >> name;) {
+    if (name == "hits")
+      statistics >> hits;
+    else if (name == "misses")
+      statistics >> misses;
+  }
+
+  return {hits, misses};
+}
+
+// Outputs are reused until the file or an import of it changes
+void testCache()
+{
+  using Statistics = std::pair<std::uint64_t, std::uint64_t>;
+
+  writeFile("main.twk",
+            "import \"./sub.twk\";\n"
+            "\n"
+            "func main() -> i32\n"
+            "{\n"
+            "  return sub();\n"
+            "}\n");
+  writeFile("sub.twk",
+            "pub func sub() -> i32\n"
+            "{\n"
+            "  return 58;\n"
+            "}\n");
+
+  const auto compile = [] {
+    return !runTwinkle("--cache-dir=cache --emit=obj main.twk").exit_status;
+  };
+
+  fs::remove_all("cache");
+
+  check("cache miss",
+        compile() && getCacheHitsAndMisses("cache") == Statistics{0, 1});
+
+  check("cache hit",
+        compile() && getCacheHitsAndMisses("cache") == Statistics{1, 1});
+
+  check("cache hit with another spelling of the path",
+        !runTwinkle("--cache-dir=cache --emit=obj ./main.twk").exit_status
+          && getCacheHitsAndMisses("cache") == Statistics{2, 1});
+
+  writeFile("sub.twk",
+            "pub func sub() -> i32\n"
+            "{\n"
+            "  return 10;\n"
+            "}\n");
+
+  check("cache invalidated by an import",
+        compile() && getCacheHitsAndMisses("cache") == Statistics{2, 2});
+
+  writeFile("main.twk",
+            "import \"./sub.twk\";\n"
+            "\n"
+            "func main() -> i32\n"
+            "{\n"
+            "  return sub() + 48;\n"
+            "}\n");
+
+  check("cache invalidated by the file",
+        compile() && getCacheHitsAndMisses("cache") == Statistics{2, 3});
+
+  check("cache hit after invalidation",
+        compile() && getCacheHitsAndMisses("cache") == Statistics{3, 3});
+
+  // Outputs stored again replace the existing ones without growing the size
+  const auto getSize = [] {
+    std::ifstream statistics{"cache/stats"};
+
+    std::string   name;
+    std::uint64_t value;
+
+    while (statistics >> name >> value) {
+      if (name == "size")
+        return value;
+    }
+
+    return std::uint64_t{};
+  };
+
+  const auto size = getSize();
+
+  fs::remove_all("cache/manifests");
+
+  check("cache size after storing the same outputs again",
+        compile() && size && getSize() == size);
+}
+
+// Objects compiled by the JIT are loaded by later runs without optimizing the
+// modules again, until the cache is cleared
+void testJitCache()
+{
+  using Statistics = std::pair<std::uint64_t, std::uint64_t>;
+
+  writeFile("jit.twk",
+            "func main() -> i32\n"
+            "{\n"
+            "  return 58;\n"
+            "}\n");
+
+  // The trace tells whether the modules are optimized
+  const auto run = [] {
+    return runTwinkle("--JIT --cache-dir=jit_cache --time-trace "
+                      "--time-trace-granularity=0 jit.twk")
+             .exit_status
+           == 58;
+  };
+
+  const auto optimized = [] {
+    std::ifstream     file{"jit.json"};
+    std::stringstream trace;
+    trace << file.rdbuf();
+    return trace.str().find("\"JIT optimize\"") != std::string::npos;
+  };
+
+  fs::remove_all("jit_cache");
+
+  check("--JIT cache miss", run() && optimized());
+
+  const auto [hits, misses] = getCacheHitsAndMisses("jit_cache");
+
+  check("--JIT cache hit",
+        !hits && misses && run() && !optimized()
+          && getCacheHitsAndMisses("jit_cache") == Statistics{misses, misses});
+
+  check("--cache-clear",
+        !runTwinkle("--cache-dir=jit_cache --cache-clear").exit_status
+          && !fs::exists("jit_cache/objects") && run() && optimized()
+          && getCacheHitsAndMisses("jit_cache")
+               == Statistics{misses, misses * 2});
+}
+
+// The executable is the same whichever linker creates it
+void testLinkers()
+{
+  writeFile("main.twk",
+            "func main() -> i32\n"
+            "{\n"
+            "  return 58;\n"
+            "}\n");
+
+  fs::remove("a.out");
+  check("--linker=ld",
+        !runTwinkle("--linker=ld main.twk").exit_status
+          && runCommand("./a.out").exit_status == 58);
+
+  fs::remove("a.out");
+  check("--linker=ld with --relocation-model=static",
+        !runTwinkle("--linker=ld --relocation-model=static main.twk")
+           .exit_status
+          && runCommand("./a.out").exit_status == 58);
+
+#ifdef TWINKLE_HAVE_LLD
+  fs::remove("a.out");
+  check("--linker=lld",
+        !runTwinkle("--linker=lld main.twk").exit_status
+          && runCommand("./a.out").exit_status == 58);
+
+  fs::remove("a.out");
+  check("--linker=lld with --relocation-model=static",
+        !runTwinkle("--linker=lld --relocation-model=static main.twk")
+           .exit_status
+          && runCommand("./a.out").exit_status == 58);
+#else
+  check("--linker=lld without LLD",
+        runTwinkle("--linker=lld main.twk").exit_status == EXIT_FAILURE);
+#endif
+
+  // The exit status of the linker is that of twinkle
+  check("-l of a missing library",
+        runTwinkle("main.twk -l twinkle_missing_library").exit_status);
+
+  check("-l of a missing library with --linker=ld",
+        runTwinkle("--linker=ld main.twk -l twinkle_missing_library")
+          .exit_status);
+}
+
+// Spans of functions and classes name the file that they are in, as files are
+// compiled in parallel
+void testTimeTrace()
+{
+  writeFile("main.twk",
+            "class C {\n"
+            "}\n"
+            "\n"
+            "func main() -> i32\n"
+            "{\n"
+            "  return 58;\n"
+            "}\n");
+
+  fs::remove("trace.json");
+
+  if (runTwinkle("--time-trace-file=trace.json --time-trace-granularity=0 "
+                 "--emit=obj main.twk")
+        .exit_status) {
+    check("--time-trace", false);
+    return;
+  }
+
+  std::ostringstream trace;
+  trace << std::ifstream{"trace.json"}.rdbuf();
+
+  check("--time-trace function span",
+        trace.str().find("\"main (main.twk)\"") != std::string::npos);
+
+  check("--time-trace class span",
+        trace.str().find("\"C (main.twk)\"") != std::string::npos);
+}
+
+// Functions that become hot are compiled again with optimization while the
+// program runs
+void testTierUp()
+{
+  writeFile("tier.twk",
+            "func add(a: i32, b: i32) -> i32\n"
+            "{\n"
+            "  return a + b;\n"
+            "}\n"
+            "\n"
+            "func work() -> i32\n"
+            "{\n"
+            "  let mut sum = 0;\n"
+            "\n"
+            "  for (let mut i = 0; i < 1000000; ++i)\n"
+            "    sum = add(sum, 1) % 100;\n"
+            "\n"
+            "  return sum + 58;\n"
+            "}\n"
+            "\n"
+            "func main() -> i32\n"
+            "{\n"
+            "  return work();\n"
+            "}\n");
+
+  check("--jit-tier-threshold=1",
+        runTwinkle("--JIT --jit-tier-threshold=1 tier.twk").exit_status == 58);
+
+  // The tier-ups requested during the warmup are waited for, so both
+  // functions are optimized
+  const auto output
+    = runTwinkle("--JIT --jit-tier-threshold=2 --jit-print-tier-up "
+                 "--bench=work --warmup=5 --iterations=3 tier.twk");
+
+  std::size_t num_tier_ups = 0;
+
+  for (auto pos = output.text.find("tier-up: "); pos != std::string::npos;
+       pos      = output.text.find("tier-up: ", pos + 1))
+    ++num_tier_ups;
+
+  check("--jit-print-tier-up", !output.exit_status && num_tier_ups == 2);
+
+  // Tiering is opt-in, so a loop in main, which is called only once, runs
+  // optimized by default
+  writeFile("loop.twk",
+            "func main() -> i32\n"
+            "{\n"
+            "  let mut sum = 0;\n"
+            "\n"
+            "  for (let mut i = 0; i < 100000000; ++i)\n"
+            "    sum = (sum + i) % 7;\n"
+            "\n"
+            "  return sum;\n"
+            "}\n");
+
+  const auto measure = [](const std::string& args) {
+    const auto start  = std::chrono::steady_clock::now();
+    const auto output = runTwinkle(args);
+    return std::pair{output, std::chrono::steady_clock::now() - start};
+  };
+
+  const auto [by_default, default_duration]
+    = measure("--JIT -O2 --jit-print-tier-up loop.twk");
+
+  const auto [tiered, tiered_duration]
+    = measure("--JIT -O2 --jit-tier-threshold=1000 loop.twk");
+
+  check("no tier-up by default",
+        by_default.exit_status == tiered.exit_status
+          && by_default.text.find("tier-up: ") == std::string::npos);
+
+  check("--JIT -O2 loop in main not slower than with tiering",
+        default_duration <= tiered_duration);
+}
+
+// The measured calls run the optimized code whatever the warmup is
+void testBenchmarkWarmup()
+{
+  writeFile("bench.twk",
+            "func one() -> i32\n"
+            "{\n"
+            "  return 1;\n"
+            "}\n");
+
+  const auto below = runTwinkle("--JIT --bench=one --warmup=10 --iterations=1 "
+                                "--jit-tier-threshold=100 --jit-print-tier-up "
+                                "bench.twk");
+
+  check("--warmup below --jit-tier-threshold",
+        below.text.find("1 iterations, 10 warmup") != std::string::npos
+          && below.text.find("tier-up: _Z3oneE") != std::string::npos);
+
+  const auto above = runTwinkle("--JIT --bench=one --warmup=10 --iterations=1 "
+                                "--jit-tier-threshold=5 --jit-print-tier-up "
+                                "bench.twk");
+
+  // Requested by the counter and then by the benchmark, but tiered up once
+  const auto tier_up = above.text.find("tier-up: _Z3oneE");
+
+  check("--warmup above --jit-tier-threshold",
+        above.text.find("1 iterations, 10 warmup") != std::string::npos
+          && tier_up != std::string::npos
+          && tier_up == above.text.rfind("tier-up: "));
+
+  const auto no_warmup = runTwinkle("--JIT --bench=one --warmup=0 "
+                                    "--iterations=1 --jit-tier-threshold=5 "
+                                    "--jit-print-tier-up bench.twk");
+
+  check("--warmup=0 with tiering",
+        !no_warmup.exit_status
+          && no_warmup.text.find("tier-up: _Z3oneE") != std::string::npos);
+
+  const auto counters
+    = runTwinkle("--JIT --bench=one --iterations=1 --bench-counters bench.twk")
+        .text;
+
+  check("--bench-counters",
+        counters.find("IPC:") != std::string::npos
+          || counters.find("counters:     unavailable") != std::string::npos);
+}
+
+[[nodiscard]] std::string readFile(const fs::path& path)
+{
+  std::ostringstream text;
+  text << std::ifstream{path, std::ios_base::binary}.rdbuf();
+  return text.str();
+}
+
+// Imports read the interface of a file instead of its source when it is up to
+// date with the source, or when the source is missing
+void testInterfaces()
+{
+  constexpr std::string_view lib_source = "pub func lib() -> i32\n"
+                                          "{\n"
+                                          "  return 48;\n"
+                                          "}\n"
+                                          "\n"
+                                          "func hidden() -> i32\n"
+                                          "{\n"
+                                          "  return 1;\n"
+                                          "}\n";
+
+  writeFile("lib.twk", lib_source);
+  fs::remove("lib.twki");
+
+  const auto emitted = !runTwinkle("--emit=interface lib.twk").exit_status;
+  const auto interface = readFile("lib.twki");
+
+  check("--emit=interface",
+        emitted && interface.starts_with("TWKI")
+          && interface.find("pub func lib() -> i32 {}") != std::string::npos
+          && interface.find("return 48") == std::string::npos
+          && interface.find("hidden") == std::string::npos);
+
+  // An interface that is up to date with lib.twk but declares another
+  // function, so that the import shows which one was read
+  // The header of the magic, version, source size and source hash is 24 bytes
+  writeFile("lib.twk",
+            "pub func other() -> i32\n"
+            "{\n"
+            "  return 10;\n"
+            "}\n");
+
+  if (runTwinkle("--emit=interface lib.twk").exit_status) {
+    check("import of an interface", false);
+    return;
+  }
+
+  writeFile("lib.twki",
+            interface.substr(0, 24) + readFile("lib.twki").substr(24));
+  writeFile("lib.twk", lib_source);
+
+  writeFile("main.twk",
+            "import \"./lib.twk\";\n"
+            "\n"
+            "func main() -> i32\n"
+            "{\n"
+            "  return other();\n"
+            "}\n");
+
+  check("import of an interface",
+        !runTwinkle("--emit=obj main.twk").exit_status);
+
+  // The source has changed since the interface was written
+  writeFile("lib.twk",
+            "pub func newer() -> i32\n"
+            "{\n"
+            "  return 10;\n"
+            "}\n");
+
+  writeFile("main.twk",
+            "import \"./lib.twk\";\n"
+            "\n"
+            "func main() -> i32\n"
+            "{\n"
+            "  return newer();\n"
+            "}\n");
+
+  check("import of a source newer than its interface",
+        !runTwinkle("--emit=obj main.twk").exit_status);
+
+  // The interface is read without the source
+  writeFile("lib.twk", lib_source);
+  check("--emit=interface over an existing interface",
+        !runTwinkle("--emit=interface lib.twk").exit_status);
+  fs::remove("lib.twk");
+
+  writeFile("main.twk",
+            "import \"./lib.twk\";\n"
+            "\n"
+            "func main() -> i32\n"
+            "{\n"
+            "  return lib() + 10;\n"
+            "}\n");
+
+  check("import of an interface without its source",
+        !runTwinkle("--emit=obj main.twk").exit_status);
+}
+
+// Compilations are forwarded to a running compile server, which sends back
+// the created files and the diagnostics
+void testServer()
+{
+  writeFile("main.twk",
+            "func main() -> i32\n"
+            "{\n"
+            "  return 58;\n"
+            "}\n");
+
+  writeFile("bad.twk",
+            "func main() -> i32\n"
+            "{\n"
+            "  let x: Unknown;\n"
+            "  return 0;\n"
+            "}\n");
+
+  fs::remove("server.sock");
+
+  const auto pid = runCommand(fmt::format("{} --server --server-socket="
+                                          "server.sock > server.log 2>&1 "
+                                          "& echo $!",
+                                          twinkle))
+                     .text;
+
+  for (int i = 0; i < 100 && !fs::exists("server.sock"); ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+
+  check("--server", fs::exists("server.sock"));
+
+  fs::remove("main.o");
+  check("--use-server object",
+        !runTwinkle("--use-server --server-socket=server.sock --emit=obj "
+                    "main.twk")
+           .exit_status
+          && fs::exists("main.o"));
+
+  fs::remove("a.out");
+  check("--use-server executable",
+        !runTwinkle("--use-server --server-socket=server.sock main.twk")
+           .exit_status
+          && runCommand("./a.out").exit_status == 58);
+
+  const auto bad
+    = runTwinkle("--use-server --server-socket=server.sock --emit=obj bad.twk");
+
+  check("--use-server diagnostics",
+        bad.exit_status
+          && bad.text.find("In file bad.twk, line 3") != std::string::npos
+          && bad.text.find("unknown type name specified")
+               != std::string::npos);
+
+  // The server removes its socket when it is interrupted
+  static_cast<void>(runCommand("kill " + pid));
+
+  for (int i = 0; i < 100 && fs::exists("server.sock"); ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+
+  check("--server stopped",
+        !fs::exists("server.sock")
+          && readFile("server.log").find("listening on server.sock")
+               != std::string::npos);
+}
+
+} // namespace test
+
+int main(const int argc, const char* const* const argv)
+{
+  if (argc != 2) {
+    std::cerr << "Invalid commandline arguments!" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+
+  test::twinkle = fs::absolute(argv[1]).string();
+
+  const auto work_dir
+    = fs::temp_directory_path() / fmt::format("twinkle-driver-{}", getpid());
+
+  fs::create_directories(work_dir);
+  fs::current_path(work_dir);
+
+  test::testShortOptions();
+  test::testProfileWithJIT();
+  test::testCache();
+  test::testJitCache();
+  test::testLinkers();
+  test::testTimeTrace();
+  test::testTierUp();
+  test::testBenchmarkWarmup();
+  test::testInterfaces();
+  test::testServer();
+
+  fs::current_path(fs::temp_directory_path());
+  fs::remove_all(work_dir);
+
+  return test::printSummary();
+}
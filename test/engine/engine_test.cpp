@@ -0,0 +1,213 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include "check.hpp"
+#include <twinkle/engine/engine.hpp>
+#include <twinkle/engine/c_api.h>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+
+namespace test
+{
+
+void testEngine()
+{
+  std::vector<twinkle::Diagnostic> diagnostics;
+
+  auto engine = twinkle::Engine::create({}, diagnostics);
+  check("create", engine && diagnostics.empty());
+
+  if (!engine)
+    return;
+
+  const auto a = engine->addModule("a.twk",
+                                   "pub func add(a: i32, b: i32) -> i32\n"
+                                   "{\n"
+                                   "  return a + b;\n"
+                                   "}\n"
+                                   "func helper() -> i32\n"
+                                   "{\n"
+                                   "  return 42;\n"
+                                   "}\n"
+                                   "pub func answer() -> i32\n"
+                                   "{\n"
+                                   "  return helper();\n"
+                                   "}\n");
+  check("add_module", a && engine->getDiagnostics().empty());
+
+  const auto add = engine->lookup<int(int, int)>("add");
+  check("typed_lookup", add && add(40, 2) == 42);
+
+  check("private_function", !engine->lookup<int()>("helper"));
+
+  // Modules added later call the functions of the others
+  const auto b = engine->addModule("b.twk",
+                                   "declare func answer() -> i32;\n"
+                                   "pub func twice() -> i32\n"
+                                   "{\n"
+                                   "  return answer() * 2;\n"
+                                   "}\n");
+  const auto twice = engine->lookup<int()>("twice");
+  check("incremental_module", b && twice && twice() == 84);
+
+  const auto syntax_error = engine->addModule("c.twk",
+                                              "func f() -> i32\n"
+                                              "{\n"
+                                              "  return 1\n"
+                                              "}\n");
+  check("syntax_error",
+        !syntax_error && engine->getDiagnostics().size() == 1
+          && engine->getDiagnostics().front().file == "c.twk"
+          && engine->getDiagnostics().front().line == 3
+          && engine->getDiagnostics().front().column == 3);
+
+  const auto codegen_error = engine->addModule("d.twk",
+                                               "func f() -> i32\n"
+                                               "{\n"
+                                               "  return x;\n"
+                                               "}\n");
+  check("codegen_error",
+        !codegen_error && engine->getDiagnostics().size() == 1
+          && engine->getDiagnostics().front().file == "d.twk"
+          && engine->getDiagnostics().front().line == 3
+          && engine->getDiagnostics().front().column == 10);
+
+  // Unknown types are reported at the members and arguments that name them
+  const auto unknown_member_type = engine->addModule("e.twk",
+                                                     "class A {\n"
+                                                     "  let x: i32;\n"
+                                                     "  let mut y: &Foo;\n"
+                                                     "}\n");
+  check("unknown_member_type",
+        !unknown_member_type && engine->getDiagnostics().size() == 1
+          && engine->getDiagnostics().front().file == "e.twk"
+          && engine->getDiagnostics().front().line == 3);
+
+  const auto unknown_template_argument
+    = engine->addModule("f.twk",
+                        "class B<T> {\n"
+                        "  let x: T;\n"
+                        "}\n"
+                        "func f() -> i32\n"
+                        "{\n"
+                        "  let b: B<^Foo>;\n"
+                        "  return 1;\n"
+                        "}\n");
+  check("unknown_template_argument",
+        !unknown_template_argument && engine->getDiagnostics().size() == 1
+          && engine->getDiagnostics().front().file == "f.twk"
+          && engine->getDiagnostics().front().line == 6);
+
+  // The module can be replaced by one with the same functions
+  check("remove_module", b && engine->removeModule(*b));
+  check("removed_function", !engine->lookup<int()>("twice"));
+
+  const auto b2 = engine->addModule("b.twk",
+                                    "declare func answer() -> i32;\n"
+                                    "pub func twice() -> i32\n"
+                                    "{\n"
+                                    "  return answer() * 3;\n"
+                                    "}\n");
+  const auto thrice = engine->lookup<int()>("twice");
+  check("replace_module", b2 && thrice && thrice() == 126);
+}
+
+// Modules are parsed with the grammar written with Boost.Spirit X3
+void testX3Parser()
+{
+  std::vector<twinkle::Diagnostic> diagnostics;
+
+  twinkle::EngineOptions options;
+  options.x3_parser = true;
+
+  auto engine = twinkle::Engine::create(options, diagnostics);
+  check("x3_create", engine && diagnostics.empty());
+
+  if (!engine)
+    return;
+
+  const auto module = engine->addModule("x3.twk",
+                                        "pub func seven() -> i32\n"
+                                        "{\n"
+                                        "  return 7;\n"
+                                        "}\n");
+  const auto seven  = engine->lookup<int()>("seven");
+  check("x3_add_module", module && seven && seven() == 7);
+
+  const auto syntax_error = engine->addModule("x3_error.twk",
+                                              "func f() -> i32\n"
+                                              "{\n"
+                                              "  return 1\n"
+                                              "}\n");
+  check("x3_syntax_error",
+        !syntax_error && engine->getDiagnostics().size() == 1
+          && engine->getDiagnostics().front().file == "x3_error.twk");
+}
+
+void testCApi()
+{
+  auto const engine = twinkle_engine_create(nullptr);
+  check("c_create", engine);
+
+  if (!engine)
+    return;
+
+  const char* const source = "pub func square(n: i64) -> i64\n"
+                             "{\n"
+                             "  return n * n;\n"
+                             "}\n";
+
+  twinkle_module module;
+  check("c_add_module",
+        twinkle_engine_add_module(engine,
+                                  "square.twk",
+                                  source,
+                                  std::strlen(source),
+                                  &module)
+          == 0);
+
+  const auto square = reinterpret_cast<std::int64_t (*)(std::int64_t)>(
+    twinkle_engine_lookup(engine, "square"));
+  check("c_lookup", square && square(9) == 81);
+
+  check("c_diagnostics",
+        !twinkle_engine_lookup(engine, "cube")
+          && twinkle_engine_diagnostic_count(engine) == 1
+          && std::strlen(twinkle_engine_diagnostic(engine, 0).message));
+
+  check("c_diagnostic_out_of_range",
+        !twinkle_engine_diagnostic(engine, 1).message
+          && !twinkle_engine_diagnostic(engine, 1).file);
+
+  check("c_remove_module", twinkle_engine_remove_module(engine, module) == 0);
+
+  check("c_create_error_after_success", !twinkle_engine_create_error());
+
+  twinkle_engine_destroy(engine);
+
+  // The reasons are returned instead of written to stderr
+  twinkle_engine_options options;
+  twinkle_engine_options_init(&options);
+  options.opt_level = 4;
+
+  check("c_create_error",
+        !twinkle_engine_create(&options) && twinkle_engine_create_error()
+          && std::string_view{twinkle_engine_create_error()}
+               == "invalid optimization level");
+}
+
+} // namespace test
+
+int main()
+{
+  test::testEngine();
+  test::testX3Parser();
+  test::testCApi();
+
+  return test::printSummary();
+}
@@ -0,0 +1,350 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include "check.hpp"
+#include <twinkle/ast/ast_adapted.hpp>
+#include <twinkle/parse/parser.hpp>
+#include <twinkle/parse/import_cache.hpp>
+#include <twinkle/parse/exception.hpp>
+#include <boost/core/demangle.hpp>
+#include <boost/fusion/include/at_c.hpp>
+#include <boost/fusion/include/size.hpp>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <fmt/printf.h>
+
+namespace test
+{
+
+namespace parse = twinkle::parse;
+namespace ast   = twinkle::ast;
+
+template <typename T>
+struct IsVariant : std::false_type {};
+
+template <typename... Ts>
+struct IsVariant<boost::variant<Ts...>> : std::true_type {};
+
+template <typename T>
+struct IsOptional : std::false_type {};
+
+template <typename T>
+struct IsOptional<std::optional<T>> : std::true_type {};
+
+// Compares the ASTs and the positions of the nodes
+struct Comparer {
+  const parse::Parser::Result& lhs_result;
+  const parse::Parser::Result& rhs_result;
+
+  // The first difference
+  std::string difference{};
+
+  template <typename T>
+  bool operator()(const T& lhs, const T& rhs)
+  {
+    if (equal(lhs, rhs))
+      return true;
+
+    // The innermost node is the first different one
+    if (difference.empty() || difference.ends_with(" of "))
+      difference += boost::core::demangle(typeid(T).name());
+
+    return false;
+  }
+
+private:
+  template <typename T>
+  bool equal(const T& lhs, const T& rhs)
+  {
+    if constexpr (std::is_same_v<T, ast::ClassMemberInit>) {
+      return (*this)(static_cast<const ast::Assignment&>(lhs),
+                     static_cast<const ast::Assignment&>(rhs));
+    }
+    else if constexpr (boost::fusion::traits::is_sequence<T>::value) {
+      if constexpr (std::is_base_of_v<boost::spirit::x3::position_tagged, T>) {
+        if (!equalPositions(lhs, rhs))
+          return false;
+      }
+
+      return equalFields(
+        lhs,
+        rhs,
+        std::make_index_sequence<boost::fusion::result_of::size<T>::value>{});
+    }
+    else if constexpr (IsVariant<T>::value) {
+      if (lhs.which() != rhs.which())
+        return false;
+
+      return boost::apply_visitor(
+        [&](const auto& lhs_value) {
+          using Value = std::decay_t<decltype(lhs_value)>;
+          return (*this)(lhs_value, boost::get<Value>(rhs));
+        },
+        lhs);
+    }
+    else if constexpr (IsOptional<T>::value) {
+      if (lhs.has_value() != rhs.has_value())
+        return false;
+
+      return !lhs || (*this)(*lhs, *rhs);
+    }
+    else if constexpr (std::is_same_v<T, std::u32string>
+                       || std::is_same_v<T, std::unordered_set<
+                                              twinkle::VariableQual>>) {
+      return lhs == rhs;
+    }
+    else if constexpr (std::ranges::range<T>) {
+      return std::ranges::equal(lhs, rhs, [this](const auto& l, const auto& r) {
+        return (*this)(l, r);
+      });
+    }
+    else
+      return lhs == rhs;
+  }
+
+  template <typename T, std::size_t... Indices>
+  bool equalFields(const T& lhs, const T& rhs, std::index_sequence<Indices...>)
+  {
+    return ((*this)(boost::fusion::at_c<Indices>(lhs),
+                    boost::fusion::at_c<Indices>(rhs))
+            && ...);
+  }
+
+  bool equalPositions(const boost::spirit::x3::position_tagged& lhs,
+                      const boost::spirit::x3::position_tagged& rhs)
+  {
+    if (lhs.id_first == -1 || rhs.id_first == -1)
+      return lhs.id_first == rhs.id_first;
+
+    const auto lhs_range = lhs_result.positions->positionOf(lhs);
+    const auto rhs_range = rhs_result.positions->positionOf(rhs);
+
+    const auto lhs_first = lhs_result.source->getText().cbegin();
+    const auto rhs_first = rhs_result.source->getText().cbegin();
+
+    const std::pair lhs_offsets{lhs_range.begin().base() - lhs_first,
+                                lhs_range.end().base() - lhs_first};
+    const std::pair rhs_offsets{rhs_range.begin().base() - rhs_first,
+                                rhs_range.end().base() - rhs_first};
+
+    if (lhs_offsets == rhs_offsets)
+      return true;
+
+    difference = fmt::format("[{}, {}) and [{}, {}) of ",
+                             lhs_offsets.first,
+                             lhs_offsets.second,
+                             rhs_offsets.first,
+                             rhs_offsets.second);
+    return false;
+  }
+};
+
+using Clock = std::chrono::steady_clock;
+
+struct ParseOutcome {
+  std::optional<parse::Parser::Result> result;
+  std::optional<twinkle::Diagnostic>   diagnostic;
+  Clock::duration                      duration;
+};
+
+[[nodiscard]] ParseOutcome parseWith(const parse::ParserKind kind,
+                                     const std::string&      input)
+{
+  std::ostringstream diagnostics;
+
+  ParseOutcome outcome;
+
+  const auto start = Clock::now();
+
+  try {
+    outcome.result
+      = parse::Parser{std::string{input}, "test", kind, diagnostics}
+          .getResult();
+  }
+  catch (const parse::ParseError& err) {
+    outcome.diagnostic = err.getDiagnostic();
+  }
+
+  outcome.duration = Clock::now() - start;
+
+  return outcome;
+}
+
+[[nodiscard]] std::string readFile(const std::filesystem::path& path)
+{
+  std::ifstream file{path};
+
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+
+  return buffer.str();
+}
+
+// Totals of the inputs that both parsers parsed
+std::size_t     num_bytes{};
+Clock::duration x3_duration{};
+Clock::duration recursive_descent_duration{};
+
+void testSame(const std::string_view name, const std::string& input)
+{
+  const auto x3 = parseWith(parse::ParserKind::x3, input);
+  const auto recursive_descent
+    = parseWith(parse::ParserKind::recursive_descent, input);
+
+  if (x3.result && recursive_descent.result) {
+    Comparer comparer{*x3.result, *recursive_descent.result};
+
+    const auto same
+      = comparer(x3.result->ast, recursive_descent.result->ast);
+
+    if (!same)
+      std::cerr << "The first different node: " << comparer.difference << '\n';
+
+    check(name, same);
+
+    num_bytes += input.size();
+    x3_duration += x3.duration;
+    recursive_descent_duration += recursive_descent.duration;
+    return;
+  }
+
+  if (x3.diagnostic && recursive_descent.diagnostic) {
+    const auto& lhs = *x3.diagnostic;
+    const auto& rhs = *recursive_descent.diagnostic;
+
+    const auto same = lhs.line == rhs.line && lhs.column == rhs.column
+                      && lhs.message == rhs.message;
+
+    if (!same) {
+      for (const auto& diagnostic : {lhs, rhs}) {
+        std::cerr << fmt::format("{}:{}: {}\n",
+                                 diagnostic.line,
+                                 diagnostic.column,
+                                 diagnostic.message);
+      }
+    }
+
+    check(name, same);
+    return;
+  }
+
+  check(name, false);
+}
+
+void testCases(const std::filesystem::path& test_dir)
+{
+  for (const auto& entry :
+       std::filesystem::recursive_directory_iterator{test_dir}) {
+    if (!entry.is_regular_file())
+      continue;
+
+    testSame(entry.path().lexically_relative(test_dir).string(),
+             readFile(entry.path()));
+  }
+}
+
+void testSyntaxErrors()
+{
+  testSame("missing_operand", "func main() -> i32\n"
+                              "{\n"
+                              "  return 1 +;\n"
+                              "}\n");
+
+  testSame("missing_semicolon", "func main() -> i32\n"
+                                "{\n"
+                                "  let x = 1\n"
+                                "  return x;\n"
+                                "}\n");
+
+  testSame("unterminated_string_literal", "func main() -> i32\n"
+                                          "{\n"
+                                          "  let s = \"abc;\n"
+                                          "}\n");
+
+  testSame("missing_condition_parenthesis", "func main() -> i32\n"
+                                            "{\n"
+                                            "  if 1 {}\n"
+                                            "}\n");
+
+  testSame("missing_return_type", "func main() -> {}\n");
+
+  testSame("missing_member_type", "class A {\n"
+                                  "  let x: ;\n"
+                                  "}\n");
+
+  testSame("empty_union", "union U {\n}\n");
+
+  testSame("unexpected_top_level", "func main() -> i32 {}\n"
+                                   "42\n");
+}
+
+// Importers that spell the path of a file differently share its result, which
+// has the canonical path, unless they use different kinds of parsers
+void testImportCache(const std::filesystem::path& test_dir)
+{
+  const auto path = test_dir / "import_function" / "b";
+  const auto other_path
+    = test_dir / "import_function" / ".." / "import_function" / "b";
+
+  const auto parse = [](const std::filesystem::path& file,
+                        const parse::ParserKind      kind) {
+    return [file, kind] {
+      return parse::Parser{readFile(file), file, kind}.getResult();
+    };
+  };
+
+  constexpr auto rd = parse::ParserKind::recursive_descent;
+  constexpr auto x3 = parse::ParserKind::x3;
+
+  parse::ImportCache cache;
+
+  const auto result = cache.load(path, rd, parse(path, rd));
+  const auto other_result
+    = cache.load(other_path, rd, parse(other_path, rd));
+  const auto x3_result = cache.load(path, x3, parse(path, x3));
+
+  check("import_cache_shared_result", result == other_result);
+  check("import_cache_canonical_path",
+        result->file == std::filesystem::canonical(path));
+  check("import_cache_keyed_by_parser_kind",
+        x3_result != result
+          && x3_result == cache.load(path, x3, parse(path, x3)));
+}
+
+void printThroughput()
+{
+  const auto megabytesPerSecond = [](const Clock::duration duration) {
+    const auto seconds = std::chrono::duration<double>{duration}.count();
+    return static_cast<double>(num_bytes) / 1'000'000 / seconds;
+  };
+
+  std::cerr << fmt::format("Parsed {} bytes: X3 {:.2f} MB/s, recursive "
+                           "descent {:.2f} MB/s\n",
+                           num_bytes,
+                           megabytesPerSecond(x3_duration),
+                           megabytesPerSecond(recursive_descent_duration));
+}
+
+} // namespace test
+
+int main(const int argc, const char* const* const argv)
+{
+  if (argc < 2) {
+    std::cerr << "Test directory not specified!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  test::testCases(argv[1]);
+  test::testSyntaxErrors();
+  test::testImportCache(argv[1]);
+
+  test::printThroughput();
+
+  return test::printSummary();
+}
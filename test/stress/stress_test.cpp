@@ -0,0 +1,226 @@
+/**
+ * These codes are licensed under MIT License
+ * See the LICENSE for details
+ *
+ * Copyright (c) 2022 Hiramoto Ittou
+ */
+
+#include "check.hpp"
+#include <twinkle/engine/engine.hpp>
+#include <chrono>
+#include <iostream>
+#include <fmt/printf.h>
+
+namespace test
+{
+
+// Functions are compiled when they are called, so the time of adding a module
+// is that of parsing and generating the IR
+// Returns nullptr if the module could not be added
+template <typename F>
+[[nodiscard]] F* addAndLookup(twinkle::Engine&   engine,
+                              const std::string& name,
+                              std::string&&      source,
+                              const std::string& symbol)
+{
+  const auto num_bytes = source.size();
+
+  const auto start = std::chrono::steady_clock::now();
+
+  if (!engine.addModule(name, std::move(source)))
+    return nullptr;
+
+  const auto duration = std::chrono::duration<double, std::milli>{
+    std::chrono::steady_clock::now() - start};
+
+  std::cerr << fmt::format("Added {} ({} bytes) in {:.1f} ms\n",
+                           name,
+                           num_bytes,
+                           duration.count());
+
+  return engine.lookup<F>(symbol);
+}
+
+// Every statement looks up the variables of the function
+void testManyLocals(twinkle::Engine& engine)
+{
+  constexpr int num_variables = 2'500;
+
+  std::string source = "pub func manyLocals() -> i32\n"
+                       "{\n"
+                       "  let mut sum = 0;\n";
+
+  for (int i = 0; i != num_variables; ++i)
+    source += fmt::format("  let v{0} = {0};\n  sum += v{0};\n", i);
+
+  source += "  return sum;\n"
+            "}\n";
+
+  const auto func = addAndLookup<int()>(engine,
+                                        "many_locals.twk",
+                                        std::move(source),
+                                        "manyLocals");
+
+  check("many_locals",
+        func && func() == num_variables * (num_variables - 1) / 2);
+}
+
+// Every block refers to the variable of the enclosing one
+void testNestedBlocks(twinkle::Engine& engine)
+{
+  constexpr int depth = 200;
+
+  std::string source = "pub func nestedBlocks() -> i32\n"
+                       "{\n"
+                       "  let x = 0;\n"
+                       "  let mut result = 0;\n";
+
+  for (int i = 0; i != depth; ++i)
+    source += "{\nlet x = x + 1;\n";
+
+  source += "result = x;\n";
+
+  for (int i = 0; i != depth; ++i)
+    source += "}\n";
+
+  source += "  return result * 1000 + x;\n"
+            "}\n";
+
+  const auto func = addAndLookup<int()>(engine,
+                                        "nested_blocks.twk",
+                                        std::move(source),
+                                        "nestedBlocks");
+
+  check("nested_blocks", func && func() == depth * 1000);
+}
+
+// Every declaration creates and compares pointer types
+void testManyTypes(twinkle::Engine& engine)
+{
+  constexpr int num_variables = 2'000;
+
+  std::string source = "pub func manyTypes() -> i32\n"
+                       "{\n"
+                       "  let mut sum: i32 = 0;\n"
+                       "  let x: i32 = 1;\n"
+                       "  let px: ^i32 = &x;\n";
+
+  for (int i = 0; i != num_variables; ++i) {
+    source += fmt::format("  let p{0}: ^^i32 = &px;\n"
+                          "  let q{0}: ^i32 = p{0}^;\n"
+                          "  sum += q{0}^;\n",
+                          i);
+  }
+
+  source += "  return sum;\n"
+            "}\n";
+
+  const auto func = addAndLookup<int()>(engine,
+                                        "many_types.twk",
+                                        std::move(source),
+                                        "manyTypes");
+
+  check("many_types", func && func() == num_variables);
+}
+
+// Every literal looks up the instantiation of the class template
+void testManyInstantiations(twinkle::Engine& engine)
+{
+  constexpr int num_literals = 2'000;
+
+  std::string source = "class Box<T> {\n"
+                       "  Box(value_: T)\n"
+                       "  {\n"
+                       "    value = value_;\n"
+                       "  }\n"
+                       "\n"
+                       "  func get() -> T\n"
+                       "  {\n"
+                       "    return value;\n"
+                       "  }\n"
+                       "\n"
+                       "private:\n"
+                       "  let mut value: T;\n"
+                       "}\n"
+                       "\n"
+                       "pub func manyInstantiations() -> i32\n"
+                       "{\n"
+                       "  let mut sum = 0;\n";
+
+  for (int i = 0; i != num_literals; ++i) {
+    source += fmt::format("  let a{0} = Box<i32>{{1}};\n"
+                          "  let b{0} = Box<Box<i32>>{{a{0}}};\n"
+                          "  sum += b{0}.get().get();\n",
+                          i);
+  }
+
+  source += "  return sum;\n"
+            "}\n";
+
+  const auto func = addAndLookup<int()>(engine,
+                                        "many_instantiations.twk",
+                                        std::move(source),
+                                        "manyInstantiations");
+
+  check("many_instantiations", func && func() == num_literals);
+}
+
+// Every overload has the same name, so calls search the overloads of it
+void testManyOverloads(twinkle::Engine& engine)
+{
+  constexpr int num_overloads = 500;
+
+  std::string source;
+
+  // The overload that is called is declared last
+  for (int i = 1; i != num_overloads; ++i) {
+    source += fmt::format("func f(p: {}i32) -> i32\n"
+                          "{{\n"
+                          "  return 0;\n"
+                          "}}\n"
+                          "\n",
+                          std::string(i, '^'));
+  }
+
+  source += "func f(n: i32) -> i32\n"
+            "{\n"
+            "  return n;\n"
+            "}\n"
+            "\n"
+            "pub func manyOverloads() -> i32\n"
+            "{\n"
+            "  let mut sum = 0;\n";
+
+  for (int i = 0; i != num_overloads; ++i)
+    source += "  sum += f(1);\n";
+
+  source += "  return sum;\n"
+            "}\n";
+
+  const auto func = addAndLookup<int()>(engine,
+                                        "many_overloads.twk",
+                                        std::move(source),
+                                        "manyOverloads");
+
+  check("many_overloads", func && func() == num_overloads);
+}
+
+} // namespace test
+
+int main()
+{
+  std::vector<twinkle::Diagnostic> diagnostics;
+
+  auto engine = twinkle::Engine::create({}, diagnostics);
+  test::check("create", engine && diagnostics.empty());
+
+  if (engine) {
+    test::testManyLocals(*engine);
+    test::testNestedBlocks(*engine);
+    test::testManyTypes(*engine);
+    test::testManyInstantiations(*engine);
+    test::testManyOverloads(*engine);
+  }
+
+  return test::printSummary();
+}
@@ -208,6 +208,12 @@ namespace test
     {     "union_generics_single_instantiation",  58},
     {                            "size_of_type",  58},
     {                "call_namespaced_function", 116},
+    {                        "import_same_file",  58},
+    {             "import_unions_and_templates",  58},
+    {                        "destructor_order",  58},
+    {   "class_template_with_partly_same_args",  58},
+    {             "overload_in_outer_namespace",  58},
+    {                     "call_across_modules",  85},
   };
 
   const auto it = expects.find(test_name);
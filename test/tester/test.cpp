@@ -6,10 +6,12 @@
  */
 
 #include "expect.hpp"
+#include "check.hpp"
 #include <twinkle/compile/compile.hpp>
 #include <context.hpp>
 #include <filesystem>
 #include <sstream>
+#include <string_view>
 #include <iostream>
 #include <unordered_map>
 #include <fmt/printf.h>
@@ -22,6 +24,9 @@ namespace fs = std::filesystem;
 namespace test
 {
 
+// Set by --x3-parser, which parses the cases with the X3 grammar
+bool x3_parser = false;
+
 [[nodiscard]] std::optional<int> runTest(const fs::directory_entry& test_path)
 {
 #if SUPPRESS_COMPILE_ERROR_OUTPUT
@@ -35,15 +40,16 @@ namespace test
     for (const auto& path : fs::recursive_directory_iterator(test_path))
       paths.push_back(path.path().string());
 
-    const auto result
-      = twinkle::compile(twinkle::Context{std::move(paths),
-                                          true,
-                                          "", // JIT compile, so it's empty
-                                          twinkle::DEFAULT_OPT_LEVEL,
-                                          "pic",
-                                          {},
-                                          std::nullopt},
-                         "test");
+    const auto result = twinkle::compile(
+      twinkle::Context{
+        .input_files = std::move(paths),
+        .jit         = true,
+        .emit_target = "", // JIT compile, so it's empty
+        .jit_threads = 4,  // Compile modules concurrently
+        .jobs        = 4,  // Exercise the parallel path
+        .x3_parser   = x3_parser,
+      },
+      "test");
 
 #if SUPPRESS_COMPILE_ERROR_OUTPUT
     std::cerr.clear();
@@ -56,13 +62,12 @@ namespace test
   }
   else {
     const auto result = twinkle::compile(
-      twinkle::Context{std::vector<std::string>{test_path.path()},
-                       true,
-                       "", // JIT compile, so it's empty
-                       twinkle::DEFAULT_OPT_LEVEL,
-                       "pic",
-                       {},
-                       std::nullopt},
+      twinkle::Context{
+        .input_files = {test_path.path()},
+        .jit         = true,
+        .emit_target = "", // JIT compile, so it's empty
+        .x3_parser   = x3_parser,
+      },
       "test");
 
 #if SUPPRESS_COMPILE_ERROR_OUTPUT
@@ -80,18 +85,18 @@ namespace test
 
 int main(const int argc, const char* const* const argv)
 {
-  if (argc != 2) {
+  if (argc == 3 && std::string_view{argv[2]} == "--x3-parser")
+    test::x3_parser = true;
+  else if (argc != 2) {
     std::cerr << "Invalid commandline arguments!" << std::endl;
     std::exit(EXIT_FAILURE);
   }
-  else if (!fs::is_directory(argv[1])) {
+
+  if (!fs::is_directory(argv[1])) {
     std::cerr << "No such directory!" << std::endl;
     std::exit(EXIT_FAILURE);
   }
 
-  std::size_t pass_c{};
-  std::size_t fail_c{};
-
   for (const auto& path : fs::directory_iterator(argv[1])) {
     std::cerr << path.path().stem().string();
 
@@ -112,7 +117,7 @@ int main(const int argc, const char* const* const argv)
                    fg(fmt::terminal_color::bright_green),
                    "{} Passed!\n",
                    *result);
-        ++pass_c;
+        ++test::pass_c;
         continue;
       }
     }
@@ -123,19 +128,8 @@ int main(const int argc, const char* const* const argv)
                "{} Failed! ",
                *result);
     fmt::print(stderr, "{} expected\n", *expect);
-    ++fail_c;
+    ++test::fail_c;
   }
 
-  std::cerr << "--------------------\n";
-  std::cerr << "| " + fmt::format(fg(fmt::terminal_color::bright_red), "Failed")
-                 + ": "
-            << std::setw(10) << fail_c << " |\n";
-  std::cerr << "| "
-                 + fmt::format(fg(fmt::terminal_color::bright_green), "Passed")
-                 + ": "
-            << std::setw(10) << pass_c << " |\n";
-  std::cerr << "--------------------\n";
-
-  if (fail_c)
-    return EXIT_FAILURE;
+  return test::printSummary();
 }